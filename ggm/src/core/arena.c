@@ -0,0 +1,101 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Arena Allocator
+ */
+
+#include "ggm.h"
+
+/******************************************************************************
+ * arena functions
+ */
+
+/* arena_init initialises an empty arena */
+void arena_init(struct arena *a, size_t chunk_size)
+{
+	a->chunk = NULL;
+	a->chunk_size = chunk_size;
+	a->used = 0;
+	a->size = 0;
+}
+
+/* arena_free deallocates all of the arena memory */
+void arena_free(struct arena *a)
+{
+	struct arena_chunk *x = a->chunk;
+
+	while (x != NULL) {
+		struct arena_chunk *next = x->next;
+		ggm_free(x);
+		x = next;
+	}
+	arena_init(a, a->chunk_size);
+}
+
+/* arena_chunk_new allocates a chunk of at least size bytes */
+static struct arena_chunk *arena_chunk_new(struct arena *a, size_t size)
+{
+	if (size < a->chunk_size) {
+		size = a->chunk_size;
+	}
+
+	struct arena_chunk *x = ggm_calloc(1, sizeof(struct arena_chunk) + size);
+	if (x == NULL) {
+		return NULL;
+	}
+
+	x->base = (uint8_t *)&x[1];
+	x->size = size;
+	a->size += size;
+	return x;
+}
+
+/* arena_chunk_alloc allocates from a chunk (or returns NULL if it won't fit) */
+static void *arena_chunk_alloc(struct arena *a, struct arena_chunk *x, size_t size, size_t align)
+{
+	uintptr_t mask = align - 1;
+	uintptr_t ptr = (uintptr_t)&x->base[x->used];
+	size_t pad = ((ptr + mask) & ~mask) - ptr;
+
+	if (x->used + pad + size > x->size) {
+		return NULL;
+	}
+	x->used += pad + size;
+	a->used += pad + size;
+	return (void *)(ptr + pad);
+}
+
+/* arena_alloc returns size bytes of zeroed memory aligned to align (a power of 2) */
+void *arena_alloc(struct arena *a, size_t size, size_t align)
+{
+	struct arena_chunk *x = a->chunk;
+	void *ptr;
+
+	if (x != NULL) {
+		ptr = arena_chunk_alloc(a, x, size, align);
+		if (ptr != NULL) {
+			return ptr;
+		}
+	}
+
+	x = arena_chunk_new(a, size + align - 1);
+	if (x == NULL) {
+		LOG_ERR("could not allocate %u bytes", (unsigned int)size);
+		return NULL;
+	}
+
+	if (a->chunk != NULL && size + align - 1 > a->chunk_size) {
+		/* a large allocation gets its own chunk, keep using the current chunk */
+		x->next = a->chunk->next;
+		a->chunk->next = x;
+	} else {
+		x->next = a->chunk;
+		a->chunk = x;
+	}
+
+	return arena_chunk_alloc(a, x, size, align);
+}
+
+/*****************************************************************************/
@@ -11,43 +11,75 @@
  *
  * The block_mul/add() function seem immune to improvements. They use vldmia/vstmia
  * and it maybe that other functions could benefit from multiple load/store also. *
+ *
+ * The scalar functions in this file are the reference implementation. Hosts
+ * with SIMD units (x86-64, aarch64) have other implementations which are
+ * selected at startup by block_init().
  */
 
 #include "ggm.h"
+#include "block.h"
 
-/*****************************************************************************/
+/******************************************************************************
+ * The buffer size is a runtime value. Each operation is written once as an
+ * inline function of n and called with the constant AudioBufferSize when n
+ * matches, so the compiler can generate a fully unrolled version for the
+ * common case.
+ */
 
-/* block_zero sets a buffer to zero */
-void block_zero(float *out)
+#define BLOCK_OP(name, n, ...) \
+	do { \
+		if ((n) == AudioBufferSize) { \
+			name(__VA_ARGS__, AudioBufferSize); \
+		} else { \
+			name(__VA_ARGS__, (n)); \
+		} \
+	} while (0)
+
+/******************************************************************************
+ * scalar operations
+ */
+
+static inline void zero(float *out, size_t n)
 {
-	for (size_t i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		out[i] = 0.f;
 	}
 }
 
-/* block_mul multiplies two buffers */
-void block_mul(float *out, float *buf)
+static void scalar_zero(float *out, size_t n)
 {
-	for (size_t i = 0; i < AudioBufferSize; i++) {
+	BLOCK_OP(zero, n, out);
+}
+
+static inline void mul(float *out, const float *buf, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
 		out[i] *= buf[i];
 	}
 }
 
-/* block_add adds two buffers */
-void block_add(float *out, float *buf)
+static void scalar_mul(float *out, const float *buf, size_t n)
 {
-	for (size_t i = 0; i < AudioBufferSize; i++) {
+	BLOCK_OP(mul, n, out, buf);
+}
+
+static inline void add(float *out, const float *buf, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
 		out[i] += buf[i];
 	}
 }
 
-/* block_mul_k multiplies a block by a scalar */
-void block_mul_k(float *out, float k)
+static void scalar_add(float *out, const float *buf, size_t n)
 {
-	size_t n = AudioBufferSize;
+	BLOCK_OP(add, n, out, buf);
+}
 
+static inline void mul_k(float *out, float k, size_t n)
+{
 	/* unroll x4 */
-	while (n > 0) {
+	while (n >= 4) {
 		out[0] *= k;
 		out[1] *= k;
 		out[2] *= k;
@@ -55,15 +87,21 @@ void block_mul_k(float *out, float k)
 		out += 4;
 		n -= 4;
 	}
+	while (n > 0) {
+		*out++ *= k;
+		n--;
+	}
 }
 
-/* block_add_k adds a scalar to a buffer */
-void block_add_k(float *out, float k)
+static void scalar_mul_k(float *out, float k, size_t n)
 {
-	size_t n = AudioBufferSize;
+	BLOCK_OP(mul_k, n, out, k);
+}
 
+static inline void add_k(float *out, float k, size_t n)
+{
 	/* unroll x4 */
-	while (n > 0) {
+	while (n >= 4) {
 		out[0] += k;
 		out[1] += k;
 		out[2] += k;
@@ -71,15 +109,21 @@ void block_add_k(float *out, float k)
 		out += 4;
 		n -= 4;
 	}
+	while (n > 0) {
+		*out++ += k;
+		n--;
+	}
 }
 
-/* block_copy copies a block */
-void block_copy(float *dst, const float *src)
+static void scalar_add_k(float *out, float k, size_t n)
 {
-	size_t n = AudioBufferSize;
+	BLOCK_OP(add_k, n, out, k);
+}
 
+static inline void copy(float *dst, const float *src, size_t n)
+{
 	/* unroll x4 */
-	while (n > 0) {
+	while (n >= 4) {
 		dst[0] = src[0];
 		dst[1] = src[1];
 		dst[2] = src[2];
@@ -88,15 +132,21 @@ void block_copy(float *dst, const float *src)
 		dst += 4;
 		n -= 4;
 	}
+	while (n > 0) {
+		*dst++ = *src++;
+		n--;
+	}
 }
 
-/* block_copy_mul_k copies a block and multiplies by k */
-void block_copy_mul_k(float *dst, const float *src, float k)
+static void scalar_copy(float *dst, const float *src, size_t n)
 {
-	size_t n = AudioBufferSize;
+	BLOCK_OP(copy, n, dst, src);
+}
 
+static inline void copy_mul_k(float *dst, const float *src, float k, size_t n)
+{
 	/* unroll x4 */
-	while (n > 0) {
+	while (n >= 4) {
 		dst[0] = src[0] * k;
 		dst[1] = src[1] * k;
 		dst[2] = src[2] * k;
@@ -105,6 +155,237 @@ void block_copy_mul_k(float *dst, const float *src, float k)
 		dst += 4;
 		n -= 4;
 	}
+	while (n > 0) {
+		*dst++ = *src++ * k;
+		n--;
+	}
+}
+
+static void scalar_copy_mul_k(float *dst, const float *src, float k, size_t n)
+{
+	BLOCK_OP(copy_mul_k, n, dst, src, k);
+}
+
+static inline void mla(float *out, const float *a, const float *b, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] += a[i] * b[i];
+	}
+}
+
+static void scalar_mla(float *out, const float *a, const float *b, size_t n)
+{
+	BLOCK_OP(mla, n, out, a, b);
+}
+
+static inline void mul_k_add(float *out, const float *buf, float k0, float k1, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] = (out[i] * buf[i] * k0) + (buf[i] * k1);
+	}
+}
+
+static void scalar_mul_k_add(float *out, const float *buf, float k0, float k1, size_t n)
+{
+	BLOCK_OP(mul_k_add, n, out, buf, k0, k1);
+}
+
+static inline void copy_mul_k2(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		float x = src[i];
+		dst0[i] = x * k0;
+		dst1[i] = x * k1;
+	}
+}
+
+static void scalar_copy_mul_k2(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n)
+{
+	BLOCK_OP(copy_mul_k2, n, dst0, dst1, src, k0, k1);
+}
+
+static inline uint32_t phase_fm(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] = x;
+		x += xstep + phase_cycles(fm[i] * k);
+	}
+	return x;
+}
+
+static uint32_t scalar_phase_fm(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n)
+{
+	if (n == AudioBufferSize) {
+		return phase_fm(out, x, xstep, fm, k, AudioBufferSize);
+	}
+	return phase_fm(out, x, xstep, fm, k, n);
+}
+
+static inline void phase_pm(uint32_t *x, const float *pm, float k, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		x[i] += phase_cycles(pm[i] * k);
+	}
+}
+
+static void scalar_phase_pm(uint32_t *x, const float *pm, float k, size_t n)
+{
+	BLOCK_OP(phase_pm, n, x, pm, k);
+}
+
+const struct block_ops block_scalar_ops = {
+	.name = "scalar",
+	.zero = scalar_zero,
+	.mul = scalar_mul,
+	.add = scalar_add,
+	.mul_k = scalar_mul_k,
+	.add_k = scalar_add_k,
+	.copy = scalar_copy,
+	.copy_mul_k = scalar_copy_mul_k,
+	.mla = scalar_mla,
+	.mul_k_add = scalar_mul_k_add,
+	.copy_mul_k2 = scalar_copy_mul_k2,
+	.cos_lookup = cos_lookup_scalar,
+	.phase_fm = scalar_phase_fm,
+	.phase_pm = scalar_phase_pm,
+};
+
+/******************************************************************************
+ * operation selection
+ */
+
+/* the current block operations */
+static const struct block_ops *ops = &block_scalar_ops;
+
+/* block_get_ops returns the n-th block operations supported by this cpu (or NULL).
+ * The list is in order of preference, the last entry is the best.
+ */
+const struct block_ops *block_get_ops(unsigned int n)
+{
+	const struct block_ops *list[] = {
+		&block_scalar_ops,
+#if defined(__x86_64__)
+		&block_sse2_ops,
+		block_avx2_supported() ? &block_avx2_ops : NULL,
+#elif defined(__aarch64__)
+		&block_neon_ops,
+#endif
+	};
+	unsigned int k = 0;
+
+	for (size_t i = 0; i < sizeof(list) / sizeof(list[0]); i++) {
+		if (list[i] != NULL) {
+			if (k == n) {
+				return list[i];
+			}
+			k++;
+		}
+	}
+	return NULL;
+}
+
+/* block_set_ops sets the block operations */
+void block_set_ops(const struct block_ops *x)
+{
+	ops = x;
+}
+
+/* block_init selects the best block operations for this cpu */
+void block_init(void)
+{
+	const struct block_ops *x;
+
+	for (unsigned int i = 0; (x = block_get_ops(i)) != NULL; i++) {
+		ops = x;
+	}
+	LOG_INF("using %s block operations", ops->name);
+}
+
+/******************************************************************************
+ * block operations
+ */
+
+/* block_zero sets a buffer to zero */
+void block_zero(float *out, size_t n)
+{
+	ops->zero(out, n);
+}
+
+/* block_mul multiplies two buffers */
+void block_mul(float *out, float *buf, size_t n)
+{
+	ops->mul(out, buf, n);
+}
+
+/* block_add adds two buffers */
+void block_add(float *out, float *buf, size_t n)
+{
+	ops->add(out, buf, n);
+}
+
+/* block_mul_k multiplies a block by a scalar */
+void block_mul_k(float *out, float k, size_t n)
+{
+	ops->mul_k(out, k, n);
+}
+
+/* block_add_k adds a scalar to a buffer */
+void block_add_k(float *out, float k, size_t n)
+{
+	ops->add_k(out, k, n);
+}
+
+/* block_copy copies a block */
+void block_copy(float *dst, const float *src, size_t n)
+{
+	ops->copy(dst, src, n);
+}
+
+/* block_copy_mul_k copies a block and multiplies by k */
+void block_copy_mul_k(float *dst, const float *src, float k, size_t n)
+{
+	ops->copy_mul_k(dst, src, k, n);
+}
+
+/* block_mla multiplies two buffers and accumulates, out += a * b */
+void block_mla(float *out, const float *a, const float *b, size_t n)
+{
+	ops->mla(out, a, b, n);
+}
+
+/* block_mul_k_add multiplies by a buffer and adds it, out = (out * buf * k0) + (buf * k1) */
+void block_mul_k_add(float *out, const float *buf, float k0, float k1, size_t n)
+{
+	ops->mul_k_add(out, buf, k0, k1, n);
+}
+
+/* block_copy_mul_k2 copies a block to two outputs with separate gains (E.g. left/right) */
+void block_copy_mul_k2(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n)
+{
+	ops->copy_mul_k2(dst0, dst1, src, k0, k1, n);
+}
+
+/* block_cos_lookup returns the cosine of a buffer of phase values, see cos_lookup() */
+void block_cos_lookup(float *out, const uint32_t *x, size_t n)
+{
+	ops->cos_lookup(out, x, n);
+}
+
+/* block_phase_fm returns the phase ramp of a frequency modulated oscillator.
+ * out[i] = x, the step is xstep + fm[i] * k cycles. k scales fm to cycles
+ * per sample (E.g. 1/rate for Hz). The phase after the last sample is returned.
+ */
+uint32_t block_phase_fm(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n)
+{
+	return ops->phase_fm(out, x, xstep, fm, k, n);
+}
+
+/* block_phase_pm adds a phase modulation to a buffer of phase values, x[i] += pm[i] * k cycles.
+ * k scales pm to cycles (E.g. 1/Tau for radians).
+ */
+void block_phase_pm(uint32_t *x, const float *pm, float k, size_t n)
+{
+	ops->phase_pm(x, pm, k, n);
 }
 
 /*****************************************************************************/
@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Block Operations (cpu specific implementations)
+ */
+
+#ifndef GGM_SRC_CORE_BLOCK_H
+#define GGM_SRC_CORE_BLOCK_H
+
+/*****************************************************************************/
+
+extern const struct block_ops block_scalar_ops;
+
+/* cpu specific versions of cos_lookup_buf() (lut.c) */
+void cos_lookup_scalar(float *out, const uint32_t *x, size_t n);
+#if defined(__x86_64__)
+void cos_lookup_avx2(float *out, const uint32_t *x, size_t n);
+#endif
+
+/******************************************************************************
+ * The phase operations convert a modulation value (cycles) to a phase value.
+ * The whole cycles are removed first (by rounding with a float add/sub so all
+ * implementations give the same result) so any number of cycles wraps like
+ * the uint32_t phase does.
+ */
+
+#define PHASE_ROUND (12582912.f)        /* 1.5 * 2^23, x + PHASE_ROUND rounds x to an integer */
+#define PHASE_MAX_CYCLES (4194304.f)    /* 2^22, range of x for PHASE_ROUND */
+#define PHASE_MAX (2147483520.f)        /* largest float < 2^31 */
+
+/* phase_cycles returns the phase value for a (signed) number of cycles */
+static inline uint32_t phase_cycles(float x)
+{
+	x = clampf(x, -PHASE_MAX_CYCLES, PHASE_MAX_CYCLES);
+	x -= (x + PHASE_ROUND) - PHASE_ROUND;
+	return (uint32_t)(int32_t)clampf_hi(x * (float)FullCycle, PHASE_MAX);
+}
+
+/*****************************************************************************/
+
+#if defined(__x86_64__)
+extern const struct block_ops block_sse2_ops;
+extern const struct block_ops block_avx2_ops;
+bool block_avx2_supported(void);
+#endif
+
+#if defined(__aarch64__)
+extern const struct block_ops block_neon_ops;
+#endif
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_CORE_BLOCK_H */
+
+/*****************************************************************************/
@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Block Operations for aarch64 (NEON)
+ * NEON is part of the aarch64 baseline so these are always available.
+ * Multiplies and adds are kept separate (no fmla) to track the scalar code.
+ * Buffers need not be aligned.
+ */
+
+#include "ggm.h"
+#include "block.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+/*****************************************************************************/
+
+static void neon_zero(float *out, size_t n)
+{
+	float32x4_t z = vdupq_n_f32(0.f);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(&out[i], z);
+	}
+	for (; i < n; i++) {
+		out[i] = 0.f;
+	}
+}
+
+static void neon_mul(float *out, const float *buf, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(&out[i], vmulq_f32(vld1q_f32(&out[i]), vld1q_f32(&buf[i])));
+	}
+	for (; i < n; i++) {
+		out[i] *= buf[i];
+	}
+}
+
+static void neon_add(float *out, const float *buf, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(&out[i], vaddq_f32(vld1q_f32(&out[i]), vld1q_f32(&buf[i])));
+	}
+	for (; i < n; i++) {
+		out[i] += buf[i];
+	}
+}
+
+static void neon_mul_k(float *out, float k, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(&out[i], vmulq_n_f32(vld1q_f32(&out[i]), k));
+	}
+	for (; i < n; i++) {
+		out[i] *= k;
+	}
+}
+
+static void neon_add_k(float *out, float k, size_t n)
+{
+	float32x4_t vk = vdupq_n_f32(k);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(&out[i], vaddq_f32(vld1q_f32(&out[i]), vk));
+	}
+	for (; i < n; i++) {
+		out[i] += k;
+	}
+}
+
+static void neon_copy(float *dst, const float *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(&dst[i], vld1q_f32(&src[i]));
+	}
+	for (; i < n; i++) {
+		dst[i] = src[i];
+	}
+}
+
+static void neon_copy_mul_k(float *dst, const float *src, float k, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(&dst[i], vmulq_n_f32(vld1q_f32(&src[i]), k));
+	}
+	for (; i < n; i++) {
+		dst[i] = src[i] * k;
+	}
+}
+
+static void neon_mla(float *out, const float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t ab = vmulq_f32(vld1q_f32(&a[i]), vld1q_f32(&b[i]));
+		vst1q_f32(&out[i], vaddq_f32(vld1q_f32(&out[i]), ab));
+	}
+	for (; i < n; i++) {
+		out[i] += a[i] * b[i];
+	}
+}
+
+static void neon_mul_k_add(float *out, const float *buf, float k0, float k1, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t b = vld1q_f32(&buf[i]);
+		float32x4_t x = vmulq_n_f32(vmulq_f32(vld1q_f32(&out[i]), b), k0);
+		vst1q_f32(&out[i], vaddq_f32(x, vmulq_n_f32(b, k1)));
+	}
+	for (; i < n; i++) {
+		out[i] = (out[i] * buf[i] * k0) + (buf[i] * k1);
+	}
+}
+
+static void neon_copy_mul_k2(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t x = vld1q_f32(&src[i]);
+		vst1q_f32(&dst0[i], vmulq_n_f32(x, k0));
+		vst1q_f32(&dst1[i], vmulq_n_f32(x, k1));
+	}
+	for (; i < n; i++) {
+		float x = src[i];
+		dst0[i] = x * k0;
+		dst1[i] = x * k1;
+	}
+}
+
+/* neon_phase_cycles returns the phase values for a number of cycles, see phase_cycles() */
+static inline uint32x4_t neon_phase_cycles(float32x4_t x)
+{
+	const float32x4_t round = vdupq_n_f32(PHASE_ROUND);
+
+	x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-PHASE_MAX_CYCLES)), vdupq_n_f32(PHASE_MAX_CYCLES));
+	x = vsubq_f32(x, vsubq_f32(vaddq_f32(x, round), round));
+	x = vminq_f32(vmulq_n_f32(x, (float)FullCycle), vdupq_n_f32(PHASE_MAX));
+	return vreinterpretq_u32_s32(vcvtq_s32_f32(x));
+}
+
+static uint32_t neon_phase_fm(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n)
+{
+	const uint32x4_t zero = vdupq_n_u32(0);
+	uint32x4_t vstep = vdupq_n_u32(xstep);
+	uint32x4_t vx = vdupq_n_u32(x);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		uint32x4_t s = vaddq_u32(vstep, neon_phase_cycles(vmulq_n_f32(vld1q_f32(&fm[i]), k)));
+		/* prefix sum of the steps */
+		uint32x4_t sum = vaddq_u32(s, vextq_u32(zero, s, 3));
+		sum = vaddq_u32(sum, vextq_u32(zero, sum, 2));
+		vst1q_u32(&out[i], vaddq_u32(vx, vsubq_u32(sum, s)));
+		vx = vaddq_u32(vx, vdupq_laneq_u32(sum, 3));
+	}
+	x = vgetq_lane_u32(vx, 0);
+	for (; i < n; i++) {
+		out[i] = x;
+		x += xstep + phase_cycles(fm[i] * k);
+	}
+	return x;
+}
+
+static void neon_phase_pm(uint32_t *x, const float *pm, float k, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		uint32x4_t p = neon_phase_cycles(vmulq_n_f32(vld1q_f32(&pm[i]), k));
+		vst1q_u32(&x[i], vaddq_u32(vld1q_u32(&x[i]), p));
+	}
+	for (; i < n; i++) {
+		x[i] += phase_cycles(pm[i] * k);
+	}
+}
+
+const struct block_ops block_neon_ops = {
+	.name = "neon",
+	.zero = neon_zero,
+	.mul = neon_mul,
+	.add = neon_add,
+	.mul_k = neon_mul_k,
+	.add_k = neon_add_k,
+	.copy = neon_copy,
+	.copy_mul_k = neon_copy_mul_k,
+	.mla = neon_mla,
+	.mul_k_add = neon_mul_k_add,
+	.copy_mul_k2 = neon_copy_mul_k2,
+	.cos_lookup = cos_lookup_scalar,
+	.phase_fm = neon_phase_fm,
+	.phase_pm = neon_phase_pm,
+};
+
+#endif /* __aarch64__ */
+
+/*****************************************************************************/
@@ -0,0 +1,443 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Block Operations for x86-64 (SSE2 and AVX2)
+ * SSE2 is part of the x86-64 baseline. The AVX2 functions are compiled with a
+ * target attribute and are only used if the cpu supports them.
+ * The operations are done in the same order as the scalar code and don't use
+ * FMA, so the results match the scalar implementation.
+ * Buffers need not be aligned.
+ */
+
+#include "ggm.h"
+#include "block.h"
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+/******************************************************************************
+ * SSE2
+ */
+
+static void sse2_zero(float *out, size_t n)
+{
+	__m128 z = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(&out[i], z);
+	}
+	for (; i < n; i++) {
+		out[i] = 0.f;
+	}
+}
+
+static void sse2_mul(float *out, const float *buf, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_loadu_ps(&out[i]), _mm_loadu_ps(&buf[i])));
+	}
+	for (; i < n; i++) {
+		out[i] *= buf[i];
+	}
+}
+
+static void sse2_add(float *out, const float *buf, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(&out[i], _mm_add_ps(_mm_loadu_ps(&out[i]), _mm_loadu_ps(&buf[i])));
+	}
+	for (; i < n; i++) {
+		out[i] += buf[i];
+	}
+}
+
+static void sse2_mul_k(float *out, float k, size_t n)
+{
+	__m128 vk = _mm_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_loadu_ps(&out[i]), vk));
+	}
+	for (; i < n; i++) {
+		out[i] *= k;
+	}
+}
+
+static void sse2_add_k(float *out, float k, size_t n)
+{
+	__m128 vk = _mm_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(&out[i], _mm_add_ps(_mm_loadu_ps(&out[i]), vk));
+	}
+	for (; i < n; i++) {
+		out[i] += k;
+	}
+}
+
+static void sse2_copy(float *dst, const float *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(&dst[i], _mm_loadu_ps(&src[i]));
+	}
+	for (; i < n; i++) {
+		dst[i] = src[i];
+	}
+}
+
+static void sse2_copy_mul_k(float *dst, const float *src, float k, size_t n)
+{
+	__m128 vk = _mm_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(&dst[i], _mm_mul_ps(_mm_loadu_ps(&src[i]), vk));
+	}
+	for (; i < n; i++) {
+		dst[i] = src[i] * k;
+	}
+}
+
+static void sse2_mla(float *out, const float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 ab = _mm_mul_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i]));
+		_mm_storeu_ps(&out[i], _mm_add_ps(_mm_loadu_ps(&out[i]), ab));
+	}
+	for (; i < n; i++) {
+		out[i] += a[i] * b[i];
+	}
+}
+
+static void sse2_mul_k_add(float *out, const float *buf, float k0, float k1, size_t n)
+{
+	__m128 vk0 = _mm_set1_ps(k0);
+	__m128 vk1 = _mm_set1_ps(k1);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 b = _mm_loadu_ps(&buf[i]);
+		__m128 x = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&out[i]), b), vk0);
+		_mm_storeu_ps(&out[i], _mm_add_ps(x, _mm_mul_ps(b, vk1)));
+	}
+	for (; i < n; i++) {
+		out[i] = (out[i] * buf[i] * k0) + (buf[i] * k1);
+	}
+}
+
+static void sse2_copy_mul_k2(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n)
+{
+	__m128 vk0 = _mm_set1_ps(k0);
+	__m128 vk1 = _mm_set1_ps(k1);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(&src[i]);
+		_mm_storeu_ps(&dst0[i], _mm_mul_ps(x, vk0));
+		_mm_storeu_ps(&dst1[i], _mm_mul_ps(x, vk1));
+	}
+	for (; i < n; i++) {
+		float x = src[i];
+		dst0[i] = x * k0;
+		dst1[i] = x * k1;
+	}
+}
+
+/* sse2_phase_cycles returns the phase values for a number of cycles, see phase_cycles() */
+static inline __m128i sse2_phase_cycles(__m128 x)
+{
+	const __m128 round = _mm_set1_ps(PHASE_ROUND);
+
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-PHASE_MAX_CYCLES)), _mm_set1_ps(PHASE_MAX_CYCLES));
+	x = _mm_sub_ps(x, _mm_sub_ps(_mm_add_ps(x, round), round));
+	x = _mm_min_ps(_mm_mul_ps(x, _mm_set1_ps((float)FullCycle)), _mm_set1_ps(PHASE_MAX));
+	return _mm_cvttps_epi32(x);
+}
+
+static uint32_t sse2_phase_fm(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n)
+{
+	__m128 vk = _mm_set1_ps(k);
+	__m128i vstep = _mm_set1_epi32((int32_t)xstep);
+	__m128i vx = _mm_set1_epi32((int32_t)x);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i s = _mm_add_epi32(vstep, sse2_phase_cycles(_mm_mul_ps(_mm_loadu_ps(&fm[i]), vk)));
+		/* prefix sum of the steps */
+		__m128i sum = _mm_add_epi32(s, _mm_slli_si128(s, 4));
+		sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+		_mm_storeu_si128((__m128i *)&out[i], _mm_add_epi32(vx, _mm_sub_epi32(sum, s)));
+		vx = _mm_add_epi32(vx, _mm_shuffle_epi32(sum, 0xff));
+	}
+	x = (uint32_t)_mm_cvtsi128_si32(vx);
+	for (; i < n; i++) {
+		out[i] = x;
+		x += xstep + phase_cycles(fm[i] * k);
+	}
+	return x;
+}
+
+static void sse2_phase_pm(uint32_t *x, const float *pm, float k, size_t n)
+{
+	__m128 vk = _mm_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i p = sse2_phase_cycles(_mm_mul_ps(_mm_loadu_ps(&pm[i]), vk));
+		_mm_storeu_si128((__m128i *)&x[i], _mm_add_epi32(_mm_loadu_si128((const __m128i *)&x[i]), p));
+	}
+	for (; i < n; i++) {
+		x[i] += phase_cycles(pm[i] * k);
+	}
+}
+
+const struct block_ops block_sse2_ops = {
+	.name = "sse2",
+	.zero = sse2_zero,
+	.mul = sse2_mul,
+	.add = sse2_add,
+	.mul_k = sse2_mul_k,
+	.add_k = sse2_add_k,
+	.copy = sse2_copy,
+	.copy_mul_k = sse2_copy_mul_k,
+	.mla = sse2_mla,
+	.mul_k_add = sse2_mul_k_add,
+	.copy_mul_k2 = sse2_copy_mul_k2,
+	.cos_lookup = cos_lookup_scalar,
+	.phase_fm = sse2_phase_fm,
+	.phase_pm = sse2_phase_pm,
+};
+
+/******************************************************************************
+ * AVX2
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+bool block_avx2_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+AVX2 static void avx2_zero(float *out, size_t n)
+{
+	__m256 z = _mm256_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(&out[i], z);
+	}
+	for (; i < n; i++) {
+		out[i] = 0.f;
+	}
+}
+
+AVX2 static void avx2_mul(float *out, const float *buf, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_loadu_ps(&out[i]), _mm256_loadu_ps(&buf[i])));
+	}
+	for (; i < n; i++) {
+		out[i] *= buf[i];
+	}
+}
+
+AVX2 static void avx2_add(float *out, const float *buf, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(&out[i], _mm256_add_ps(_mm256_loadu_ps(&out[i]), _mm256_loadu_ps(&buf[i])));
+	}
+	for (; i < n; i++) {
+		out[i] += buf[i];
+	}
+}
+
+AVX2 static void avx2_mul_k(float *out, float k, size_t n)
+{
+	__m256 vk = _mm256_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_loadu_ps(&out[i]), vk));
+	}
+	for (; i < n; i++) {
+		out[i] *= k;
+	}
+}
+
+AVX2 static void avx2_add_k(float *out, float k, size_t n)
+{
+	__m256 vk = _mm256_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(&out[i], _mm256_add_ps(_mm256_loadu_ps(&out[i]), vk));
+	}
+	for (; i < n; i++) {
+		out[i] += k;
+	}
+}
+
+AVX2 static void avx2_copy(float *dst, const float *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(&dst[i], _mm256_loadu_ps(&src[i]));
+	}
+	for (; i < n; i++) {
+		dst[i] = src[i];
+	}
+}
+
+AVX2 static void avx2_copy_mul_k(float *dst, const float *src, float k, size_t n)
+{
+	__m256 vk = _mm256_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(&dst[i], _mm256_mul_ps(_mm256_loadu_ps(&src[i]), vk));
+	}
+	for (; i < n; i++) {
+		dst[i] = src[i] * k;
+	}
+}
+
+AVX2 static void avx2_mla(float *out, const float *a, const float *b, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256 ab = _mm256_mul_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]));
+		_mm256_storeu_ps(&out[i], _mm256_add_ps(_mm256_loadu_ps(&out[i]), ab));
+	}
+	for (; i < n; i++) {
+		out[i] += a[i] * b[i];
+	}
+}
+
+AVX2 static void avx2_mul_k_add(float *out, const float *buf, float k0, float k1, size_t n)
+{
+	__m256 vk0 = _mm256_set1_ps(k0);
+	__m256 vk1 = _mm256_set1_ps(k1);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256 b = _mm256_loadu_ps(&buf[i]);
+		__m256 x = _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(&out[i]), b), vk0);
+		_mm256_storeu_ps(&out[i], _mm256_add_ps(x, _mm256_mul_ps(b, vk1)));
+	}
+	for (; i < n; i++) {
+		out[i] = (out[i] * buf[i] * k0) + (buf[i] * k1);
+	}
+}
+
+AVX2 static void avx2_copy_mul_k2(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n)
+{
+	__m256 vk0 = _mm256_set1_ps(k0);
+	__m256 vk1 = _mm256_set1_ps(k1);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_loadu_ps(&src[i]);
+		_mm256_storeu_ps(&dst0[i], _mm256_mul_ps(x, vk0));
+		_mm256_storeu_ps(&dst1[i], _mm256_mul_ps(x, vk1));
+	}
+	for (; i < n; i++) {
+		float x = src[i];
+		dst0[i] = x * k0;
+		dst1[i] = x * k1;
+	}
+}
+
+/* avx2_phase_cycles returns the phase values for a number of cycles, see phase_cycles() */
+AVX2 static inline __m256i avx2_phase_cycles(__m256 x)
+{
+	const __m256 round = _mm256_set1_ps(PHASE_ROUND);
+
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-PHASE_MAX_CYCLES)), _mm256_set1_ps(PHASE_MAX_CYCLES));
+	x = _mm256_sub_ps(x, _mm256_sub_ps(_mm256_add_ps(x, round), round));
+	x = _mm256_min_ps(_mm256_mul_ps(x, _mm256_set1_ps((float)FullCycle)), _mm256_set1_ps(PHASE_MAX));
+	return _mm256_cvttps_epi32(x);
+}
+
+AVX2 static uint32_t avx2_phase_fm(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n)
+{
+	__m256 vk = _mm256_set1_ps(k);
+	__m256i vstep = _mm256_set1_epi32((int32_t)xstep);
+	__m256i vx = _mm256_set1_epi32((int32_t)x);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i s = _mm256_add_epi32(vstep, avx2_phase_cycles(_mm256_mul_ps(_mm256_loadu_ps(&fm[i]), vk)));
+		/* prefix sum of the steps within each 128-bit lane */
+		__m256i sum = _mm256_add_epi32(s, _mm256_slli_si256(s, 4));
+		sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 8));
+		/* add the low lane total to the high lane */
+		__m256i t = _mm256_shuffle_epi32(sum, 0xff);
+		sum = _mm256_add_epi32(sum, _mm256_permute2x128_si256(t, t, 0x08));
+		_mm256_storeu_si256((__m256i *)&out[i], _mm256_add_epi32(vx, _mm256_sub_epi32(sum, s)));
+		t = _mm256_shuffle_epi32(sum, 0xff);
+		vx = _mm256_add_epi32(vx, _mm256_permute2x128_si256(t, t, 0x11));
+	}
+	x = (uint32_t)_mm256_extract_epi32(vx, 0);
+	for (; i < n; i++) {
+		out[i] = x;
+		x += xstep + phase_cycles(fm[i] * k);
+	}
+	return x;
+}
+
+AVX2 static void avx2_phase_pm(uint32_t *x, const float *pm, float k, size_t n)
+{
+	__m256 vk = _mm256_set1_ps(k);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i p = avx2_phase_cycles(_mm256_mul_ps(_mm256_loadu_ps(&pm[i]), vk));
+		_mm256_storeu_si256((__m256i *)&x[i], _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&x[i]), p));
+	}
+	for (; i < n; i++) {
+		x[i] += phase_cycles(pm[i] * k);
+	}
+}
+
+const struct block_ops block_avx2_ops = {
+	.name = "avx2",
+	.zero = avx2_zero,
+	.mul = avx2_mul,
+	.add = avx2_add,
+	.mul_k = avx2_mul_k,
+	.add_k = avx2_add_k,
+	.copy = avx2_copy,
+	.copy_mul_k = avx2_copy_mul_k,
+	.mla = avx2_mla,
+	.mul_k_add = avx2_mul_k_add,
+	.copy_mul_k2 = avx2_copy_mul_k2,
+	.cos_lookup = cos_lookup_avx2,
+	.phase_fm = avx2_phase_fm,
+	.phase_pm = avx2_phase_pm,
+};
+
+#endif /* __x86_64__ */
+
+/*****************************************************************************/
@@ -5,6 +5,7 @@
  */
 
 #include "ggm.h"
+#include "block.h"
 
 /******************************************************************************
  * LUT based cosine function - generated by ./tools/lut.py
@@ -52,7 +53,7 @@ static const float COS_LUT_data[COS_LUT_SIZE << 1] = {
 #define FRAC_MASK ((1U << FRAC_BITS) - 1)
 #define FRAC_SCALE (1.f / (float)FRAC_MASK)
 
-float cos_lookup(uint32_t x)
+static inline float cos_lut(uint32_t x)
 {
 	uint32_t idx = (x >> FRAC_BITS) << 1;
 	float frac = (x & FRAC_MASK) * FRAC_SCALE;
@@ -62,6 +63,100 @@ float cos_lookup(uint32_t x)
 	return y + (dy * frac);
 }
 
+float cos_lookup(uint32_t x)
+{
+	return cos_lut(x);
+}
+
+/******************************************************************************
+ * Block versions of the LUT based cosine function.
+ * The cpu specific versions are selected with the block operations and
+ * give the same results as cos_lookup().
+ */
+
+/* cos_lookup_scalar returns the cosine of a buffer of phase values */
+void cos_lookup_scalar(float *out, const uint32_t *x, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] = cos_lut(x[i]);
+	}
+}
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+/* cos_lookup_avx2 returns the cosine of a buffer of phase values (using gathers) */
+__attribute__((target("avx2"))) void cos_lookup_avx2(float *out, const uint32_t *x, size_t n)
+{
+	const __m256i mask = _mm256_set1_epi32(FRAC_MASK);
+	const __m256 scale = _mm256_set1_ps(FRAC_SCALE);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i vx = _mm256_loadu_si256((const __m256i *)&x[i]);
+		__m256i idx = _mm256_slli_epi32(_mm256_srli_epi32(vx, FRAC_BITS), 1);
+		__m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(vx, mask)), scale);
+		__m256 y = _mm256_i32gather_ps(&COS_LUT_data[0], idx, 4);
+		__m256 dy = _mm256_i32gather_ps(&COS_LUT_data[1], idx, 4);
+		_mm256_storeu_ps(&out[i], _mm256_add_ps(y, _mm256_mul_ps(dy, frac)));
+	}
+	for (; i < n; i++) {
+		out[i] = cos_lut(x[i]);
+	}
+}
+
+#endif
+
+/* cos_lookup_buf returns the cosine of a buffer of phase values */
+void cos_lookup_buf(float *out, const uint32_t *x, size_t n)
+{
+	block_cos_lookup(out, x, n);
+}
+
+#define COS_BLOCK_SIZE 64 /* phase values generated per pass */
+
+/* cos_lookup_block returns the cosine of a phase ramp, x, x + xstep, ...
+ * The phase value after the last sample is returned.
+ */
+uint32_t cos_lookup_block(float *out, uint32_t x, uint32_t xstep, size_t n)
+{
+	uint32_t phase[COS_BLOCK_SIZE];
+
+	while (n > 0) {
+		size_t k = (n < COS_BLOCK_SIZE) ? n : COS_BLOCK_SIZE;
+		for (size_t i = 0; i < k; i++) {
+			phase[i] = x;
+			x += xstep;
+		}
+		block_cos_lookup(out, phase, k);
+		out += k;
+		n -= k;
+	}
+	return x;
+}
+
+/* phase_block returns the phase values of an oscillator, x, x + xstep, ...
+ * Frequency modulation (fm * kfm cycles per sample) is added to the step and
+ * phase modulation (pm radians) to the phase values. Either may be NULL.
+ * The phase after the last sample (without phase modulation) is returned.
+ */
+uint32_t phase_block(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float kfm, const float *pm, size_t n)
+{
+	if (fm != NULL) {
+		x = block_phase_fm(out, x, xstep, fm, kfm, n);
+	} else {
+		for (size_t i = 0; i < n; i++) {
+			out[i] = x;
+			x += xstep;
+		}
+	}
+	if (pm != NULL) {
+		block_phase_pm(out, pm, 1.f / Tau, n);
+	}
+	return x;
+}
+
 /******************************************************************************
  * LUT based exponential functions - generated by ./tools/exp.py
  */
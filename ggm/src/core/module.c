@@ -14,6 +14,7 @@ extern struct module_info delay_delay_module;
 extern struct module_info env_adsr_module;
 extern struct module_info filter_biquad_module;
 extern struct module_info filter_svf_module;
+extern struct module_info midi_bank_module;
 extern struct module_info midi_mono_module;
 extern struct module_info midi_poly_module;
 extern struct module_info mix_pan_module;
@@ -39,6 +40,7 @@ static const struct module_info *module_list[] = {
 	&env_adsr_module,
 	&filter_biquad_module,
 	&filter_svf_module,
+	&midi_bank_module,
 	&midi_mono_module,
 	&midi_poly_module,
 	&mix_pan_module,
@@ -60,6 +62,15 @@ static const struct module_info *module_list[] = {
 	NULL,
 };
 
+/* module_get_info returns the n-th registered module (or NULL) */
+const struct module_info *module_get_info(unsigned int n)
+{
+	if (n >= (sizeof(module_list) / sizeof(module_list[0])) - 1) {
+		return NULL;
+	}
+	return module_list[n];
+}
+
 /* module_find finds a module by name */
 static const struct module_info *module_find(const char *name)
 {
@@ -80,7 +91,7 @@ static const struct module_info *module_find(const char *name)
  */
 
 /* module_name constructs the full path name of the module */
-static char *module_name(struct module *p, const char *iname, int id)
+static char *module_name(struct synth *top, struct module *p, const char *iname, int id)
 {
 	char name[128];
 
@@ -101,11 +112,12 @@ static char *module_name(struct module *p, const char *iname, int id)
 	}
 	/* copy the name string into an allocated buffer */
 	size_t n = strlen(name);
-	char *s = ggm_calloc(n + 1, sizeof(char));
+	char *s = synth_calloc(top, n + 1, sizeof(char));
 	if (s == NULL) {
 		return NULL;
 	}
-	return strncpy(s, name, n);
+	memcpy(s, name, n);
+	return s;
 }
 
 /* module_create creates a module */
@@ -120,7 +132,7 @@ static struct module *module_create(struct synth *s, struct module *p, const cha
 	}
 
 	/* allocate the module */
-	struct module *m = ggm_calloc(1, sizeof(struct module));
+	struct module *m = synth_calloc(s, 1, sizeof(struct module));
 	if (m == NULL) {
 		goto error;
 	}
@@ -128,7 +140,7 @@ static struct module *module_create(struct synth *s, struct module *p, const cha
 	/* fill in the module data */
 	m->info = mi;
 	m->id = id;
-	m->name = module_name(p, mi->iname, m->id);
+	m->name = module_name(s, p, mi->iname, m->id);
 	m->parent = p;
 	m->top = s;
 
@@ -137,7 +149,7 @@ static struct module *module_create(struct synth *s, struct module *p, const cha
 	/* allocate link list headers for the output port destinations */
 	int n = port_count(mi->out);
 	if (n > 0) {
-		struct output_dst **dst = ggm_calloc(n, sizeof(void *));
+		struct output_dst **dst = synth_calloc(s, n, sizeof(void *));
 		if (dst == NULL) {
 			goto error;
 		}
@@ -162,14 +174,17 @@ static struct module *module_create(struct synth *s, struct module *p, const cha
 		}
 	}
 
+#if defined(GGM_PROFILE)
+	prof_module_add(m);
+#endif
 	return m;
 
 error:
 	LOG_ERR("could not create module %s", name);
 	if (m != NULL) {
-		ggm_free(m->dst);
-		ggm_free((void *)m->name);
-		ggm_free(m);
+		synth_free(s, m->dst);
+		synth_free(s, (void *)m->name);
+		synth_free(s, m);
 	}
 	return NULL;
 }
@@ -209,18 +224,22 @@ void module_del(struct module *m)
 
 	LOG_INF("%s", m->name);
 
+#if defined(GGM_PROFILE)
+	prof_module_del(m);
+#endif
+
 	/* free the sub-modules and private data */
 	m->info->free(m);
 
 	/* deallocate the lists of output destinations */
 	int n = port_count(m->info->out);
 	for (int i = 0; i < n; i++) {
-		port_free_dst_list(m->dst[i]);
+		port_free_dst_list(m->top, m->dst[i]);
 	}
 
-	ggm_free(m->dst);
-	ggm_free((void *)m->name);
-	ggm_free(m);
+	synth_free(m->top, m->dst);
+	synth_free(m->top, (void *)m->name);
+	synth_free(m->top, m);
 }
 
 /*****************************************************************************/
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Shared Parameters
+ */
+
+#include "ggm.h"
+
+/******************************************************************************
+ * param_find returns the shared param for a synth configuration entry and
+ * input port (or NULL if there is none).
+ */
+
+struct param *param_find(struct synth *s, const void *cfg, const struct port_info *pi)
+{
+	for (struct param *p = s->params; p != NULL; p = p->next) {
+		if (p->cfg == cfg && p->pi == pi) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * param_new returns the param for a named input port of a module.
+ * It is called by the module alloc function, before the ports are configured.
+ * If the port is in the synth configuration the param is shared with the
+ * other ports matched by the same entry, otherwise it is private to the
+ * module. val is the initial value of a new param.
+ */
+
+struct param *param_new(struct module *m, const char *name, float val)
+{
+	struct synth *s = m->top;
+
+	const struct port_info *pi = port_get_info(m->info->in, name);
+	if (pi == NULL || pi->vf == NULL) {
+		LOG_ERR("%s:%s is not a parameter port", m->name, name);
+		return NULL;
+	}
+
+	/* look for a shared param */
+	char path[128];
+	snprintf(path, sizeof(path), "%s:%s", m->name, name);
+	const void *cfg = synth_lookup_cfg(s, path);
+	if (cfg != NULL) {
+		struct param *p = param_find(s, cfg, pi);
+		if (p != NULL) {
+			return p;
+		}
+	}
+
+	/* allocate a new param */
+	struct param *p = synth_calloc(s, 1, sizeof(struct param));
+	if (p == NULL) {
+		return NULL;
+	}
+	p->val = val;
+	p->top = s;
+	p->pi = pi;
+	p->cfg = cfg;
+
+	if (cfg != NULL) {
+		LOG_DBG("%s shared", path);
+		p->next = s->params;
+		s->params = p;
+	}
+	return p;
+}
+
+/*****************************************************************************/
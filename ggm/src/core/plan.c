@@ -0,0 +1,344 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Compiled Execution Plans
+ *
+ * plan_new() compiles a module into a plan. A module with a compile function
+ * adds steps for its sub-modules and its own kernels. Any other module is a
+ * single step that calls its process function.
+ *
+ * Buffers are referred to by index while compiling. Buffers 0..nio-1 are the
+ * buffers passed to plan_run (the module audio input then output ports),
+ * the others are internal buffers allocated with plan_buf. Internal buffers
+ * are mapped to a smaller number of buffer slots using their live ranges.
+ * An unconnected module input (PLAN_NONE) is passed to the kernel as NULL.
+ *
+ * Compile errors are recorded in the plan and checked by plan_new, so compile
+ * functions don't need to check each step.
+ */
+
+#include "ggm.h"
+
+/******************************************************************************
+ * compile functions
+ */
+
+#define PLAN_ALLOC 16           /* initial number of steps/indices */
+
+/* plan_grow makes space for one more element in an array */
+static void *plan_grow(struct plan *p, void *ptr, int n, int *max, size_t size)
+{
+	if (n < *max) {
+		return ptr;
+	}
+	int k = (*max == 0) ? PLAN_ALLOC : *max * 2;
+	void *x = ggm_calloc(k, size);
+	if (x == NULL) {
+		LOG_ERR("could not allocate plan");
+		p->err = true;
+		return NULL;
+	}
+	if (ptr != NULL) {
+		memcpy(x, ptr, n * size);
+		ggm_free(ptr);
+	}
+	*max = k;
+	return x;
+}
+
+/* plan_buf returns the index of a new internal buffer */
+int plan_buf(struct plan *p)
+{
+	return p->nio + p->nbufs++;
+}
+
+/* plan_step adds a kernel step and returns the step index */
+int plan_step(struct plan *p, plan_func func, struct module *m, const int *bufs, int nbufs, int cond)
+{
+	if (p->err) {
+		return -1;
+	}
+
+	/* add the buffer indices */
+	int ofs = p->nidx;
+	for (int i = 0; i < nbufs; i++) {
+		int *x = plan_grow(p, p->idx, p->nidx, &p->maxidx, sizeof(int));
+		if (x == NULL) {
+			return -1;
+		}
+		p->idx = x;
+		p->idx[p->nidx++] = bufs[i];
+	}
+
+	/* add the step */
+	struct plan_step *x = plan_grow(p, p->step, p->nsteps, &p->maxsteps, sizeof(struct plan_step));
+	if (x == NULL) {
+		return -1;
+	}
+	p->step = x;
+	x = &p->step[p->nsteps];
+	x->func = func;
+	x->m = m;
+	x->ofs = ofs;
+	x->nbufs = nbufs;
+	x->cond = cond;
+	return p->nsteps++;
+}
+
+/* plan_module adds the steps for a module and returns the step index of the module result */
+int plan_module(struct plan *p, struct module *m, const int *bufs, int cond)
+{
+	const struct module_info *mi = m->info;
+
+	if (mi->compile != NULL) {
+		return mi->compile(m, p, bufs, cond);
+	}
+	if (mi->process == NULL) {
+		LOG_ERR("%s has no process function", m->name);
+		p->err = true;
+		return -1;
+	}
+	int nbufs = port_count_by_type(mi->in, PORT_TYPE_AUDIO) + port_count_by_type(mi->out, PORT_TYPE_AUDIO);
+	return plan_step(p, mi->process, m, bufs, nbufs, cond);
+}
+
+/* plan_module_out adds the steps for a module with unconnected audio inputs
+ * (E.g. oscillator modulation inputs). bufs are the module output buffers.
+ */
+int plan_module_out(struct plan *p, struct module *m, const int *bufs, int cond)
+{
+	const struct module_info *mi = m->info;
+	int n_in = (int)port_count_by_type(mi->in, PORT_TYPE_AUDIO);
+	int n_out = (int)port_count_by_type(mi->out, PORT_TYPE_AUDIO);
+	int x[MAX_AUDIO_PORTS];
+
+	if (n_in + n_out > MAX_AUDIO_PORTS) {
+		LOG_ERR("%s has too many audio ports", m->name);
+		p->err = true;
+		return -1;
+	}
+	for (int i = 0; i < n_in; i++) {
+		x[i] = PLAN_NONE;
+	}
+	for (int i = 0; i < n_out; i++) {
+		x[n_in + i] = bufs[i];
+	}
+	return plan_module(p, m, x, cond);
+}
+
+/* plan_slots assigns a buffer slot to each internal buffer.
+ * A buffer is live from its first to its last step. It gets a free slot at its
+ * first step and frees it after its last step, so buffers used by the same step
+ * never share a slot.
+ */
+static int plan_slots(struct plan *p)
+{
+	int *first = NULL;
+	int *last = NULL;
+	int *avail = NULL;
+	int navail = 0;
+	int rc = -1;
+
+	if (p->nbufs == 0) {
+		return 0;
+	}
+
+	first = ggm_calloc(p->nbufs, sizeof(int));
+	last = ggm_calloc(p->nbufs, sizeof(int));
+	avail = ggm_calloc(p->nbufs, sizeof(int));
+	p->slot = ggm_calloc(p->nbufs, sizeof(int));
+	if (first == NULL || last == NULL || avail == NULL || p->slot == NULL) {
+		goto exit;
+	}
+
+	/* find the live range of each buffer */
+	for (int i = 0; i < p->nbufs; i++) {
+		first[i] = -1;
+		p->slot[i] = -1;
+	}
+	for (int i = 0; i < p->nsteps; i++) {
+		struct plan_step *x = &p->step[i];
+		for (int j = 0; j < x->nbufs; j++) {
+			int k = p->idx[x->ofs + j] - p->nio;
+			if (k >= 0) {
+				if (first[k] < 0) {
+					first[k] = i;
+				}
+				last[k] = i;
+			}
+		}
+	}
+
+	/* assign the slots in step order */
+	for (int i = 0; i < p->nsteps; i++) {
+		struct plan_step *x = &p->step[i];
+		for (int j = 0; j < x->nbufs; j++) {
+			int k = p->idx[x->ofs + j] - p->nio;
+			if (k >= 0 && p->slot[k] < 0) {
+				p->slot[k] = (navail > 0) ? avail[--navail] : p->nslots++;
+			}
+		}
+		for (int j = 0; j < x->nbufs; j++) {
+			int k = p->idx[x->ofs + j] - p->nio;
+			if (k >= 0 && last[k] == i) {
+				avail[navail++] = p->slot[k];
+				last[k] = -1;
+			}
+		}
+	}
+	rc = 0;
+
+exit:
+	ggm_free(first);
+	ggm_free(last);
+	ggm_free(avail);
+	return rc;
+}
+
+/* plan_link allocates the step buffer pointers */
+static int plan_link(struct plan *p)
+{
+	if (p->nidx == 0) {
+		return 0;
+	}
+
+	p->ptr = ggm_calloc(p->nidx, sizeof(float *));
+	p->io = ggm_calloc(p->nidx, sizeof(struct plan_io));
+	if (p->ptr == NULL || p->io == NULL) {
+		return -1;
+	}
+
+	for (int i = 0; i < p->nidx; i++) {
+		int idx = p->idx[i];
+		if (idx >= 0 && idx < p->nio) {
+			/* assigned by plan_run */
+			p->io[p->nfix].ptr = &p->ptr[i];
+			p->io[p->nfix].idx = idx;
+			p->nfix++;
+		}
+	}
+
+	for (int i = 0; i < p->nsteps; i++) {
+		struct plan_step *x = &p->step[i];
+		x->bufs = (x->nbufs > 0) ? &p->ptr[x->ofs] : NULL;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * plan_set_bufs sets the memory for the plan buffer slots. The memory is
+ * nslots buffers from synth_buf_alloc. If buf is NULL they are allocated.
+ * Plans that never run at the same time can share the same memory.
+ */
+
+int plan_set_bufs(struct plan *p, float *buf)
+{
+	size_t bufstride = p->top->bufstride;
+
+	if (buf == NULL && p->nslots > 0) {
+		buf = synth_buf_alloc(p->top, p->nslots);
+		if (buf == NULL) {
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < p->nidx; i++) {
+		int k = p->idx[i] - p->nio;
+		if (k >= 0) {
+			p->ptr[i] = &buf[p->slot[k] * bufstride];
+		}
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * plan new/del
+ */
+
+/* plan_new compiles a module into a plan. Use plan_set_bufs before running it. */
+struct plan *plan_new(struct module *m)
+{
+	const struct module_info *mi = m->info;
+	int bufs[MAX_AUDIO_PORTS];
+
+	struct plan *p = ggm_calloc(1, sizeof(struct plan));
+
+	if (p == NULL) {
+		LOG_ERR("could not allocate plan");
+		return NULL;
+	}
+	p->top = m->top;
+
+	/* the module buffers are the plan_run buffers */
+	p->nio = port_count_by_type(mi->in, PORT_TYPE_AUDIO) + port_count_by_type(mi->out, PORT_TYPE_AUDIO);
+	if (p->nio > MAX_AUDIO_PORTS) {
+		LOG_ERR("%s has too many audio ports", m->name);
+		goto error;
+	}
+	for (int i = 0; i < p->nio; i++) {
+		bufs[i] = i;
+	}
+
+	p->result = plan_module(p, m, bufs, -1);
+	if (p->err || p->result < 0) {
+		LOG_ERR("could not compile %s", m->name);
+		goto error;
+	}
+
+	if (plan_slots(p) != 0 || plan_link(p) != 0) {
+		LOG_ERR("could not allocate plan");
+		goto error;
+	}
+
+	LOG_DBG("%s: %d steps, %d buffers in %d slots", m->name, p->nsteps, p->nbufs, p->nslots);
+	return p;
+
+error:
+	plan_del(p);
+	return NULL;
+}
+
+/* plan_del deallocates a plan */
+void plan_del(struct plan *p)
+{
+	if (p == NULL) {
+		return;
+	}
+	ggm_free(p->step);
+	ggm_free(p->idx);
+	ggm_free(p->ptr);
+	ggm_free(p->io);
+	ggm_free(p->slot);
+	ggm_free(p);
+}
+
+/******************************************************************************
+ * plan_run runs the plan steps for n samples. The buffers are the module audio
+ * input then output buffers. It returns the module result.
+ */
+
+bool plan_run(struct plan *p, float *bufs[], size_t n)
+{
+	for (int i = 0; i < p->nfix; i++) {
+		*p->io[i].ptr = bufs[p->io[i].idx];
+	}
+
+	for (int i = 0; i < p->nsteps; i++) {
+		struct plan_step *x = &p->step[i];
+		if (x->cond >= 0 && !p->step[x->cond].active) {
+			x->active = false;
+			continue;
+		}
+		PROF_START(t0);
+		x->active = x->func(x->m, x->bufs, n);
+		PROF_END(&x->m->prof, t0, synth_frame(p->top));
+	}
+
+	return p->step[p->result].active;
+}
+
+/*****************************************************************************/
@@ -74,6 +74,20 @@ const struct port_info *port_get_info(
 	return (i >= 0) ? &port[i] : NULL;
 }
 
+/* port_get_hdl resolves a named input port of a module to a port handle.
+ * It returns -1 if the module doesn't have the port. Events sent to the
+ * handle are then ignored.
+ */
+int port_get_hdl(struct port_hdl *h, struct module *m, const char *name)
+{
+	const struct port_info *pi = port_get_info(m->info->in, name);
+
+	h->m = m;
+	h->pf = (pi != NULL) ? pi->pf : NULL;
+	h->bf = (pi != NULL) ? pi->bf : NULL;
+	return (h->pf != NULL) ? 0 : -1;
+}
+
 /* port_get_index_by_type gets the index of the n-th port of a given type */
 int port_get_index_by_type(
 	const struct port_info port[],
@@ -175,7 +189,7 @@ static port_func port_fwd[NUM_PORT_FWD] = {
 void port_add_dst(struct module *m, int idx, struct module *dst, port_func func)
 {
 	/* allocate the output destination */
-	struct output_dst *x = ggm_calloc(1, sizeof(struct output_dst));
+	struct output_dst *x = synth_calloc(m->top, 1, sizeof(struct output_dst));
 
 	if (x == NULL) {
 		LOG_ERR("unable to allocate output destination list element");
@@ -195,11 +209,11 @@ void port_add_dst(struct module *m, int idx, struct module *dst, port_func func)
 }
 
 /* port_free_dst_list frees a list of output destination elements */
-void port_free_dst_list(struct output_dst *ptr)
+void port_free_dst_list(struct synth *s, struct output_dst *ptr)
 {
 	while (ptr != NULL) {
 		struct output_dst *next = ptr->next;
-		ggm_free(ptr);
+		synth_free(s, ptr);
 		ptr = next;
 	}
 }
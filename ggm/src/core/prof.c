@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * CPU Profiling
+ *
+ * Each plan step is timed and added to the counters of the step module.
+ * Modules that run sub-plans (E.g. midi/poly) include the time of their
+ * voices. The synth loop is timed for the DSP load, the fraction of the
+ * buffer period used to process a buffer. A load over 100% is an xrun.
+ */
+
+#include "ggm.h"
+
+#if defined(GGM_PROFILE)
+
+/******************************************************************************
+ * counters
+ */
+
+/* prof_init initialises the counters */
+void prof_init(struct prof_stats *ps)
+{
+	atomic_init(&ps->n, 0);
+	atomic_init(&ps->sum, 0);
+	atomic_init(&ps->min, UINT32_MAX);
+	atomic_init(&ps->max, 0);
+	atomic_init(&ps->frame, UINT32_MAX);
+	atomic_init(&ps->last, 0);
+}
+
+/* prof_take copies and resets the counters */
+void prof_take(struct prof_stats *ps, struct prof_data *pd)
+{
+	pd->n = atomic_exchange_explicit(&ps->n, 0, memory_order_relaxed);
+	pd->sum = atomic_exchange_explicit(&ps->sum, 0, memory_order_relaxed);
+	pd->min = atomic_exchange_explicit(&ps->min, UINT32_MAX, memory_order_relaxed);
+	pd->max = atomic_exchange_explicit(&ps->max, 0, memory_order_relaxed);
+}
+
+/******************************************************************************
+ * module list
+ */
+
+/* prof_module_add adds a module to the synth profile list */
+void prof_module_add(struct module *m)
+{
+	struct synth *s = m->top;
+
+	prof_init(&m->prof);
+	m->prof_next = s->prof_list;
+	s->prof_list = m;
+}
+
+/* prof_module_del removes a module from the synth profile list */
+void prof_module_del(struct module *m)
+{
+	struct module **x = &m->top->prof_list;
+
+	while (*x != NULL) {
+		if (*x == m) {
+			*x = m->prof_next;
+			return;
+		}
+		x = &(*x)->prof_next;
+	}
+}
+
+/******************************************************************************
+ * prof_buffer gets the modules that ran in the buffer starting at frame, in
+ * order of decreasing time. It returns the number of modules (at most n).
+ * It is called by the audio thread after synth_loop (E.g. to capture the
+ * slowest buffer).
+ */
+
+int prof_buffer(struct synth *s, uint32_t frame, struct prof_module *x, int n)
+{
+	int k = 0;
+
+	for (struct module *m = s->prof_list; m != NULL; m = m->prof_next) {
+		if (atomic_load_explicit(&m->prof.frame, memory_order_relaxed) != frame) {
+			continue;
+		}
+		uint32_t t = atomic_load_explicit(&m->prof.last, memory_order_relaxed);
+		/* insertion sort, dropping the fastest module when full */
+		int i = (k < n) ? k++ : n;
+		while (i > 0 && x[i - 1].ticks < t) {
+			if (i < n) {
+				x[i] = x[i - 1];
+			}
+			i--;
+		}
+		if (i < n) {
+			x[i].name = m->name;
+			x[i].ticks = t;
+		}
+	}
+	return k;
+}
+
+/******************************************************************************
+ * prof_dump logs the DSP load and the module times since the last call.
+ * It is called from a non-realtime thread, modules must not be added or
+ * deleted while it runs.
+ */
+
+void prof_dump(struct synth *s)
+{
+	float tps = (float)ggm_ticks_per_sec();
+	float tpb = tps * (float)s->bufsize / (float)s->rate;   /* ticks per buffer */
+	float us = 1e6f / tps;                                  /* microseconds per tick */
+	struct prof_data pd;
+
+	prof_take(&s->prof, &pd);
+	if (pd.n == 0) {
+		return;
+	}
+	float nbufs = (float)pd.n;
+	LOG_INF("dsp load avg %.1f%% max %.1f%% (%u buffers)",
+		100.f * (float)pd.sum / (nbufs * tpb), 100.f * (float)pd.max / tpb, pd.n);
+
+	for (struct module *m = s->prof_list; m != NULL; m = m->prof_next) {
+		prof_take(&m->prof, &pd);
+		if (pd.n == 0) {
+			continue;
+		}
+		float avg = (float)pd.sum / (float)pd.n;
+		LOG_INF("%-32s %8u calls, min/avg/max %.2f/%.2f/%.2f us, load %.2f%%",
+			m->name, pd.n, (float)pd.min * us, avg * us, (float)pd.max * us,
+			100.f * (float)pd.sum / (nbufs * tpb));
+	}
+}
+
+#endif
+
+/*****************************************************************************/
@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Lock-Free Event Queues
+ *
+ * Each slot has a sequence number. A slot at position pos can be written
+ * when seq == pos and read when seq == pos + 1. After a read the slot is
+ * given to the producer for the next lap of the ring (seq = pos + n).
+ * See: Dmitry Vyukov's bounded MPMC queue.
+ */
+
+#include "ggm.h"
+
+/******************************************************************************
+ * event_queue_init allocates a queue with n slots (a power of 2).
+ */
+
+int event_queue_init(struct event_queue *q, size_t n, bool mp)
+{
+	if (n < 2 || (n & (n - 1)) != 0) {
+		LOG_ERR("queue size %u is not a power of 2", (unsigned int)n);
+		return -1;
+	}
+
+	struct qslot *slot = ggm_calloc(n, sizeof(struct qslot));
+	if (slot == NULL) {
+		LOG_ERR("could not allocate queue");
+		return -1;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		atomic_init(&slot[i].seq, i);
+	}
+
+	q->slot = slot;
+	q->mask = n - 1;
+	q->mp = mp;
+	atomic_init(&q->wr, 0);
+	q->rd = 0;
+	atomic_init(&q->overflow, 0);
+	return 0;
+}
+
+/* event_queue_free deallocates the queue slots */
+void event_queue_free(struct event_queue *q)
+{
+	ggm_free(q->slot);
+	q->slot = NULL;
+}
+
+/******************************************************************************
+ * event_queue_wr writes an event to the queue (producer side).
+ * It returns -1 if the queue is full.
+ */
+
+int event_queue_wr(struct event_queue *q, const struct qevent *qe)
+{
+	size_t pos = atomic_load_explicit(&q->wr, memory_order_relaxed);
+	struct qslot *x;
+
+	while (1) {
+		x = &q->slot[pos & q->mask];
+		size_t seq = atomic_load_explicit(&x->seq, memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+		if (dif == 0) {
+			/* the slot is free, reserve it */
+			if (!q->mp) {
+				atomic_store_explicit(&q->wr, pos + 1, memory_order_relaxed);
+				break;
+			}
+			if (atomic_compare_exchange_weak_explicit(&q->wr, &pos, pos + 1,
+								  memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (dif < 0) {
+			/* the queue is full */
+			atomic_fetch_add_explicit(&q->overflow, 1, memory_order_relaxed);
+			return -1;
+		} else {
+			/* another producer took the slot */
+			pos = atomic_load_explicit(&q->wr, memory_order_relaxed);
+		}
+	}
+
+	/* copy the event data and give the slot to the consumer */
+	memcpy(&x->qe, qe, sizeof(struct qevent));
+	atomic_store_explicit(&x->seq, pos + 1, memory_order_release);
+	return 0;
+}
+
+/******************************************************************************
+ * Consumer side functions.
+ */
+
+/* event_queue_peek returns the next event in the queue (or NULL) without reading it */
+const struct qevent *event_queue_peek(struct event_queue *q)
+{
+	struct qslot *x = &q->slot[q->rd & q->mask];
+	size_t seq = atomic_load_explicit(&x->seq, memory_order_acquire);
+
+	if (seq != q->rd + 1) {
+		/* no events */
+		return NULL;
+	}
+	return &x->qe;
+}
+
+/* event_queue_rd reads an event from the queue. It returns -1 if the queue is empty. */
+int event_queue_rd(struct event_queue *q, struct qevent *qe)
+{
+	struct qslot *x = &q->slot[q->rd & q->mask];
+	size_t seq = atomic_load_explicit(&x->seq, memory_order_acquire);
+
+	if (seq != q->rd + 1) {
+		/* no events */
+		return -1;
+	}
+
+	/* copy the event data and give the slot back to the producers */
+	memcpy(qe, &x->qe, sizeof(struct qevent));
+	atomic_store_explicit(&x->seq, q->rd + q->mask + 1, memory_order_release);
+	q->rd++;
+	return 0;
+}
+
+/*****************************************************************************/
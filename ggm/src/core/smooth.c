@@ -0,0 +1,65 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Smoothed Parameters
+ */
+
+#include "ggm.h"
+
+/******************************************************************************
+ * The one-pole ramp is within 0.1% of the step to the target at the end of
+ * the ramp time, it then jumps to the target.
+ */
+
+#define LN_SMOOTH_EPSILON (-6.9077553f)  /* ln(0.001) */
+
+/* smooth_init initialises a smoothed value with a ramp time (secs) */
+void smooth_init(struct smooth *sm, enum smooth_type type, float time, unsigned int rate, float x)
+{
+	uint32_t len = (uint32_t)(clampf_lo(time, 0.f) * (float)rate);
+
+	sm->type = type;
+	sm->len = (len == 0) ? 1 : len;
+	sm->k = 1.f - powe(LN_SMOOTH_EPSILON / (float)sm->len);
+	smooth_reset(sm, x);
+}
+
+/* smooth_set sets the target value and starts a ramp to it */
+void smooth_set(struct smooth *sm, float target)
+{
+	sm->target = target;
+	sm->step = (target - sm->x) / (float)sm->len;
+	sm->n = sm->len;
+}
+
+/* smooth_reset sets the value without a ramp */
+void smooth_reset(struct smooth *sm, float x)
+{
+	sm->x = x;
+	sm->target = x;
+	sm->step = 0.f;
+	sm->n = 0;
+}
+
+/* smooth_block steps the value by n samples and returns it */
+float smooth_block(struct smooth *sm, size_t n)
+{
+	if (n >= sm->n) {
+		sm->x = sm->target;
+		sm->n = 0;
+		return sm->x;
+	}
+	if (sm->type == SMOOTH_LINEAR) {
+		sm->x += sm->step * (float)n;
+		sm->n -= n;
+	} else {
+		for (size_t i = 0; i < n; i++) {
+			smooth_next(sm);
+		}
+	}
+	return sm->x;
+}
+
+/*****************************************************************************/
@@ -7,61 +7,98 @@
 #include "ggm.h"
 
 /******************************************************************************
- * event queue - events are dispatched to modules between calls to process
- * audio buffers. Events generated during buffer processing are queued and then
- * dispatched after the buffer processing is completed.
+ * event queues
+ *
+ * Process time events: events generated during buffer processing are queued
+ * and then dispatched after the buffer processing is completed. The audio
+ * thread is the producer and the consumer.
+ *
+ * Input events: other threads (E.g. control, network, UI) send events to
+ * module input ports through the input queue. The audio thread dispatches
+ * them at their sample frame time (see synth_loop). Events should be sent
+ * in time order, an event waits for the events ahead of it in the queue.
  */
 
-/* synth_event_rd reads an event from the event queue */
-static int synth_event_rd(struct synth *s, struct qevent *e)
+/* synth_event_wr writes a process time event to the event queue */
+int synth_event_wr(struct synth *s, struct module *m, int idx, const struct event *e)
 {
-	struct event_queue *eq = &s->eq;
-	int rc = 0;
-
-	/* do we have events? */
-	if (eq->rd == eq->wr) {
-		/* no events */
-		rc = -1;
-		goto exit;
-	}
+	struct qevent q;
 
-	/* copy the event data */
-	struct qevent *x = &eq->queue[eq->rd];
-	memcpy(e, x, sizeof(struct qevent));
+	q.m = m;
+	q.idx = idx;
+	q.func = NULL;
+	q.time = atomic_load_explicit(&s->frame, memory_order_relaxed);
+	memcpy(&q.e, e, sizeof(struct event));
+	return event_queue_wr(&s->eq, &q);
+}
 
-	/* advance the read index */
-	eq->rd = (eq->rd + 1) & (NUM_EVENTS - 1);
+/* synth_event_in sends an event to an input port function of a module.
+ * It can be called from any thread. The event takes effect at sample frame
+ * time (see synth_frame). It returns -1 if the input queue is full.
+ */
+int synth_event_in(struct synth *s, struct module *m, port_func func, const struct event *e, uint32_t time)
+{
+	struct qevent q;
 
-exit:
-	return rc;
+	q.m = m;
+	q.idx = 0;
+	q.func = func;
+	q.time = time;
+	memcpy(&q.e, e, sizeof(struct event));
+	return event_queue_wr(&s->iq, &q);
 }
 
-/* synth_event_wr writes an event to the event queue */
-int synth_event_wr(struct synth *s, struct module *m, int idx, const struct event *e)
+/* synth_midi_in sends a MIDI event to the MIDI input port of the root patch.
+ * It can be called from any thread once the root patch is set.
+ */
+int synth_midi_in(struct synth *s, const struct event *e, uint32_t time)
 {
-	struct event_queue *eq = &s->eq;
-	int rc = 0;
-
-	/* do we have queue space? */
-	size_t wr = (eq->wr + 1) & (NUM_EVENTS - 1);
+	struct module *m = s->root;
 
-	if (wr == eq->rd) {
-		/* the queue is full */
-		rc = -1;
-		goto exit;
+	if (m == NULL) {
+		return -1;
+	}
+	const struct port_info *pi = port_get_info_by_type(m->info->in, PORT_TYPE_MIDI, 0);
+	if (pi == NULL) {
+		return -1;
 	}
+	return synth_event_in(s, m, pi->pf, e, time);
+}
 
-	/* copy the event data */
-	struct qevent *x = &eq->queue[eq->wr];
-	x->m = m;
-	x->idx = idx;
-	memcpy(&x->e, e, sizeof(struct event));
+/* synth_frame returns the sample frame at the start of the current buffer */
+uint32_t synth_frame(struct synth *s)
+{
+	return atomic_load_explicit(&s->frame, memory_order_relaxed);
+}
 
-	/* advance the write index */
-	eq->wr = wr;
+/* synth_set_input_queue sets the size of the input event queue and whether
+ * it has multiple producer threads. It must be called before the root patch
+ * is set.
+ */
+int synth_set_input_queue(struct synth *s, size_t n, bool mp)
+{
+	struct event_queue q;
+
+	if (s->root != NULL) {
+		LOG_ERR("can't change the input queue after the root patch is set");
+		return -1;
+	}
+	if (event_queue_init(&q, n, mp) != 0) {
+		return -1;
+	}
+	event_queue_free(&s->iq);
+	memcpy(&s->iq, &q, sizeof(struct event_queue));
+	return 0;
+}
 
-exit:
-	return rc;
+/* synth_event_dispatch sends a queued event to its destination */
+static void synth_event_dispatch(const struct qevent *q)
+{
+	if (q->func != NULL) {
+		q->func(q->m, &q->e);
+	} else {
+		event_out(q->m, q->idx, &q->e);
+	}
 }
 
 /******************************************************************************
@@ -78,7 +115,143 @@ struct synth *synth_new(void)
 		return NULL;
 	}
 	LOG_INF("synth (%d bytes)", sizeof(struct synth));
+
+	/* allocate the event queues */
+	if (event_queue_init(&s->eq, NUM_EVENTS, false) != 0) {
+		goto error;
+	}
+	if (event_queue_init(&s->iq, NUM_INPUT_EVENTS, true) != 0) {
+		goto error;
+	}
+	atomic_init(&s->frame, 0);
+#if defined(GGM_PROFILE)
+	prof_init(&s->prof);
+#endif
+	arena_init(&s->abuf, BUF_CHUNK_SIZE);
+	arena_init(&s->amod, MOD_CHUNK_SIZE);
+
+	/* select the block operations for this cpu */
+	block_init();
+
+	/* default tuning, audio rate and buffer size */
+	tuning_set(&s->tuning, NULL);
+	synth_set_audio(s, AudioSampleFrequency, AudioBufferSize);
 	return s;
+
+error:
+	event_queue_free(&s->eq);
+	event_queue_free(&s->iq);
+	ggm_free(s);
+	return NULL;
+}
+
+/******************************************************************************
+ * synth_set_audio sets the audio sample rate and buffer size of the synth.
+ * The driver calls this once it knows the rate/size of the audio device.
+ * Modules read these values when they are created, so it must be called
+ * before the root patch is created.
+ */
+
+int synth_set_audio(struct synth *s, unsigned int rate, size_t bufsize)
+{
+	if (s->root != NULL) {
+		LOG_ERR("can't change audio settings after the root patch is set");
+		return -1;
+	}
+	if (rate == 0) {
+		LOG_ERR("bad sample rate %u", rate);
+		return -1;
+	}
+	if (bufsize == 0 || bufsize > MaxAudioBufferSize) {
+		LOG_ERR("bad buffer size %u (max %u)", (unsigned int)bufsize, (unsigned int)MaxAudioBufferSize);
+		return -1;
+	}
+	s->rate = rate;
+	s->bufsize = bufsize;
+	s->bufstride = (bufsize + (BUF_ALIGN / sizeof(float)) - 1) & ~((BUF_ALIGN / sizeof(float)) - 1);
+	s->period = 1.f / (float)rate;
+	s->fscale = (float)FullCycle / (float)rate;
+	tuning_update(&s->tuning, s->fscale);
+	s->load_k = (float)rate / ((float)ggm_ticks_per_sec() * (float)bufsize);
+	LOG_INF("%u Hz, %u samples/buffer", rate, (unsigned int)bufsize);
+	return 0;
+}
+
+/******************************************************************************
+ * synth_buf_alloc allocates n audio buffers from the synth buffer arena.
+ * The buffers are bufstride samples apart and aligned for SIMD operations.
+ * They are deallocated when the synth is deleted.
+ */
+
+float *synth_buf_alloc(struct synth *s, unsigned int n)
+{
+	return arena_alloc(&s->abuf, n * s->bufstride * sizeof(float), BUF_ALIGN);
+}
+
+/******************************************************************************
+ * synth_calloc allocates module memory from the synth module arena.
+ * Modules use it for all of the memory they allocate when they are created.
+ * The memory is freed all at once when the synth is deleted.
+ */
+
+void *synth_calloc(struct synth *s, size_t num, size_t size)
+{
+	return arena_alloc(&s->amod, num * size, MOD_ALIGN);
+}
+
+/* synth_free frees module memory (a no-op, the arena is freed by synth_del) */
+void synth_free(struct synth *s, void *ptr)
+{
+}
+
+/******************************************************************************
+ * synth_set_threads sets the number of threads used to process the audio.
+ * The audio thread is one of them, so nthreads - 1 worker threads are created.
+ * Modules that can process in parallel (E.g. midi/poly) setup for it when they
+ * are created, so it must be called before the root patch is created.
+ * priority is the real-time priority of the audio thread (0 if it isn't
+ * real-time), the worker threads run at the same priority. If they can't be
+ * created the audio is processed on the audio thread alone.
+ */
+
+int synth_set_threads(struct synth *s, unsigned int nthreads, int priority)
+{
+	if (s->root != NULL) {
+		LOG_ERR("can't change the number of threads after the root patch is set");
+		return -1;
+	}
+
+	ggm_pool_del(s->pool);
+	s->pool = NULL;
+
+	if (nthreads > 1) {
+		s->pool = ggm_pool_new(nthreads - 1, priority);
+		if (s->pool == NULL) {
+			LOG_ERR("could not create worker threads, parallel processing is disabled");
+			nthreads = 1;
+		}
+	}
+	LOG_INF("%u threads", (nthreads > 1) ? nthreads : 1);
+	return 0;
+}
+
+/******************************************************************************
+ * synth_set_tuning sets the scale used to map MIDI notes to oscillator
+ * frequencies (NULL for 12-TET). The audio thread reads the tuning, so it
+ * must be called before the root patch is set.
+ */
+
+int synth_set_tuning(struct synth *s, const struct tuning_scale *sc)
+{
+	if (s->root != NULL) {
+		LOG_ERR("can't change the tuning after the root patch is set");
+		return -1;
+	}
+	if (tuning_set(&s->tuning, sc) != 0) {
+		return -1;
+	}
+	tuning_update(&s->tuning, s->fscale);
+	return 0;
 }
 
 /******************************************************************************
@@ -91,10 +264,25 @@ void synth_del(struct synth *s)
 		return;
 	}
 
+	plan_del(s->plan);
 	module_del(s->root);
 
-	/* free the allocated audio buffers */
-	ggm_free(s->bufs[0]);
+	/* stop the worker threads */
+	ggm_pool_del(s->pool);
+
+	/* free the event queues */
+	event_queue_free(&s->eq);
+	event_queue_free(&s->iq);
+
+	/* free the MIDI map */
+	for (int i = 0; i < s->nmaps; i++) {
+		ggm_free(s->mmap[i].mme);
+	}
+	ggm_free(s->mmap);
+
+	/* free the allocated audio buffers and module memory */
+	arena_free(&s->abuf);
+	arena_free(&s->amod);
 	ggm_free(s);
 }
 
@@ -179,10 +367,13 @@ int synth_set_cfg(struct synth *s, const struct synth_cfg *cfg)
 /* synth_lookup_cfg looks for a path match in the synth configuration.
  * If a match is found it returns the configuration structure pointer.
  */
-static const void *synth_lookup_cfg(struct synth *s, const char *path)
+const void *synth_lookup_cfg(struct synth *s, const char *path)
 {
 	const struct synth_cfg *sc = s->cfg;
 
+	if (sc == NULL) {
+		return NULL;
+	}
 	while (sc->path != NULL) {
 		if (match(sc->path, path)) {
 			return sc->cfg;
@@ -195,49 +386,57 @@ static const void *synth_lookup_cfg(struct synth *s, const char *path)
 /******************************************************************************
  * Incoming MIDI CC messages are sent directly to the sub-module(s) for which
  * they are relevant. The map is between a module:port path and the MIDI
- * channel:cc numbers.
+ * channel:cc numbers. It is built as the modules are created. A channel/cc
+ * index gives the map slot, the slot has an array of the mapped ports.
  */
 
-/* synth_lookup_midi_map looks for the given ch/cc values in the MIDI map.
- * If alloc is true it will return a pointer to a new slot (if available).
- */
-static struct midi_map *synth_lookup_midi_map(struct synth *s, int id, bool alloc)
+/* synth_grow makes space for one more element in an array */
+static void *synth_grow(void *ptr, int n, int *max, size_t size)
 {
-	struct midi_map *mm = &s->mmap[0];
-
-	for (int i = 0; i < NUM_MIDI_MAP_SLOTS; i++) {
-		/* does this slot match? */
-		if (mm[i].id == id) {
-			return &mm[i];
-		}
-		/* is the slot empty? */
-		if (mm[i].id == 0) {
-			if (alloc) {
-				/* allocate the slot */
-				mm[i].id = id;
-				return &mm[i];
-			} else {
-				/* end of list */
-				return NULL;
-			}
-		}
+	if (n < *max) {
+		return ptr;
 	}
-	return NULL;
+	int k = (*max == 0) ? MIDI_MAP_ALLOC : *max * 2;
+	void *x = ggm_calloc(k, size);
+	if (x == NULL) {
+		return NULL;
+	}
+	if (ptr != NULL) {
+		memcpy(x, ptr, n * size);
+		ggm_free(ptr);
+	}
+	*max = k;
+	return x;
 }
 
-/* synth_alloc_midi_map_entry allocates an empty  midi map entry */
-static struct midi_map_entry *synth_alloc_midi_map_entry(struct midi_map *mm)
+/* synth_add_midi_map adds a module/port to the MIDI map for a ch/cc */
+static int synth_add_midi_map(struct synth *s, int ch, int cc, struct module *m, const struct port_info *pi, struct param *p)
 {
-	struct midi_map_entry *mme = &mm->mme[0];
+	int i = MIDI_MAP_INDEX(ch, cc);
 
-	for (int i = 0; i < NUM_MIDI_MAP_ENTRIES; i++) {
-		if (mme[i].m == NULL) {
-			return &mme[i];
+	/* allocate a slot for the ch/cc */
+	if (s->midx[i] == 0) {
+		struct midi_map *x = synth_grow(s->mmap, s->nmaps, &s->maxmaps, sizeof(struct midi_map));
+		if (x == NULL) {
+			return -1;
 		}
+		s->mmap = x;
+		s->midx[i] = ++s->nmaps;
 	}
-	return NULL;
-}
 
+	/* add the entry to the slot */
+	struct midi_map *mm = &s->mmap[s->midx[i] - 1];
+	struct midi_map_entry *x = synth_grow(mm->mme, mm->n, &mm->max, sizeof(struct midi_map_entry));
+	if (x == NULL) {
+		return -1;
+	}
+	mm->mme = x;
+	mm->mme[mm->n].m = m;
+	mm->mme[mm->n].pi = pi;
+	mm->mme[mm->n].p = p;
+	mm->n++;
+	return 0;
+}
 
 /* synth_midi_cc looks up the midi mapping table.
  * If it finds a matching entry the event is dispatched
@@ -249,33 +448,97 @@ bool synth_midi_cc(struct synth *s, const struct event *e)
 		return false;
 	}
 
-	int id = MIDI_ID(event_get_midi_channel(e), event_get_midi_cc_num(e));
-
-	/* find the midi map entry slot */
-	struct midi_map *mm = synth_lookup_midi_map(s, id, false);
-	if (mm == NULL) {
+	int slot = s->midx[MIDI_MAP_INDEX(event_get_midi_channel(e), event_get_midi_cc_num(e))];
+	if (slot == 0) {
 		return false;
 	}
 
 	/* call the port functions */
-	struct midi_map_entry *mme = &mm->mme[0];
-	for (int i = 0; i < NUM_MIDI_MAP_ENTRIES; i++) {
-		if (mme[i].m == NULL) {
-			/* no more ports on this ch/cc */
-			break;
-		}
-		midi_func mf = mme[i].pi->mf;
-		port_func pf = mme[i].pi->pf;
+	const struct midi_map *mm = &s->mmap[slot - 1];
+	const struct midi_map_entry *mme = mm->mme;
+	for (int i = 0; i < mm->n; i++) {
 		/* convert from a MIDI event to a port event*/
 		struct event pe;
-		mf(&pe, e);
-		/* dispatch it to the port function */
-		pf(mme[i].m, &pe);
+		mme[i].pi->mf(&pe, e);
+		/* dispatch it to the shared parameter or port function */
+		if (mme[i].p != NULL) {
+			mme[i].pi->vf(mme[i].p, &pe);
+		} else {
+			mme[i].pi->pf(mme[i].m, &pe);
+		}
 	}
 
 	return true;
 }
 
+/* synth_midi_map_batch dispatches a batch of MIDI events for one CC to the
+ * mapped ports. A parameter port only needs the last value. A port with a
+ * batch function gets the port events in one call, otherwise the port
+ * function is called for each event.
+ */
+static void synth_midi_map_batch(const struct midi_map *mm, const struct event_batch *b)
+{
+	for (int i = 0; i < mm->n; i++) {
+		const struct midi_map_entry *x = &mm->mme[i];
+		if (x->pi->vf != NULL) {
+			struct event pe;
+			x->pi->mf(&pe, &b->e[b->n - 1]);
+			if (x->p != NULL) {
+				x->pi->vf(x->p, &pe);
+			} else {
+				x->pi->pf(x->m, &pe);
+			}
+			continue;
+		}
+		struct event_batch pb;
+		for (size_t j = 0; j < b->n; j++) {
+			x->pi->mf(&pb.e[j], &b->e[j]);
+		}
+		pb.n = b->n;
+		if (x->pi->bf != NULL) {
+			x->pi->bf(x->m, &pb);
+		} else {
+			for (size_t j = 0; j < pb.n; j++) {
+				x->pi->pf(x->m, &pb.e[j]);
+			}
+		}
+	}
+}
+
+/* synth_midi_cc_batch is the batch version of synth_midi_cc. The mapped CC
+ * events are dispatched with one batch per CC, so a port mapped to several
+ * CCs gets them grouped by CC. The other events are copied to the rest batch.
+ */
+void synth_midi_cc_batch(struct synth *s, const struct event_batch *b, struct event_batch *rest)
+{
+	bool done[EVENT_BATCH_SIZE] = { false };
+
+	rest->n = 0;
+	for (size_t i = 0; i < b->n; i++) {
+		if (done[i]) {
+			continue;
+		}
+		const struct event *e = &b->e[i];
+		int idx = MIDI_MAP_INDEX(event_get_midi_channel(e), event_get_midi_cc_num(e));
+		if (!is_midi_cc(e) || s->midx[idx] == 0) {
+			event_batch_add(rest, e);
+			continue;
+		}
+		/* gather the events for this CC */
+		struct event_batch cc;
+		cc.n = 0;
+		for (size_t j = i; j < b->n; j++) {
+			const struct event *x = &b->e[j];
+			if (!done[j] && is_midi_cc(x) &&
+			    MIDI_MAP_INDEX(event_get_midi_channel(x), event_get_midi_cc_num(x)) == idx) {
+				event_batch_add(&cc, x);
+				done[j] = true;
+			}
+		}
+		synth_midi_map_batch(&s->mmap[s->midx[idx] - 1], &cc);
+	}
+}
+
 /******************************************************************************
  * synth_input_cfg configures the input port of a module
  */
@@ -294,26 +557,41 @@ void synth_input_cfg(struct synth *s, struct module *m, const struct port_info *
 		return;
 	}
 
+	/* The ports sharing a param are configured once, by the first module.
+	 * The MIDI map has a single entry for the param.
+	 */
+	struct param *p = NULL;
+	if (pi->vf != NULL) {
+		p = param_find(s, ptr, pi);
+		if (p != NULL) {
+			if (p->init) {
+				return;
+			}
+			p->init = true;
+		}
+	}
+
 	/* send events for the initial configuration to the port */
 
+	struct port_hdl h = { .m = m, .pf = pi->pf, };
 	int id = 0; /* MIDI ch/cc id */
 	switch (pi->type) {
 	case PORT_TYPE_FLOAT: {
 		struct port_float_cfg *cfg = (struct port_float_cfg *)ptr;
 		id = cfg->id;
-		event_in_float(m, pi->name, cfg->init, NULL);
+		event_in_hdl_float(&h, cfg->init);
 		break;
 	}
 	case PORT_TYPE_INT: {
 		struct port_int_cfg *cfg = (struct port_int_cfg *)ptr;
 		id = cfg->id;
-		event_in_int(m, pi->name, cfg->init, NULL);
+		event_in_hdl_int(&h, cfg->init);
 		break;
 	}
 	case PORT_TYPE_BOOL: {
 		struct port_bool_cfg *cfg = (struct port_bool_cfg *)ptr;
 		id = cfg->id;
-		event_in_bool(m, pi->name, cfg->init, NULL);
+		event_in_hdl_bool(&h, cfg->init);
 		break;
 	}
 	default:
@@ -336,24 +614,19 @@ void synth_input_cfg(struct synth *s, struct module *m, const struct port_info *
 		return;
 	}
 
-	/* find the midi map entry slot */
-	struct midi_map *mm = synth_lookup_midi_map(s, id, true);
-	if (mm == NULL) {
-		LOG_ERR("not enough midi map slots (NUM_MIDI_MAP_SLOTS)");
+	int ch = MIDI_ID_CH(id);
+	int cc = MIDI_ID_CC(id);
+	if (ch > 15 || cc > 127) {
+		LOG_ERR("%s bad midi cc %d/%d", path, ch, cc);
 		return;
 	}
 
-	/* allocate a midi map entry */
-	struct midi_map_entry *mme = synth_alloc_midi_map_entry(mm);
-	if (mme == NULL) {
-		LOG_ERR("not enough midi map entries (NUM_MIDI_MAP_ENTRIES)");
+	if (synth_add_midi_map(s, ch, cc, m, pi, p) != 0) {
+		LOG_ERR("could not allocate midi map for %s", path);
 		return;
 	}
 
-	/* fill in the midi map entry */
-	mme->m = m;
-	mme->pi = pi;
-	LOG_DBG("%s mapped to cc %d/%d", path, MIDI_ID_CH(id), MIDI_ID_CC(id));
+	LOG_DBG("%s mapped to cc %d/%d", path, ch, cc);
 }
 
 /******************************************************************************
@@ -366,7 +639,7 @@ int synth_set_root(struct synth *s, struct module *m)
 
 	LOG_INF("%s", m->name);
 
-	/* TODO - test for unique input/output names */
+	/* the port names are unique, this is checked at compile time (see PORT_ID) */
 
 	/* check the number of MIDI input ports */
 	nports = port_count_by_type(m->info->in, PORT_TYPE_MIDI);
@@ -389,25 +662,43 @@ int synth_set_root(struct synth *s, struct module *m)
 	}
 
 	/* how many audio buffers do we need? */
-	size_t nbufs = port_count_by_type(m->info->in, PORT_TYPE_AUDIO);
-	nbufs += port_count_by_type(m->info->out, PORT_TYPE_AUDIO);
+	size_t n_in = port_count_by_type(m->info->in, PORT_TYPE_AUDIO);
+	size_t n_out = port_count_by_type(m->info->out, PORT_TYPE_AUDIO);
+	size_t nbufs = n_in + n_out;
 	if (nbufs > MAX_AUDIO_PORTS) {
 		LOG_ERR("number of audio input + output ports > MAX_AUDIO_PORTS");
 		return -1;
 	}
 
 	/* allocate the audio buffers */
-	float *buf = ggm_calloc(nbufs, AudioBufferSize * sizeof(float));
-	if (buf == NULL) {
-		LOG_ERR("could not allocate audio buffers");
-		return -1;
+	if (nbufs > 0) {
+		float *buf = synth_buf_alloc(s, nbufs);
+		if (buf == NULL) {
+			LOG_ERR("could not allocate audio buffers");
+			return -1;
+		}
+		/* setup the audio buffer list */
+		for (size_t i = 0; i < nbufs; i++) {
+			s->bufs[i] = &buf[i * s->bufstride];
+		}
 	}
 
-	/* setup the audio buffer list */
-	for (size_t i = 0; i < nbufs; i++) {
-		s->bufs[i] = &buf[i * AudioBufferSize];
+	/* compile the root patch */
+	s->plan = plan_new(m);
+	if (s->plan == NULL) {
+		return -1;
+	}
+	if (plan_set_bufs(s->plan, NULL) != 0) {
+		return -1;
 	}
 
+	LOG_INF("%s: %d steps, %d buffers, %u bytes of audio buffers", m->name, s->plan->nsteps,
+		s->plan->nslots, (unsigned int)s->abuf.used);
+	LOG_INF("%s: %u bytes of module memory (%u allocated)", m->name,
+		(unsigned int)s->amod.used, (unsigned int)s->amod.size);
+
+	s->n_audio_in = n_in;
+	s->n_audio_out = n_out;
 	s->root = m;
 	return 0;
 }
@@ -417,24 +708,153 @@ bool synth_has_root(struct synth *s)
 	return s->root != NULL;
 }
 
+/******************************************************************************
+ * DSP load
+ *
+ * The DSP load is the time to process a buffer as a fraction of the buffer
+ * period. The synth keeps a decaying peak of the load. Polyphonic modules
+ * stop allocating more voices (they steal an active voice) when it is over
+ * the load limit. The limit is off by default so offline renders don't depend
+ * on the cpu speed.
+ */
+
+/* synth_set_load_limit sets the DSP load limit for new voices (0 = off) */
+void synth_set_load_limit(struct synth *s, float limit)
+{
+	s->load_limit = clampf_lo(limit, 0.f);
+	LOG_INF("voice load limit %.0f%%", s->load_limit * 100.f);
+}
+
+/* synth_overloaded returns true if the DSP load is over the limit */
+bool synth_overloaded(struct synth *s)
+{
+	return (s->load_limit > 0.f) && (s->load >= s->load_limit);
+}
+
+/* synth_update_load updates the DSP load with the time to process a buffer */
+static void synth_update_load(struct synth *s, uint32_t t, uint32_t frame)
+{
+	float load = (float)t * s->load_k;
+
+	s->load = (load > s->load) ? load : s->load * LOAD_DECAY;
+#if defined(GGM_PROFILE)
+	prof_add(&s->prof, t, frame);
+#endif
+}
+
 /******************************************************************************
  * synth_loop runs the top-level synth loop - returns true if the output
  * buffers are non-zero.
+ *
+ * Input events take effect at their sample frame. The buffer is processed
+ * in parts, split at the input event times, and the input events are
+ * dispatched between the parts.
+ *
+ * MIDI control events (see is_midi_ctrl) for a root MIDI port with a batch
+ * function are timed in the same way. Consecutive control events for the
+ * port that are due at the same time are sent to it as a batch.
  */
 
-bool synth_loop(struct synth *s)
+/* synth_batch_port returns the root MIDI port that takes a batch for an
+ * input event (or NULL).
+ */
+static const struct port_info *synth_batch_port(struct synth *s, const struct qevent *q)
 {
-	struct module *m = s->root;
+	if (q->m != s->root || q->func == NULL || !is_midi_ctrl(&q->e)) {
+		return NULL;
+	}
+	for (int i = 0; i < MAX_MIDI_IN; i++) {
+		const struct port_info *pi = port_get_info_by_type(s->root->info->in, PORT_TYPE_MIDI, i);
+		if (pi == NULL) {
+			break;
+		}
+		if (pi->pf == q->func) {
+			return (pi->bf != NULL) ? pi : NULL;
+		}
+	}
+	return NULL;
+}
+
+/* synth_batch_flush sends a batch of input events to a root MIDI port */
+static void synth_batch_flush(struct synth *s, const struct port_info *pi, struct event_batch *b)
+{
+	if (b->n != 0) {
+		pi->bf(s->root, b);
+		b->n = 0;
+	}
+}
+
+/* synth_process processes n samples of the buffer starting at ofs */
+static bool synth_process(struct synth *s, size_t ofs, size_t n)
+{
+	size_t nbufs = s->n_audio_in + s->n_audio_out;
+	float *bufs[MAX_AUDIO_PORTS];
 	struct qevent q;
 
-	/* run the buffer processing */
-	bool active = m->info->process(m, s->bufs);
+	for (size_t i = 0; i < nbufs; i++) {
+		bufs[i] = &s->bufs[i][ofs];
+	}
+
+	bool active = plan_run(s->plan, bufs, n);
+
+	if (!active && n != s->bufsize) {
+		/* other parts of the buffer may be active, so zero this part */
+		for (size_t i = s->n_audio_in; i < nbufs; i++) {
+			block_zero(bufs[i], n);
+		}
+	}
 
 	/* process all queued events */
-	while (synth_event_rd(s, &q) == 0) {
-		event_out(q.m, q.idx, &q.e);
+	while (event_queue_rd(&s->eq, &q) == 0) {
+		synth_event_dispatch(&q);
+	}
+
+	return active;
+}
+
+bool synth_loop(struct synth *s)
+{
+	uint32_t frame = atomic_load_explicit(&s->frame, memory_order_relaxed);
+	uint32_t end = frame + s->bufsize;
+	const struct port_info *bpi = NULL;
+	const struct qevent *x;
+	struct event_batch b;
+	struct qevent q;
+	bool active = false;
+	size_t ofs = 0;
+
+	b.n = 0;
+	uint32_t t0 = ggm_ticks();
+	while (ofs < s->bufsize) {
+		/* dispatch the input events that are due, batch the control events */
+		while ((x = event_queue_peek(&s->iq)) != NULL && !time_before(frame + ofs, x->time)) {
+			const struct port_info *pi = synth_batch_port(s, x);
+			event_queue_rd(&s->iq, &q);
+			if (pi == NULL) {
+				/* keep the events in order */
+				synth_batch_flush(s, bpi, &b);
+				synth_event_dispatch(&q);
+				continue;
+			}
+			if (pi != bpi || b.n == EVENT_BATCH_SIZE) {
+				synth_batch_flush(s, bpi, &b);
+				bpi = pi;
+			}
+			event_batch_add(&b, &q.e);
+		}
+		synth_batch_flush(s, bpi, &b);
+
+		/* process up to the next input event in this buffer */
+		size_t n = s->bufsize - ofs;
+		if (x != NULL && time_before(x->time, end)) {
+			n = x->time - (frame + ofs);
+		}
+		active |= synth_process(s, ofs, n);
+		ofs += n;
 	}
 
+	atomic_store_explicit(&s->frame, end, memory_order_relaxed);
+	synth_update_load(s, ggm_ticks() - t0, frame);
 	return active;
 }
 
@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Note Tuning
+ */
+
+#include "ggm.h"
+
+/******************************************************************************
+ * The table is built once, so use a power function that is more accurate
+ * than the pow2 lookup table (0.3 cent steps).
+ */
+
+#define LN_2 (0.6931471805599453f)      /* math.log(2.0) */
+#define MAX_STEP (4294967040.f)         /* largest float < 2^32 */
+
+/* tuning_pow2 returns powf(2.f, x) */
+static float tuning_pow2(float x)
+{
+	float nf = truncf(x);
+	float ff = x - nf;
+
+	if (ff < 0) {
+		nf -= 1.f;
+		ff += 1.f;
+	}
+
+	/* exp(ff * ln2) by its Taylor series */
+	float y = 1.f;
+	float t = 1.f;
+	for (int i = 1; i < 12; i++) {
+		t *= (ff * LN_2) / (float)i;
+		y += t;
+	}
+
+	/* scale by the integer power */
+	for (int i = (int)nf; i > 0; i--) {
+		y *= 2.f;
+	}
+	for (int i = (int)nf; i < 0; i++) {
+		y *= 0.5f;
+	}
+	return y;
+}
+
+/******************************************************************************
+ * 12-TET with A4 = 440 Hz
+ */
+
+static const float cents_12tet[] = {
+	100.f, 200.f, 300.f, 400.f, 500.f, 600.f, 700.f, 800.f, 900.f, 1000.f, 1100.f, 1200.f,
+};
+
+static const struct tuning_scale scale_12tet = {
+	.cents = cents_12tet,
+	.n = 12,
+	.note = 60,
+	.ref = 69,
+	.freq = 440.f,
+};
+
+/* tuning_cents returns the pitch of a MIDI note relative to scale degree 0 */
+static float tuning_cents(const struct tuning_scale *sc, int note)
+{
+	int d = note - sc->note;
+	int q = d / sc->n;
+	int r = d % sc->n;
+
+	if (r < 0) {
+		q -= 1;
+		r += sc->n;
+	}
+	float c = (float)q * sc->cents[sc->n - 1];
+	return (r == 0) ? c : c + sc->cents[r - 1];
+}
+
+/******************************************************************************
+ * tuning_set sets the scale of a tuning (NULL for the default 12-TET).
+ * tuning_update must be called to build the phase step table.
+ */
+
+int tuning_set(struct tuning *t, const struct tuning_scale *sc)
+{
+	if (sc == NULL) {
+		sc = &scale_12tet;
+	}
+
+	if (sc->n <= 0 || sc->cents[sc->n - 1] <= 0.f || sc->freq <= 0.f) {
+		LOG_ERR("bad scale");
+		return -1;
+	}
+	for (int i = 1; i < sc->n; i++) {
+		if (sc->cents[i] <= sc->cents[i - 1]) {
+			LOG_ERR("scale pitches must increase");
+			return -1;
+		}
+	}
+
+	float ref = tuning_cents(sc, sc->ref);
+	for (int i = 0; i <= TUNING_NOTES; i++) {
+		t->cents[i] = tuning_cents(sc, i) - ref;
+	}
+	t->freq = sc->freq;
+	return 0;
+}
+
+/******************************************************************************
+ * tuning_update builds the phase step table for a frequency to phase step
+ * scale (see synth_set_audio).
+ */
+
+void tuning_update(struct tuning *t, float fscale)
+{
+	for (int i = 0; i < TUNING_SIZE; i++) {
+		int n = i / TUNING_DIV;
+		float c = t->cents[n];
+		if (n < TUNING_NOTES) {
+			float k = (float)(i % TUNING_DIV) * (1.f / (float)TUNING_DIV);
+			c += k * (t->cents[n + 1] - t->cents[n]);
+		}
+		float step = t->freq * tuning_pow2(c * (1.f / 1200.f)) * fscale;
+		t->step[i] = clampf_hi(step, MAX_STEP);
+	}
+}
+
+/*****************************************************************************/
@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Arena Allocator
+ */
+
+#ifndef GGM_SRC_INC_ARENA_H
+#define GGM_SRC_INC_ARENA_H
+
+#ifndef GGM_SRC_INC_GGM_H
+#warning "please include this file using ggm.h"
+#endif
+
+/******************************************************************************
+ * An arena allocates memory from large chunks. The allocations are not freed
+ * individually, all of the arena memory is freed at once.
+ */
+
+struct arena_chunk {
+	struct arena_chunk *next;       /* next chunk */
+	uint8_t *base;                  /* start of chunk memory */
+	size_t size;                    /* chunk memory size */
+	size_t used;                    /* bytes used in the chunk */
+};
+
+struct arena {
+	struct arena_chunk *chunk;      /* chunk list (current chunk first) */
+	size_t chunk_size;              /* minimum chunk size */
+	size_t used;                    /* bytes allocated (including alignment padding) */
+	size_t size;                    /* bytes of chunk memory */
+};
+
+void arena_init(struct arena *a, size_t chunk_size);
+void arena_free(struct arena *a);
+void *arena_alloc(struct arena *a, size_t size, size_t align);
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_INC_ARENA_H */
+
+/*****************************************************************************/
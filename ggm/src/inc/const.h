@@ -26,12 +26,26 @@
  * Audio Constants.
  */
 
-/* AudioSampleFrequency is the sample frequency for audio (Hz) */
+/* AudioSampleFrequency is the default sample frequency for audio (Hz).
+ * The driver may set a different rate with synth_set_audio().
+ */
 #define AudioSampleFrequency (48000U)
 
-/* AudioBufferSize is the number of float samples per audio buffer */
+/* AudioBufferSize is the default number of float samples per audio buffer.
+ * The driver may set a different size with synth_set_audio(). Block operations
+ * have a fast path for this size.
+ */
 #define AudioBufferSize (128)
 
+/* MaxAudioBufferSize is the largest audio buffer size a synth may use.
+ * Modules size their stack buffers with this value.
+ */
+#if defined(__LINUX__)
+#define MaxAudioBufferSize (1024)
+#else
+#define MaxAudioBufferSize AudioBufferSize
+#endif
+
 /******************************************************************************
  * Derived/Fundanmental Constants (don't modify).
  */
@@ -42,12 +56,6 @@
 /* Tau (2 * Pi) */
 #define Tau (2.f * Pi)
 
-/* AudioSamplePeriod is the sample period for audio (seconds) */
-#define AudioSamplePeriod (1.f / (float)AudioSampleFrequency)
-
-/* SecsPerAudioBuffer is the audio duration for a single audio buffer */
-#define SecsPerAudioBuffer ((float)AudioBufferSize / (float)AudioSampleFrequency)
-
 /* FullCycle is a full uint32_t phase count */
 #define FullCycle (1ULL << 32)
 
@@ -57,9 +65,6 @@
 /* QuarterCycle is a quarter uint32_t phase count */
 #define QuarterCycle (1U << 30)
 
-/* FrequencyScale scales a frequency value to a uint32_t phase step value */
-#define FrequencyScale ((float)FullCycle / (float)AudioSampleFrequency)
-
 /* PhaseScale scales a phase value to a uint32_t phase step value */
 #define PhaseScale ((float)FullCycle / Tau)
 
@@ -45,6 +45,75 @@ typedef void (*port_func)(struct module *m, const struct event *e);
 typedef void (*midi_func)(struct event *dst, const struct event *src);
 typedef void (*midi_out_func)(void *arg, const struct event *e, int idx);
 
+struct param;
+typedef void (*param_func)(struct param *p, const struct event *e);
+
+/******************************************************************************
+ * event batches: Control events for a port that take effect at the same time
+ * can be sent as a batch, with one call to the batch function of the port
+ * (port_info.bf). The module can then coalesce the events (E.g. one
+ * coefficient update rather than one per event). The events are in time
+ * order and a batch is never empty.
+ */
+
+#define EVENT_BATCH_SIZE 16     /* maximum events in a batch */
+
+struct event_batch {
+	size_t n;                               /* number of events */
+	struct event e[EVENT_BATCH_SIZE];       /* the events */
+};
+
+typedef void (*batch_func)(struct module *m, const struct event_batch *b);
+
+/* event_batch_add adds an event to a batch, it returns -1 if the batch is full */
+static inline int event_batch_add(struct event_batch *b, const struct event *e)
+{
+	if (b->n == EVENT_BATCH_SIZE) {
+		return -1;
+	}
+	b->e[b->n] = *e;
+	b->n++;
+	return 0;
+}
+
+/* port_hdl is an input port of a module resolved by port_get_hdl, so events
+ * can be sent to the port without a port name lookup.
+ */
+struct port_hdl {
+	struct module *m;       /* destination module */
+	port_func pf;           /* port function (NULL if the port wasn't found) */
+	batch_func bf;          /* batch function (NULL if the port has none) */
+};
+
+/* event_in_hdl sends an event to an input port handle. The event is ignored
+ * if the handle wasn't resolved (E.g. an optional port).
+ */
+static inline void event_in_hdl(const struct port_hdl *h, const struct event *e)
+{
+	if (h->pf != NULL) {
+		h->pf(h->m, e);
+	}
+}
+
+/* event_in_batch sends a batch of events to an input port handle. A port
+ * without a batch function gets the events one at a time.
+ */
+static inline void event_in_batch(const struct port_hdl *h, const struct event_batch *b)
+{
+	if (b->n == 0) {
+		return;
+	}
+	if (h->bf != NULL) {
+		h->bf(h->m, b);
+		return;
+	}
+	if (h->pf != NULL) {
+		for (size_t i = 0; i < b->n; i++) {
+			h->pf(h->m, &b->e[i]);
+		}
+	}
+}
+
 void event_in(struct module *m, const char *name, const struct event *e, port_func *hdl);
 void event_out(struct module *m, int idx, const struct event *e);
 void event_out_name(struct module *m, const char *name, const struct event *e);
@@ -181,6 +250,24 @@ static inline bool is_midi_cc(const struct event *e)
 	return (e->u.midi.status & 0xf0) == MIDI_STATUS_CONTROLCHANGE;
 }
 
+/* is_midi_ctrl returns true for the MIDI channel messages that are control
+ * rather than note events (these can be batched).
+ */
+static inline bool is_midi_ctrl(const struct event *e)
+{
+	if (e->type != EVENT_TYPE_MIDI) {
+		return false;
+	}
+	switch (e->u.midi.status & 0xf0) {
+	case MIDI_STATUS_CONTROLCHANGE:
+	case MIDI_STATUS_CHANNELAFTERTOUCH:
+	case MIDI_STATUS_PITCHWHEEL:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static inline bool is_midi_ch(const struct event *e, uint8_t ch)
 {
 	if (e->type != EVENT_TYPE_MIDI) {
@@ -214,6 +301,14 @@ static inline void event_in_float(struct module *m, const char *name, float val,
 	event_in(m, name, &e, hdl);
 }
 
+static inline void event_in_hdl_float(const struct port_hdl *h, float val)
+{
+	struct event e;
+
+	event_set_float(&e, val);
+	event_in_hdl(h, &e);
+}
+
 /******************************************************************************
  * integer events
  */
@@ -237,6 +332,14 @@ static inline void event_in_int(struct module *m, const char *name, int val, por
 	event_in(m, name, &e, hdl);
 }
 
+static inline void event_in_hdl_int(const struct port_hdl *h, int val)
+{
+	struct event e;
+
+	event_set_int(&e, val);
+	event_in_hdl(h, &e);
+}
+
 /******************************************************************************
  * boolean events
  */
@@ -260,6 +363,14 @@ static inline void event_in_bool(struct module *m, const char *name, bool val, p
 	event_in(m, name, &e, hdl);
 }
 
+static inline void event_in_hdl_bool(const struct port_hdl *h, bool val)
+{
+	struct event e;
+
+	event_set_bool(&e, val);
+	event_in_hdl(h, &e);
+}
+
 /*****************************************************************************/
 
 #endif /* GGM_SRC_INC_EVENT_H */
@@ -17,9 +17,16 @@
 
 #include "const.h"
 #include "util.h"
+#include "arena.h"
+#include "prof.h"
 #include "module.h"
 #include "event.h"
 #include "port.h"
+#include "param.h"
+#include "smooth.h"
+#include "tuning.h"
+#include "queue.h"
+#include "plan.h"
 #include "config.h"
 #include "synth.h"
 
@@ -34,6 +41,9 @@
  */
 
 float cos_lookup(uint32_t x);
+void cos_lookup_buf(float *out, const uint32_t *x, size_t n);
+uint32_t cos_lookup_block(float *out, uint32_t x, uint32_t xstep, size_t n);
+uint32_t phase_block(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float kfm, const float *pm, size_t n);
 float pow2(float x);
 
 /******************************************************************************
@@ -63,13 +73,41 @@ float midi_pitch_bend(uint16_t val);
  * block operations
  */
 
-void block_zero(float *out);
-void block_mul(float *out, float *buf);
-void block_mul_k(float *out, float k);
-void block_add(float *out, float *buf);
-void block_add_k(float *out, float k);
-void block_copy(float *dst, const float *src);
-void block_copy_mul_k(float *dst, const float *src, float k);
+/* block_ops is a set of block operations for a given cpu */
+struct block_ops {
+	const char *name;
+	void (*zero)(float *out, size_t n);
+	void (*mul)(float *out, const float *buf, size_t n);
+	void (*add)(float *out, const float *buf, size_t n);
+	void (*mul_k)(float *out, float k, size_t n);
+	void (*add_k)(float *out, float k, size_t n);
+	void (*copy)(float *dst, const float *src, size_t n);
+	void (*copy_mul_k)(float *dst, const float *src, float k, size_t n);
+	void (*mla)(float *out, const float *a, const float *b, size_t n);
+	void (*mul_k_add)(float *out, const float *buf, float k0, float k1, size_t n);
+	void (*copy_mul_k2)(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n);
+	void (*cos_lookup)(float *out, const uint32_t *x, size_t n);
+	uint32_t (*phase_fm)(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n);
+	void (*phase_pm)(uint32_t *x, const float *pm, float k, size_t n);
+};
+
+void block_init(void);
+const struct block_ops *block_get_ops(unsigned int n);
+void block_set_ops(const struct block_ops *x);
+
+void block_zero(float *out, size_t n);
+void block_mul(float *out, float *buf, size_t n);
+void block_mul_k(float *out, float k, size_t n);
+void block_add(float *out, float *buf, size_t n);
+void block_add_k(float *out, float k, size_t n);
+void block_copy(float *dst, const float *src, size_t n);
+void block_copy_mul_k(float *dst, const float *src, float k, size_t n);
+void block_mla(float *out, const float *a, const float *b, size_t n);
+void block_mul_k_add(float *out, const float *buf, float k0, float k1, size_t n);
+void block_copy_mul_k2(float *dst0, float *dst1, const float *src, float k0, float k1, size_t n);
+void block_cos_lookup(float *out, const uint32_t *x, size_t n);
+uint32_t block_phase_fm(uint32_t *out, uint32_t x, uint32_t xstep, const float *fm, float k, size_t n);
+void block_phase_pm(uint32_t *x, const float *pm, float k, size_t n);
 
 /*****************************************************************************/
 
@@ -23,21 +23,31 @@ struct module {
 	struct synth *top;              /* top level synth */
 	struct output_dst **dst;        /* output port destinations */
 	void *priv;                     /* pointer to private module data */
+#if defined(GGM_PROFILE)
+	struct prof_stats prof;         /* process time counters */
+	struct module *prof_next;       /* next module in the synth profile list */
+#endif
 };
 
+struct plan;
+
 /* module_info stores descriptive information common to all module instances of
  * a given type. The information is defined by code and is known at compile time.
  * The information is constant at runtime, so the structure can be stored in
  * read-only memory.
+ *
+ * A module with sub-modules has a compile function instead of a process function.
+ * It adds the steps for its sub-modules and kernels to an execution plan (see plan.c).
  */
 struct module_info {
-	const char *mname;                                      /* module name */
-	const char *iname;                                      /* instance name */
-	const struct port_info *in;                             /* input ports */
-	const struct port_info *out;                            /* output ports */
-	int (*alloc)(struct module *m, va_list vargs);          /* allocate and initialise the module */
-	void (*free)(struct module *m);                         /* stop and deallocate the module */
-	bool (*process)(struct module *m, float *buf[]);        /* process buffers for this module */
+	const char *mname;                                                              /* module name */
+	const char *iname;                                                              /* instance name */
+	const struct port_info *in;                                                     /* input ports */
+	const struct port_info *out;                                                    /* output ports */
+	int (*alloc)(struct module *m, va_list vargs);                                  /* allocate and initialise the module */
+	void (*free)(struct module *m);                                                 /* stop and deallocate the module */
+	bool (*process)(struct module *m, float *buf[], size_t n);                      /* process n samples for this module */
+	int (*compile)(struct module *m, struct plan *p, const int *bufs, int cond);    /* add the module steps to a plan */
 };
 
 typedef struct module * (*module_func)(struct module *m, int id);
@@ -51,6 +61,7 @@ typedef struct module * (*module_func)(struct module *m, int id);
 struct module *module_root(struct synth *top, const char *name, int id, ...);
 struct module *module_new(struct module *parent, const char *name, int id, ...);
 void module_del(struct module *m);
+const struct module_info *module_get_info(unsigned int n);
 
 /*****************************************************************************/
 
@@ -43,6 +43,37 @@ static inline void ggm_free(void *ptr)
 	k_free(ptr);
 }
 
+/* ggm_ticks returns the cpu cycle counter (used for profiling) */
+static inline uint32_t ggm_ticks(void)
+{
+	return k_cycle_get_32();
+}
+
+static inline uint32_t ggm_ticks_per_sec(void)
+{
+	return sys_clock_hw_cycles_per_sec();
+}
+
+/* There are no worker threads, pool jobs run on the calling thread. */
+struct ggm_pool;
+typedef void (*pool_func)(void *arg, unsigned int i);
+
+static inline struct ggm_pool *ggm_pool_new(unsigned int nthreads, int priority)
+{
+	return NULL;
+}
+
+static inline void ggm_pool_del(struct ggm_pool *p)
+{
+}
+
+static inline void ggm_pool_run(struct ggm_pool *p, pool_func func, void *arg, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		func(arg, i);
+	}
+}
+
 /*****************************************************************************/
 #elif defined(__LINUX__)
 
@@ -65,6 +96,16 @@ static inline const char *log_strdup(const char *s)
 void ggm_mdelay(long ms);
 void *ggm_calloc(size_t num, size_t size);
 void ggm_free(void *ptr);
+uint32_t ggm_ticks(void);
+uint32_t ggm_ticks_per_sec(void);
+
+/* ggm_pool is a pool of worker threads used to run jobs in parallel */
+struct ggm_pool;
+typedef void (*pool_func)(void *arg, unsigned int i);
+
+struct ggm_pool *ggm_pool_new(unsigned int nthreads, int priority);
+void ggm_pool_del(struct ggm_pool *p);
+void ggm_pool_run(struct ggm_pool *p, pool_func func, void *arg, unsigned int n);
 
 /*****************************************************************************/
 
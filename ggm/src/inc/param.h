@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Shared Parameters
+ */
+
+#ifndef GGM_SRC_INC_PARAM_H
+#define GGM_SRC_INC_PARAM_H
+
+#ifndef GGM_SRC_INC_GGM_H
+#warning "please include this file using ggm.h"
+#endif
+
+/******************************************************************************
+ * A param is a port value that modules read when they process. The input
+ * ports matched by a synth configuration entry (E.g. "root.poly.voice*.adsr:attack")
+ * share a param, so a MIDI CC computes the value (E.g. an envelope constant)
+ * once for all of the voices. An event sent to any one of the ports updates
+ * all of them. Otherwise the param is private to the module.
+ *
+ * A port with a param has a param function (port_info.vf) that sets the
+ * value from a port event. The port function of the module calls it.
+ */
+
+struct param {
+	float val;                      /* parameter value */
+	uint32_t gen;                   /* incremented when the value changes */
+	struct synth *top;              /* top level synth */
+	const struct port_info *pi;     /* input port */
+	const void *cfg;                /* synth configuration (NULL for a private param) */
+	bool init;                      /* the shared ports have been configured */
+	struct param *next;             /* next shared param */
+};
+
+/* param_set sets the parameter value */
+static inline void param_set(struct param *p, float val)
+{
+	p->val = val;
+	p->gen++;
+}
+
+/******************************************************************************
+ * function prototypes
+ */
+
+struct param *param_new(struct module *m, const char *name, float val);
+struct param *param_find(struct synth *s, const void *cfg, const struct port_info *pi);
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_INC_PARAM_H */
+
+/*****************************************************************************/
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Compiled Execution Plans
+ */
+
+#ifndef GGM_SRC_INC_PLAN_H
+#define GGM_SRC_INC_PLAN_H
+
+#ifndef GGM_SRC_INC_GGM_H
+#warning "please include this file using ggm.h"
+#endif
+
+/******************************************************************************
+ * A plan is a module hierarchy flattened into a linear list of kernel calls.
+ * Each step has its buffers assigned when the plan is compiled.
+ * A step can be conditional on the result of an earlier step. It is skipped
+ * (with a false result) if that step returned false or was skipped.
+ *
+ * Internal buffers that are not live at the same time share a buffer slot.
+ */
+
+#define PLAN_NONE (-1)          /* buffer index of an unconnected input (NULL buffer) */
+
+/* plan_func is a step kernel. It has the same form as a module process function. */
+typedef bool (*plan_func)(struct module *m, float *bufs[], size_t n);
+
+struct plan_step {
+	plan_func func;         /* kernel function */
+	struct module *m;       /* module passed to the kernel */
+	float **bufs;           /* kernel buffers */
+	int ofs;                /* offset of the buffer indices (compile time) */
+	int nbufs;              /* number of buffers */
+	int cond;               /* skip this step if the cond step is false (-1 = never) */
+	bool active;            /* kernel result for this run */
+};
+
+/* plan_io is a step buffer that is one of the buffers passed to plan_run */
+struct plan_io {
+	float **ptr;            /* step buffer pointer */
+	int idx;                /* plan_run buffer index */
+};
+
+struct plan {
+	struct synth *top;              /* top level synth */
+	struct plan_step *step;         /* steps */
+	int nsteps;                     /* number of steps */
+	int maxsteps;                   /* allocated steps */
+	int *idx;                       /* step buffer indices (compile time) */
+	int nidx;                       /* number of buffer indices */
+	int maxidx;                     /* allocated buffer indices */
+	float **ptr;                    /* step buffer pointers */
+	struct plan_io *io;             /* step buffers passed to plan_run */
+	int nio;                        /* number of plan_run buffers */
+	int nfix;                       /* number of step buffers passed to plan_run */
+	int nbufs;                      /* number of internal buffers */
+	int *slot;                      /* internal buffer to buffer slot */
+	int nslots;                     /* number of buffer slots */
+	int result;                     /* step with the plan result */
+	bool err;                       /* compile error */
+};
+
+/******************************************************************************
+ * function prototypes
+ */
+
+struct plan *plan_new(struct module *m);
+void plan_del(struct plan *p);
+int plan_set_bufs(struct plan *p, float *buf);
+bool plan_run(struct plan *p, float *bufs[], size_t n);
+
+/* used by module compile functions */
+int plan_module(struct plan *p, struct module *m, const int *bufs, int cond);
+int plan_module_out(struct plan *p, struct module *m, const int *bufs, int cond);
+int plan_step(struct plan *p, plan_func func, struct module *m, const int *bufs, int nbufs, int cond);
+int plan_buf(struct plan *p);
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_INC_PLAN_H */
+
+/*****************************************************************************/
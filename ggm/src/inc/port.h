@@ -33,9 +33,24 @@ struct port_info {
 	enum port_type type;    /* port type */
 	port_func pf;           /* port event function */
 	midi_func mf;           /* MIDI event conversion function */
+	param_func vf;          /* shared parameter function (see param.h) */
+	batch_func bf;          /* event batch function (optional, see event.h) */
 };
 
-#define PORT_EOL { NULL, PORT_TYPE_NULL, NULL, NULL }
+#define PORT_EOL { NULL, PORT_TYPE_NULL, NULL, NULL, NULL, NULL }
+
+/* Port tables are defined by a port list macro, with an X(prefix, id, ...)
+ * entry for each port. The list generates the port table (PORT_INFO) and an
+ * enum of port indices (PORT_ID), so a module refers to its ports as
+ * prefix_id (E.g. SEQ_OUT_midi) without a lookup by name at runtime.
+ * Each port name is an enumerator, so a duplicate port name is a compile error.
+ *
+ * #define SEQ_OUT_PORTS(X) X(SEQ_OUT, midi, .type = PORT_TYPE_MIDI)
+ * enum { SEQ_OUT_PORTS(PORT_ID) };
+ * static const struct port_info out_ports[] = { SEQ_OUT_PORTS(PORT_INFO) PORT_EOL, };
+ */
+#define PORT_ID(prefix, id, ...) prefix ## _ ## id,
+#define PORT_INFO(prefix, id, ...) { .name = #id, __VA_ARGS__ },
 
 /******************************************************************************
  * output port destinations: An event sent from an output port is delivered
@@ -60,11 +75,13 @@ unsigned int port_count_by_type(const struct port_info port[], enum port_type ty
 int port_get_index(const struct port_info port[], const char *name);
 const struct port_info *port_get_info(const struct port_info port[], const char *name);
 
+int port_get_hdl(struct port_hdl *h, struct module *m, const char *name);
+
 int port_get_index_by_type(const struct port_info port[], enum port_type type, size_t n);
 const struct port_info *port_get_info_by_type(const struct port_info port[], enum port_type type, size_t n);
 
 void port_add_dst(struct module *m, int idx, struct module *dst, port_func func);
-void port_free_dst_list(struct output_dst *ptr);
+void port_free_dst_list(struct synth *s, struct output_dst *ptr);
 
 void port_connect(struct module *s, const char *sname, struct module *d, const char *dname);
 void port_forward(struct module *s, const char *sname, struct module *d, const char *dname);
@@ -0,0 +1,100 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * CPU Profiling
+ */
+
+#ifndef GGM_SRC_INC_PROF_H
+#define GGM_SRC_INC_PROF_H
+
+#ifndef GGM_SRC_INC_GGM_H
+#warning "please include this file using ggm.h"
+#endif
+
+/******************************************************************************
+ * Build with GGM_PROFILE defined to time each plan step and synth loop.
+ * Otherwise the profiling code and data are compiled out.
+ *
+ * The audio (and worker) threads add to the counters. A non-realtime thread
+ * reads and resets them with prof_take (E.g. periodically with prof_dump).
+ */
+
+#if defined(GGM_PROFILE)
+
+#include <stdatomic.h>
+
+struct synth;
+struct module;
+
+/* prof_stats are the lock-free timing counters for a module or synth loop */
+struct prof_stats {
+	atomic_uint n;          /* number of calls */
+	atomic_ullong sum;      /* total ticks (32 bits of ns would wrap in 4.3 secs) */
+	atomic_uint min;        /* minimum ticks per call */
+	atomic_uint max;        /* maximum ticks per call */
+	atomic_uint frame;      /* synth frame of the last buffer */
+	atomic_uint last;       /* total ticks in the last buffer */
+};
+
+/* prof_data is a copy of the counters taken by prof_take */
+struct prof_data {
+	uint32_t n;
+	uint64_t sum;
+	uint32_t min;
+	uint32_t max;
+};
+
+/* prof_module is the time of a module in a buffer */
+struct prof_module {
+	const char *name;
+	uint32_t ticks;
+};
+
+/* prof_add adds a call time to the counters. A module is only processed by
+ * one thread at a time, so min/max don't need a compare and swap. A reset
+ * by prof_take that races with an update can move that sample to the next
+ * reading.
+ */
+static inline void prof_add(struct prof_stats *ps, uint32_t t, uint32_t frame)
+{
+	atomic_fetch_add_explicit(&ps->n, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&ps->sum, t, memory_order_relaxed);
+	if (t < atomic_load_explicit(&ps->min, memory_order_relaxed)) {
+		atomic_store_explicit(&ps->min, t, memory_order_relaxed);
+	}
+	if (t > atomic_load_explicit(&ps->max, memory_order_relaxed)) {
+		atomic_store_explicit(&ps->max, t, memory_order_relaxed);
+	}
+	/* total time for the buffer */
+	if (atomic_load_explicit(&ps->frame, memory_order_relaxed) != frame) {
+		atomic_store_explicit(&ps->frame, frame, memory_order_relaxed);
+		atomic_store_explicit(&ps->last, t, memory_order_relaxed);
+	} else {
+		atomic_fetch_add_explicit(&ps->last, t, memory_order_relaxed);
+	}
+}
+
+#define PROF_START(t0) uint32_t t0 = ggm_ticks()
+#define PROF_END(ps, t0, frame) prof_add(ps, ggm_ticks() - (t0), frame)
+
+void prof_init(struct prof_stats *ps);
+void prof_take(struct prof_stats *ps, struct prof_data *pd);
+void prof_module_add(struct module *m);
+void prof_module_del(struct module *m);
+int prof_buffer(struct synth *s, uint32_t frame, struct prof_module *x, int n);
+void prof_dump(struct synth *s);
+
+#else
+
+#define PROF_START(t0)
+#define PROF_END(ps, t0, frame)
+
+#endif
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_INC_PROF_H */
+
+/*****************************************************************************/
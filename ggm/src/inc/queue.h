@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Lock-Free Event Queues
+ */
+
+#ifndef GGM_SRC_INC_QUEUE_H
+#define GGM_SRC_INC_QUEUE_H
+
+#ifndef GGM_SRC_INC_GGM_H
+#warning "please include this file using ggm.h"
+#endif
+
+#include <stdatomic.h>
+
+/******************************************************************************
+ * queued events
+ */
+
+/* qevent is an event with a destination and a time.
+ * If func is NULL the event is sent from output port idx of the module.
+ * Otherwise it is sent to the input port function of the module.
+ */
+struct qevent {
+	struct module *m;       /* source/destination module */
+	int idx;                /* output port index */
+	port_func func;         /* input port function */
+	uint32_t time;          /* sample frame the event takes effect */
+	struct event e;         /* the queued event */
+};
+
+/******************************************************************************
+ * event queue - a bounded ring buffer of events with a single consumer.
+ * The single producer version needs no read-modify-write operations.
+ * The multi-producer version uses a compare and swap to reserve a slot.
+ * Neither version takes locks, so either end may be the audio thread.
+ */
+
+struct qslot {
+	atomic_size_t seq;      /* slot sequence number */
+	struct qevent qe;       /* the queued event */
+};
+
+struct event_queue {
+	struct qslot *slot;             /* queue slots */
+	size_t mask;                    /* number of slots - 1 */
+	bool mp;                        /* multiple producers */
+	atomic_size_t wr;               /* write position */
+	size_t rd;                      /* read position */
+	atomic_uint overflow;           /* number of events dropped on a full queue */
+};
+
+int event_queue_init(struct event_queue *q, size_t n, bool mp);
+void event_queue_free(struct event_queue *q);
+int event_queue_wr(struct event_queue *q, const struct qevent *qe);
+int event_queue_rd(struct event_queue *q, struct qevent *qe);
+const struct qevent *event_queue_peek(struct event_queue *q);
+
+/* event_queue_overflow returns the number of events dropped on a full queue */
+static inline unsigned int event_queue_overflow(struct event_queue *q)
+{
+	return atomic_load_explicit(&q->overflow, memory_order_relaxed);
+}
+
+/* time_before returns true if sample frame a is before sample frame b */
+static inline bool time_before(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) < 0;
+}
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_INC_QUEUE_H */
+
+/*****************************************************************************/
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Smoothed Parameters
+ */
+
+#ifndef GGM_SRC_INC_SMOOTH_H
+#define GGM_SRC_INC_SMOOTH_H
+
+#ifndef GGM_SRC_INC_GGM_H
+#warning "please include this file using ggm.h"
+#endif
+
+/******************************************************************************
+ * A float port event sets the target of a smoothed value, the value then
+ * ramps to the target over a fixed time. This avoids the zipper noise of a
+ * parameter that jumps at buffer boundaries.
+ *
+ * Modules that only need the value call smooth_next per sample. Modules with
+ * expensive coefficients (E.g. filter/svf) call smooth_block to step the value
+ * SMOOTH_BLOCK samples at a time and recompute the coefficients for each block.
+ */
+
+#define SMOOTH_TIME 20e-3f      /* default ramp time (secs) */
+#define SMOOTH_BLOCK 16         /* samples per coefficient update */
+
+enum smooth_type {
+	SMOOTH_LINEAR,          /* linear ramp */
+	SMOOTH_ONEPOLE,         /* one-pole (exponential) ramp */
+};
+
+struct smooth {
+	enum smooth_type type;  /* ramp type */
+	float x;                /* current value */
+	float target;           /* target value */
+	float step;             /* linear: step per sample */
+	float k;                /* one-pole: filter constant */
+	uint32_t len;           /* ramp length (samples) */
+	uint32_t n;             /* samples to the target (0 = at the target) */
+};
+
+/* smooth_active returns true if the value is ramping to the target */
+static inline bool smooth_active(const struct smooth *sm)
+{
+	return sm->n != 0;
+}
+
+/* smooth_next steps the value by one sample and returns it */
+static inline float smooth_next(struct smooth *sm)
+{
+	if (sm->n == 0) {
+		return sm->x;
+	}
+	if (--sm->n == 0) {
+		sm->x = sm->target;
+	} else if (sm->type == SMOOTH_LINEAR) {
+		sm->x += sm->step;
+	} else {
+		sm->x += sm->k * (sm->target - sm->x);
+	}
+	return sm->x;
+}
+
+/******************************************************************************
+ * function prototypes
+ */
+
+void smooth_init(struct smooth *sm, enum smooth_type type, float time, unsigned int rate, float x);
+void smooth_set(struct smooth *sm, float target);
+void smooth_reset(struct smooth *sm, float x);
+float smooth_block(struct smooth *sm, size_t n);
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_INC_SMOOTH_H */
+
+/*****************************************************************************/
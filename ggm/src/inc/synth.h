@@ -21,44 +21,67 @@
 struct midi_map_entry {
 	struct module *m;
 	const struct port_info *pi;
+	struct param *p;        /* shared parameter (NULL for a module port) */
 };
 
-#define NUM_MIDI_MAP_ENTRIES 8          /* maximum number of ports on a given MIDI cc */
-#define NUM_MIDI_MAP_SLOTS 8            /* maximum number of mapped MIDI cc's */
+#define NUM_MIDI_MAP_INDEX (16 * 128)   /* MIDI channels * cc numbers */
+#define MIDI_MAP_ALLOC 8                /* initial number of slots/entries */
+
+/* MIDI_MAP_INDEX returns the map index of a MIDI channel/cc */
+#define MIDI_MAP_INDEX(ch, cc) ((((ch) & 15) << 7) | ((cc) & 127))
 
 /* midi_map records the set of modules/ports mapped to a given ch/cc value */
 struct midi_map {
-	int id;                                                 /* MIDI channel/cc id */
-	struct midi_map_entry mme[NUM_MIDI_MAP_ENTRIES];        /* map entries for this CC */
+	struct midi_map_entry *mme;     /* map entries for this CC */
+	int n;                          /* number of map entries */
+	int max;                        /* allocated map entries */
 };
 
 /******************************************************************************
  * top-level synth structure
  */
 
-#define NUM_EVENTS 16 /* must be a power of 2 */
-
-struct qevent {
-	struct module *m;       /* source module */
-	int idx;                /* output port index */
-	struct event e;         /* the queued event */
-};
-
-/* circular buffer for events */
-struct event_queue {
-	struct qevent queue[NUM_EVENTS];
-	size_t rd;
-	size_t wr;
-};
+#define NUM_EVENTS 16            /* process time event queue size (power of 2) */
+#define NUM_INPUT_EVENTS 64     /* default input event queue size (power of 2) */
+#define BUF_ALIGN 64            /* audio buffer alignment (bytes) */
+#define BUF_CHUNK_SIZE 4096     /* audio buffer arena chunk size (bytes) */
+#define MOD_ALIGN 16            /* module memory alignment (bytes) */
+#define MOD_CHUNK_SIZE 4096     /* module arena chunk size (bytes) */
+#define LOAD_DECAY 0.99f        /* per buffer decay of the DSP load peak */
 
 struct synth {
 	struct module *root;                            /* root patch */
-	struct event_queue eq;                          /* input event queue */
+	struct plan *plan;                              /* root patch execution plan */
+	struct event_queue eq;                          /* process time event queue */
+	struct event_queue iq;                          /* input event queue (other threads) */
+	atomic_uint frame;                              /* sample frame at the start of the buffer */
 	const struct synth_cfg *cfg;                    /* top-level module configuration */
 	midi_out_func midi_out;                         /* MIDI output callback */
 	void *driver;                                   /* pointer to audio/midi driver (E.g. jack) */
-	struct midi_map mmap[NUM_MIDI_MAP_SLOTS];       /* MIDI CC map */
+	uint16_t midx[NUM_MIDI_MAP_INDEX];              /* MIDI ch/cc to map slot + 1 (0 = not mapped) */
+	struct midi_map *mmap;                          /* MIDI CC map slots */
+	int nmaps;                                      /* number of MIDI CC map slots */
+	int maxmaps;                                    /* allocated MIDI CC map slots */
+	struct param *params;                           /* shared parameters */
 	float *bufs[MAX_AUDIO_PORTS];                   /* allocated audio buffers */
+	struct arena abuf;                              /* audio buffer arena */
+	struct arena amod;                              /* module arena */
+	size_t n_audio_in;                              /* number of root audio input buffers */
+	size_t n_audio_out;                             /* number of root audio output buffers */
+	unsigned int rate;                              /* audio sample rate (Hz) */
+	size_t bufsize;                                 /* audio buffer size (samples) */
+	size_t bufstride;                               /* aligned audio buffer size (samples) */
+	float period;                                   /* audio sample period (secs) */
+	float fscale;                                   /* scales a frequency to a uint32_t phase step */
+	struct tuning tuning;                           /* MIDI note to phase step */
+	struct ggm_pool *pool;                          /* worker threads (NULL for serial processing) */
+	float load;                                     /* DSP load peak (fraction of the buffer period) */
+	float load_k;                                   /* DSP load per tick */
+	float load_limit;                               /* DSP load limit for new voices (0 = off) */
+#if defined(GGM_PROFILE)
+	struct prof_stats prof;                         /* synth loop time counters */
+	struct module *prof_list;                       /* modules with time counters */
+#endif
 };
 
 /******************************************************************************
@@ -67,14 +90,28 @@ struct synth {
 
 struct synth *synth_new(void);
 void synth_del(struct synth *s);
+int synth_set_audio(struct synth *s, unsigned int rate, size_t bufsize);
+int synth_set_threads(struct synth *s, unsigned int nthreads, int priority);
+int synth_set_tuning(struct synth *s, const struct tuning_scale *sc);
 int synth_set_root(struct synth *s, struct module *m);
 bool synth_has_root(struct synth *s);
 bool synth_loop(struct synth *s);
 int synth_event_wr(struct synth *s, struct module *m, int idx, const struct event *e);
+int synth_set_input_queue(struct synth *s, size_t n, bool mp);
+int synth_event_in(struct synth *s, struct module *m, port_func func, const struct event *e, uint32_t time);
+int synth_midi_in(struct synth *s, const struct event *e, uint32_t time);
+uint32_t synth_frame(struct synth *s);
+void synth_set_load_limit(struct synth *s, float limit);
+bool synth_overloaded(struct synth *s);
+float *synth_buf_alloc(struct synth *s, unsigned int n);
+void *synth_calloc(struct synth *s, size_t num, size_t size);
+void synth_free(struct synth *s, void *ptr);
 
 int synth_set_cfg(struct synth *s, const struct synth_cfg *cfg);
+const void *synth_lookup_cfg(struct synth *s, const char *path);
 void synth_input_cfg(struct synth *s, struct module *m, const struct port_info *pi);
 bool synth_midi_cc(struct synth *s, const struct event *e);
+void synth_midi_cc_batch(struct synth *s, const struct event_batch *b, struct event_batch *rest);
 
 /*****************************************************************************/
 
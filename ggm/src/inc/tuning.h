@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Note Tuning
+ */
+
+#ifndef GGM_SRC_INC_TUNING_H
+#define GGM_SRC_INC_TUNING_H
+
+#ifndef GGM_SRC_INC_GGM_H
+#warning "please include this file using ggm.h"
+#endif
+
+/******************************************************************************
+ * A tuning maps a (pitch bent) MIDI note to an oscillator phase step.
+ * The phase steps are tabulated at TUNING_DIV points per note, so a lookup
+ * is a linear interpolation between two table entries rather than a power
+ * function. Between the notes of the scale the pitch is interpolated
+ * exponentially (in cents) when the table is built.
+ *
+ * The scale is given as for a Scala (.scl) file: the pitches (cents) of the
+ * scale degrees 1..n above degree 0, the last pitch being the period of the
+ * scale (E.g. 1200 cents for an octave). Degree 0 is at MIDI note "note" and
+ * MIDI note "ref" has frequency "freq". The default is 12-TET with A4 (MIDI
+ * note 69) at 440 Hz.
+ */
+
+#define TUNING_NOTES 128                                /* MIDI notes 0..127 */
+#define TUNING_DIV 4                                    /* table points per note */
+#define TUNING_SIZE ((TUNING_NOTES * TUNING_DIV) + 1)   /* table size */
+
+struct tuning_scale {
+	const float *cents;     /* pitch of scale degrees 1..n (cents) */
+	int n;                  /* number of scale degrees */
+	int note;               /* MIDI note for scale degree 0 */
+	int ref;                /* MIDI note with the reference frequency */
+	float freq;             /* reference frequency (Hz) */
+};
+
+struct tuning {
+	float freq;                     /* reference frequency (Hz) */
+	float cents[TUNING_NOTES + 1];  /* MIDI note pitch relative to the reference (cents) */
+	float step[TUNING_SIZE];        /* phase step per sample */
+};
+
+/* tuning_step returns the phase step for a MIDI note (float) */
+static inline uint32_t tuning_step(const struct tuning *t, float note)
+{
+	float x = clampf(note, 0.f, (float)TUNING_NOTES) * (float)TUNING_DIV;
+	int i = (int)x;
+
+	if (i >= TUNING_SIZE - 1) {
+		return (uint32_t)t->step[TUNING_SIZE - 1];
+	}
+	float k = x - (float)i;
+	return (uint32_t)(t->step[i] + k * (t->step[i + 1] - t->step[i]));
+}
+
+/******************************************************************************
+ * function prototypes
+ */
+
+int tuning_set(struct tuning *t, const struct tuning_scale *sc);
+void tuning_update(struct tuning *t, float fscale);
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_INC_TUNING_H */
+
+/*****************************************************************************/
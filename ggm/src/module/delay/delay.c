@@ -8,6 +8,20 @@
 
 #include "ggm.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define DELAY_IN_PORTS(X)	\
+	X(DELAY_IN, in, .type = PORT_TYPE_AUDIO)
+
+enum { DELAY_IN_PORTS(PORT_ID) };
+
+#define DELAY_OUT_PORTS(X)	\
+	X(DELAY_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { DELAY_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -30,7 +44,7 @@ struct delay {
 static int delay_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct delay *this = ggm_calloc(1, sizeof(struct delay));
+	struct delay *this = synth_calloc(m->top, 1, sizeof(struct delay));
 
 	if (this == NULL) {
 		return -1;
@@ -46,8 +60,8 @@ static int delay_alloc(struct module *m, va_list vargs)
 
 	/* allocate the delay line */
 	this->n = (size_t)samples;
-	this->t = (float)this->n * AudioSamplePeriod;
-	this->buf = (float *)ggm_calloc(this->n, sizeof(float));
+	this->t = (float)this->n * m->top->period;
+	this->buf = (float *)synth_calloc(m->top, this->n, sizeof(float));
 	if (this->buf == NULL) {
 		LOG_ERR("unable to allocate delay line of %d samples", this->n);
 		goto error;
@@ -59,8 +73,8 @@ static int delay_alloc(struct module *m, va_list vargs)
 
 error:
 
-	ggm_free(this->buf);
-	ggm_free(this);
+	synth_free(m->top, this->buf);
+	synth_free(m->top, this);
 	return -1;
 }
 
@@ -68,18 +82,18 @@ static void delay_free(struct module *m)
 {
 	struct delay *this = (struct delay *)m->priv;
 
-	ggm_free(this->buf);
-	ggm_free(this);
+	synth_free(m->top, this->buf);
+	synth_free(m->top, this);
 }
 
-static bool delay_process(struct module *m, float *bufs[])
+static bool delay_process(struct module *m, float *bufs[], size_t n)
 {
 	struct delay *this = (struct delay *)m->priv;
 	float *in = bufs[0];
 	float *out = bufs[1];
 	int eob = this->n - 1;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		/* read index */
 		int rd = this->wr - 1;
 		if (rd < 0) {
@@ -102,12 +116,12 @@ static bool delay_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "in", .type = PORT_TYPE_AUDIO, },
+	DELAY_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	DELAY_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -7,22 +7,37 @@
  */
 
 #include "ggm.h"
+#include "env/env.h"
 
 /******************************************************************************
- * private state
+ * ports
  */
 
-enum adsr_state {
-	ADSR_STATE_IDLE = 0, /* initial state */
-	ADSR_STATE_ATTACK,
-	ADSR_STATE_DECAY,
-	ADSR_STATE_SUSTAIN,
-	ADSR_STATE_RELEASE,
-	ADSR_STATE_RESET,
-};
+#define ADSR_IN_PORTS(X)														\
+	X(ADSR_IN, reset, .type = PORT_TYPE_BOOL, .pf = adsr_port_reset)								\
+	X(ADSR_IN, gate, .type = PORT_TYPE_FLOAT, .pf = adsr_port_gate)									\
+	X(ADSR_IN, attack, .type = PORT_TYPE_FLOAT, .pf = adsr_port_attack, .mf = adsr_midi_attack, .vf = adsr_param_attack)		\
+	X(ADSR_IN, decay, .type = PORT_TYPE_FLOAT, .pf = adsr_port_decay, .mf = adsr_midi_decay, .vf = adsr_param_decay)		\
+	X(ADSR_IN, sustain, .type = PORT_TYPE_FLOAT, .pf = adsr_port_sustain, .mf = adsr_midi_sustain, .vf = adsr_param_sustain)	\
+	X(ADSR_IN, release, .type = PORT_TYPE_FLOAT, .pf = adsr_port_release, .mf = adsr_midi_release, .vf = adsr_param_release)
+
+enum { ADSR_IN_PORTS(PORT_ID) };
+
+#define ADSR_OUT_PORTS(X)	\
+	X(ADSR_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { ADSR_OUT_PORTS(PORT_ID) };
+
+/******************************************************************************
+ * private state
+ */
 
 struct adsr {
 	enum adsr_state state;          /* envelope state */
+	struct param *attack;           /* attack constant */
+	struct param *decay;            /* decay constant */
+	struct param *sustain;          /* sustain level */
+	struct param *release;          /* release constant */
 	float s;                        /* sustain level */
 	float ka;                       /* attack constant */
 	float kd;                       /* decay constant */
@@ -34,36 +49,6 @@ struct adsr {
 	float val;                      /* output value */
 };
 
-/* When we need to shutdown a voice we do it slowly to avoid any clicks in
- * the output. The soft reset of the ADSR envelope does this. It's essentially
- * the same as the release state, but works over a constant/short time period.
- */
-#define SOFT_RESET_TIME 30e-3f
-
-/* Set a minimum value for the attack/decay/release times.
- * We want to avoid clicks/poppiness in the output caused by abrupt change.
- */
-#define MIN_ATTACK_TIME 2e-3f
-#define MIN_DECAY_TIME 4e-3f
-#define MIN_RELEASE_TIME 4e-3f
-
-/******************************************************************************
- * We can't reach the target level with the asymptotic rise/fall of exponentials.
- * We will change state when we are within LEVEL_EPSILON of the target level.
- */
-
-#define LEVEL_EPSILON (0.001f)
-#define LN_LEVEL_EPSILON (-6.9077553f)  /* ln(LEVEL_EPSILON) */
-
-/* Return a k value to give the exponential rise/fall in the required time. */
-static float get_k(float t, int rate)
-{
-	if (t <= 0.f) {
-		return 1.f;
-	}
-	return 1.f - powe(LN_LEVEL_EPSILON / (t * (float)rate));
-}
-
 /******************************************************************************
  * MIDI to port event conversion functions
  */
@@ -101,6 +86,59 @@ static void adsr_midi_release(struct event *dst, const struct event *src)
 	event_set_float(dst, x);
 }
 
+/******************************************************************************
+ * shared parameter functions
+ */
+
+/* adsr_param_attack sets the attack constant from the attack time (secs) */
+static void adsr_param_attack(struct param *p, const struct event *e)
+{
+	float attack = clampf_lo(event_get_float(e), MIN_ATTACK_TIME);
+
+	LOG_DBG("attack %f secs", attack);
+	param_set(p, adsr_get_k(attack, p->top->rate));
+}
+
+/* adsr_param_decay sets the decay constant from the decay time (secs) */
+static void adsr_param_decay(struct param *p, const struct event *e)
+{
+	float decay = clampf_lo(event_get_float(e), MIN_DECAY_TIME);
+
+	LOG_DBG("decay %f secs", decay);
+	param_set(p, adsr_get_k(decay, p->top->rate));
+}
+
+/* adsr_param_sustain sets the sustain level 0..1 */
+static void adsr_param_sustain(struct param *p, const struct event *e)
+{
+	float sustain = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_DBG("sustain %f", sustain);
+	param_set(p, sustain);
+}
+
+/* adsr_param_release sets the release constant from the release time (secs) */
+static void adsr_param_release(struct param *p, const struct event *e)
+{
+	float release = clampf_lo(event_get_float(e), MIN_RELEASE_TIME);
+
+	LOG_DBG("release %f secs", release);
+	param_set(p, adsr_get_k(release, p->top->rate));
+}
+
+/* adsr_update reads the (possibly shared) parameters */
+static void adsr_update(struct adsr *this)
+{
+	float sustain = this->sustain->val;
+
+	this->ka = this->attack->val;
+	this->kd = this->decay->val;
+	this->kr = this->release->val;
+	this->s = sustain;
+	this->s_trigger = sustain + (1.f - sustain) * LEVEL_EPSILON;
+	this->i_trigger = sustain * LEVEL_EPSILON;
+}
+
 /******************************************************************************
  * module port functions
  */
@@ -145,7 +183,7 @@ static void adsr_port_gate(struct module *m, const struct event *e)
 
 	/* release */
 	if (this->state != ADSR_STATE_IDLE) {
-		if (this->kr == 1.f) {
+		if (this->release->val == 1.f) {
 			/* no release - goto idle */
 			this->val = 0.f;
 			this->state = ADSR_STATE_IDLE;
@@ -159,43 +197,32 @@ static void adsr_port_gate(struct module *m, const struct event *e)
 static void adsr_port_attack(struct module *m, const struct event *e)
 {
 	struct adsr *this = (struct adsr *)m->priv;
-	float attack = clampf_lo(event_get_float(e), MIN_ATTACK_TIME);
 
-	LOG_DBG("%s:attack %f secs", m->name, attack);
-	this->ka = get_k(attack, AudioSampleFrequency);
+	adsr_param_attack(this->attack, e);
 }
 
 /* adsr_port_decay sets the decay time (secs) */
 static void adsr_port_decay(struct module *m, const struct event *e)
 {
 	struct adsr *this = (struct adsr *)m->priv;
-	float decay = clampf_lo(event_get_float(e), MIN_DECAY_TIME);
 
-	LOG_DBG("%s:decay %f secs", m->name, decay);
-	this->kd = get_k(decay, AudioSampleFrequency);
+	adsr_param_decay(this->decay, e);
 }
 
 /* adsr_port_sustain sets the sustain level 0..1 */
 static void adsr_port_sustain(struct module *m, const struct event *e)
 {
 	struct adsr *this = (struct adsr *)m->priv;
-	float sustain = clampf(event_get_float(e), 0.f, 1.f);
 
-	LOG_DBG("%s:sustain %f", m->name, sustain);
-	this->s = sustain;
-	this->d_trigger = 1.f - LEVEL_EPSILON;
-	this->s_trigger = sustain + (1.f - sustain) * LEVEL_EPSILON;
-	this->i_trigger = sustain * LEVEL_EPSILON;
+	adsr_param_sustain(this->sustain, e);
 }
 
 /* adsr_port_release sets the release time (secs) */
 static void adsr_port_release(struct module *m, const struct event *e)
 {
 	struct adsr *this = (struct adsr *)m->priv;
-	float release = clampf_lo(event_get_float(e), MIN_RELEASE_TIME);
 
-	LOG_DBG("%s:release %f secs", m->name, release);
-	this->kr = get_k(release, AudioSampleFrequency);
+	adsr_param_release(this->release, e);
 }
 
 /******************************************************************************
@@ -205,7 +232,7 @@ static void adsr_port_release(struct module *m, const struct event *e)
 static int adsr_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct adsr *this = ggm_calloc(1, sizeof(struct adsr));
+	struct adsr *this = synth_calloc(m->top, 1, sizeof(struct adsr));
 
 	if (this == NULL) {
 		return -1;
@@ -213,17 +240,28 @@ static int adsr_alloc(struct module *m, va_list vargs)
 	m->priv = (void *)this;
 
 	/* set the soft reset time */
-	this->k_reset = get_k(SOFT_RESET_TIME, AudioSampleFrequency);
+	this->k_reset = adsr_get_k(SOFT_RESET_TIME, m->top->rate);
+	this->d_trigger = 1.f - LEVEL_EPSILON;
+
+	/* the parameters may be shared with other envelopes */
+	this->attack = param_new(m, "attack", 0.f);
+	this->decay = param_new(m, "decay", 0.f);
+	this->sustain = param_new(m, "sustain", 0.f);
+	this->release = param_new(m, "release", 0.f);
+	if (this->attack == NULL || this->decay == NULL || this->sustain == NULL || this->release == NULL) {
+		synth_free(m->top, this);
+		return -1;
+	}
 
 	return 0;
 }
 
 static void adsr_free(struct module *m)
 {
-	ggm_free(m->priv);
+	synth_free(m->top, m->priv);
 }
 
-static bool adsr_process(struct module *m, float *buf[])
+static bool adsr_process(struct module *m, float *buf[], size_t n)
 {
 	struct adsr *this = (struct adsr *)m->priv;
 	float *out = buf[0];
@@ -233,7 +271,9 @@ static bool adsr_process(struct module *m, float *buf[])
 		return false;
 	}
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	adsr_update(this);
+
+	for (size_t i = 0; i < n; i++) {
 		switch (this->state) {
 
 		case ADSR_STATE_IDLE:
@@ -311,17 +351,12 @@ static bool adsr_process(struct module *m, float *buf[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = adsr_port_reset },
-	{ .name = "gate", .type = PORT_TYPE_FLOAT, .pf = adsr_port_gate },
-	{ .name = "attack", .type = PORT_TYPE_FLOAT, .pf = adsr_port_attack, .mf = adsr_midi_attack, },
-	{ .name = "decay", .type = PORT_TYPE_FLOAT, .pf = adsr_port_decay, .mf = adsr_midi_decay, },
-	{ .name = "sustain", .type = PORT_TYPE_FLOAT, .pf = adsr_port_sustain, .mf = adsr_midi_sustain, },
-	{ .name = "release", .type = PORT_TYPE_FLOAT, .pf = adsr_port_release, .mf = adsr_midi_release, },
+	ADSR_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	ADSR_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GGM_SRC_MODULE_ENV_ENV_H
+#define GGM_SRC_MODULE_ENV_ENV_H
+
+/******************************************************************************
+ * ADSR envelope states (env/adsr and midi/bank)
+ */
+
+enum adsr_state {
+	ADSR_STATE_IDLE = 0, /* initial state */
+	ADSR_STATE_ATTACK,
+	ADSR_STATE_DECAY,
+	ADSR_STATE_SUSTAIN,
+	ADSR_STATE_RELEASE,
+	ADSR_STATE_RESET,
+};
+
+/* When we need to shutdown a voice we do it slowly to avoid any clicks in
+ * the output. The soft reset of the ADSR envelope does this. It's essentially
+ * the same as the release state, but works over a constant/short time period.
+ */
+#define SOFT_RESET_TIME 30e-3f
+
+/* Set a minimum value for the attack/decay/release times.
+ * We want to avoid clicks/poppiness in the output caused by abrupt change.
+ */
+#define MIN_ATTACK_TIME 2e-3f
+#define MIN_DECAY_TIME 4e-3f
+#define MIN_RELEASE_TIME 4e-3f
+
+/******************************************************************************
+ * We can't reach the target level with the asymptotic rise/fall of exponentials.
+ * We will change state when we are within LEVEL_EPSILON of the target level.
+ */
+
+#define LEVEL_EPSILON (0.001f)
+#define LN_LEVEL_EPSILON (-6.9077553f)  /* ln(LEVEL_EPSILON) */
+
+/* adsr_get_k returns a k value to give the exponential rise/fall in the required time. */
+static inline float adsr_get_k(float t, int rate)
+{
+	if (t <= 0.f) {
+		return 1.f;
+	}
+	return 1.f - powe(LN_LEVEL_EPSILON / (t * (float)rate));
+}
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_MODULE_ENV_ENV_H */
+
+/*****************************************************************************/
@@ -10,6 +10,22 @@
 #include "ggm.h"
 #include "filter/filter.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define BIQUAD_IN_PORTS(X)							\
+	X(BIQUAD_IN, in, .type = PORT_TYPE_AUDIO)				\
+	X(BIQUAD_IN, cutoff, .type = PORT_TYPE_FLOAT, .pf = biquad_port_cutoff)	\
+	X(BIQUAD_IN, resonance, .type = PORT_TYPE_FLOAT, .pf = biquad_port_resonance)
+
+enum { BIQUAD_IN_PORTS(PORT_ID) };
+
+#define BIQUAD_OUT_PORTS(X)	\
+	X(BIQUAD_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { BIQUAD_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -27,7 +43,7 @@ struct biquad {
 static void biquad_port_cutoff(struct module *m, const struct event *e)
 {
 	// struct biquad *this = (struct biquad *)m->priv;
-	float cutoff = clampf(event_get_float(e), 0.f, 0.5f * AudioSampleFrequency);
+	float cutoff = clampf(event_get_float(e), 0.f, 0.5f * (float)m->top->rate);
 
 	LOG_INF("set cutoff frequency %f Hz", cutoff);
 	/* TODO */
@@ -49,7 +65,7 @@ static void biquad_port_resonance(struct module *m, const struct event *e)
 static int biquad_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct biquad *this = ggm_calloc(1, sizeof(struct biquad));
+	struct biquad *this = synth_calloc(m->top, 1, sizeof(struct biquad));
 
 	if (this == NULL) {
 		return -1;
@@ -63,10 +79,10 @@ static void biquad_free(struct module *m)
 {
 	struct biquad *this = (struct biquad *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool biquad_process(struct module *m, float *bufs[])
+static bool biquad_process(struct module *m, float *bufs[], size_t n)
 {
 	struct biquad *this = (struct biquad *)m->priv;
 	float *in = bufs[0];
@@ -79,7 +95,7 @@ static bool biquad_process(struct module *m, float *bufs[])
 	float d1 = this->d1;
 	float d2 = this->d2;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		/* direct form 2 */
 		float d0 = in[i] - (b1 * d1) - (b2 * d2);
 		out[i] = (a0 * d0) + (a1 * d1) + (a2 * d2);
@@ -99,14 +115,12 @@ static bool biquad_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "in", .type = PORT_TYPE_AUDIO, },
-	{ .name = "cutoff", .type = PORT_TYPE_FLOAT, .pf = biquad_port_cutoff },
-	{ .name = "resonance", .type = PORT_TYPE_FLOAT, .pf = biquad_port_resonance },
+	BIQUAD_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	BIQUAD_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
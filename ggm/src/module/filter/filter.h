@@ -18,6 +18,26 @@ enum {
 	SVF_TYPE_MAX /* must be last */
 };
 
+/******************************************************************************
+ * SVF_TYPE_TRAPEZOIDAL coefficients (filter/svf and midi/bank)
+ */
+
+/* MIDI CC range of the cutoff frequency (Hz) */
+#define SVF_MIDI_MIN_CUTOFF 20.f
+#define SVF_MIDI_MAX_CUTOFF 16e3f
+
+/* svf_get_g returns the filter constant for the cutoff frequency (Hz) */
+static inline float svf_get_g(float cutoff, float period)
+{
+	return tanf(Pi * cutoff * period);
+}
+
+/* svf_get_k returns the filter constant for the resonance (0..1) */
+static inline float svf_get_k(float resonance)
+{
+	return 2.f - 2.f * resonance;
+}
+
 /*****************************************************************************/
 
 #endif /* GGM_SRC_MODULE_FILTER_FILTER_H */
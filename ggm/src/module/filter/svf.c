@@ -15,6 +15,22 @@
 #include "ggm.h"
 #include "filter/filter.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define SVF_IN_PORTS(X)											\
+	X(SVF_IN, in, .type = PORT_TYPE_AUDIO)								\
+	X(SVF_IN, cutoff, .type = PORT_TYPE_FLOAT, .pf = svf_port_cutoff, .mf = svf_midi_cutoff)	\
+	X(SVF_IN, resonance, .type = PORT_TYPE_FLOAT, .pf = svf_port_resonance, .mf = svf_midi_resonance)
+
+enum { SVF_IN_PORTS(PORT_ID) };
+
+#define SVF_OUT_PORTS(X)	\
+	X(SVF_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { SVF_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -22,6 +38,8 @@
 struct svf {
 
 	int type;       /* filter type */
+	struct smooth cutoff;           /* cutoff frequency (Hz) */
+	struct smooth resonance;        /* resonance 0..1 */
 	/* SVF_TYPE_HC */
 	float kf;       /* constant for cutoff frequency */
 	float kq;       /* constant for filter resonance */
@@ -38,7 +56,27 @@ struct svf {
  * svf functions
  */
 
-static void svf_filter_hc(struct module *m, float *in, float *out)
+/* svf_update sets the filter constants for the cutoff and resonance */
+static void svf_update(struct module *m, float cutoff, float resonance)
+{
+	struct svf *this = (struct svf *)m->priv;
+
+	switch (this->type) {
+	case SVF_TYPE_HC:
+		this->kf = 2.f * sinf(Pi * cutoff * m->top->period);
+		this->kq = 2.f - 2.f * resonance;
+		break;
+	case SVF_TYPE_TRAPEZOIDAL:
+		this->g = svf_get_g(cutoff, m->top->period);
+		this->k = svf_get_k(resonance);
+		break;
+	default:
+		LOG_ERR("bad filter type %d", this->type);
+		break;
+	}
+}
+
+static void svf_filter_hc(struct module *m, float *in, float *out, size_t n)
 {
 	struct svf *this = (struct svf *)m->priv;
 	float lp = this->lp;
@@ -46,7 +84,7 @@ static void svf_filter_hc(struct module *m, float *in, float *out)
 	float kf = this->kf;
 	float kq = this->kq;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		lp += kf * bp;
 		float hp = in[i] - lp - (kq * bp);
 		bp += kf * hp;
@@ -58,7 +96,7 @@ static void svf_filter_hc(struct module *m, float *in, float *out)
 	this->bp = bp;
 }
 
-static void svf_filter_trapezoidal(struct module *m, float *in,  float *out)
+static void svf_filter_trapezoidal(struct module *m, float *in, float *out, size_t n)
 {
 	struct svf *this = (struct svf *)m->priv;
 	float ic1eq = this->ic1eq;
@@ -67,7 +105,7 @@ static void svf_filter_trapezoidal(struct module *m, float *in,  float *out)
 	float a2 = this->g * a1;
 	float a3 = this->g * a2;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		float v0 = in[i];
 		float v3 = v0 - ic2eq;
 		float v1 = (a1 * ic1eq) + (a2 * v3);
@@ -87,46 +125,44 @@ static void svf_filter_trapezoidal(struct module *m, float *in,  float *out)
 	this->ic2eq = ic2eq;
 }
 
+/******************************************************************************
+ * MIDI to port event conversion functions
+ */
+
+static void svf_midi_cutoff(struct event *dst, const struct event *src)
+{
+	/* SVF_MIDI_MIN_CUTOFF..SVF_MIDI_MAX_CUTOFF Hz */
+	event_set_float(dst, map_exp(event_get_midi_cc_float(src), SVF_MIDI_MIN_CUTOFF, SVF_MIDI_MAX_CUTOFF, 4.f));
+}
+
+static void svf_midi_resonance(struct event *dst, const struct event *src)
+{
+	/* 0..1 */
+	event_set_float(dst, event_get_midi_cc_float(src));
+}
+
 /******************************************************************************
  * module port functions
  */
 
+/* svf_port_cutoff sets the cutoff frequency (Hz), the filter ramps to it */
 static void svf_port_cutoff(struct module *m, const struct event *e)
 {
 	struct svf *this = (struct svf *)m->priv;
-	float cutoff = clampf(event_get_float(e), 0.f, 0.5f * AudioSampleFrequency);
+	float cutoff = clampf(event_get_float(e), 0.f, 0.5f * (float)m->top->rate);
 
 	LOG_INF("set cutoff frequency %f Hz", cutoff);
-	switch (this->type) {
-	case SVF_TYPE_HC:
-		this->kf = 2.f * sinf(Pi * cutoff * AudioSamplePeriod);
-		break;
-	case SVF_TYPE_TRAPEZOIDAL:
-		this->g = tanf(Pi * cutoff * AudioSamplePeriod);
-		break;
-	default:
-		LOG_ERR("bad filter type %d", this->type);
-		break;
-	}
+	smooth_set(&this->cutoff, cutoff);
 }
 
+/* svf_port_resonance sets the resonance 0..1, the filter ramps to it */
 static void svf_port_resonance(struct module *m, const struct event *e)
 {
 	struct svf *this = (struct svf *)m->priv;
 	float resonance = clampf(event_get_float(e), 0.f, 1.f);
 
 	LOG_INF("set resonance %f", resonance);
-	switch (this->type) {
-	case SVF_TYPE_HC:
-		this->kq = 2.f - 2.f * resonance;
-		break;
-	case SVF_TYPE_TRAPEZOIDAL:
-		this->k = 2.f - 2.f * resonance;
-		break;
-	default:
-		LOG_ERR("bad filter type %d", this->type);
-		break;
-	}
+	smooth_set(&this->resonance, resonance);
 }
 
 /******************************************************************************
@@ -136,7 +172,7 @@ static void svf_port_resonance(struct module *m, const struct event *e)
 static int svf_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct svf *this = ggm_calloc(1, sizeof(struct svf));
+	struct svf *this = synth_calloc(m->top, 1, sizeof(struct svf));
 
 	if (this == NULL) {
 		return -1;
@@ -150,10 +186,15 @@ static int svf_alloc(struct module *m, va_list vargs)
 		goto error;
 	}
 
+	/* no output until the cutoff is set */
+	smooth_init(&this->cutoff, SMOOTH_ONEPOLE, SMOOTH_TIME, m->top->rate, 0.f);
+	smooth_init(&this->resonance, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, 1.f);
+	svf_update(m, 0.f, 1.f);
+
 	return 0;
 
 error:
-	ggm_free(this);
+	synth_free(m->top, this);
 	return -1;
 }
 
@@ -161,25 +202,38 @@ static void svf_free(struct module *m)
 {
 	struct svf *this = (struct svf *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool svf_process(struct module *m, float *bufs[])
+static bool svf_process(struct module *m, float *bufs[], size_t n)
 {
 	struct svf *this = (struct svf *)m->priv;
 	float *in = bufs[0];
 	float *out = bufs[1];
 
-	switch (this->type) {
-	case SVF_TYPE_HC:
-		svf_filter_hc(m, in, out);
-		break;
-	case SVF_TYPE_TRAPEZOIDAL:
-		svf_filter_trapezoidal(m, in, out);
-		break;
-	default:
-		LOG_ERR("bad filter type %d", this->type);
-		break;
+	while (n > 0) {
+		size_t k = n;
+		/* while ramping, update the filter constants every SMOOTH_BLOCK samples */
+		if (smooth_active(&this->cutoff) || smooth_active(&this->resonance)) {
+			k = (n < SMOOTH_BLOCK) ? n : SMOOTH_BLOCK;
+			float cutoff = smooth_block(&this->cutoff, k);
+			float resonance = smooth_block(&this->resonance, k);
+			svf_update(m, cutoff, resonance);
+		}
+		switch (this->type) {
+		case SVF_TYPE_HC:
+			svf_filter_hc(m, in, out, k);
+			break;
+		case SVF_TYPE_TRAPEZOIDAL:
+			svf_filter_trapezoidal(m, in, out, k);
+			break;
+		default:
+			LOG_ERR("bad filter type %d", this->type);
+			return true;
+		}
+		in += k;
+		out += k;
+		n -= k;
 	}
 	return true;
 }
@@ -189,14 +243,12 @@ static bool svf_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "in", .type = PORT_TYPE_AUDIO, },
-	{ .name = "cutoff", .type = PORT_TYPE_FLOAT, .pf = svf_port_cutoff },
-	{ .name = "resonance", .type = PORT_TYPE_FLOAT, .pf = svf_port_resonance },
+	SVF_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	SVF_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
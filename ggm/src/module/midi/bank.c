@@ -0,0 +1,711 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Polyphonic Voice Bank
+ * This is midi/poly for a fixed set of stock voices. The voice state is kept in
+ * arrays (one lane per voice) and groups of BANK_LANES voices are processed
+ * together with vector operations.
+ *
+ * Arguments:
+ * int ch, MIDI channel
+ * int type, voice type (BANK_VOICE_OSC_GOOM, BANK_VOICE_GOOM)
+ * int nvoices, number of voices (N active + 1 in soft reset)
+ *
+ * The voice allocation (and stealing), the envelope/oscillator/filter kernels
+ * and the voice mixing are done in the same way as for midi/poly with the stock
+ * voices, so the output is the same. The voice parameters (E.g. attack) are
+ * common to all voices and are set with the bank input ports. Each one is a
+ * single port, so it doesn't use a shared parameter (see param.h). A MIDI CC
+ * mapped to it is converted once for all of the voices.
+ *
+ * The bank voices have no fm/pm inputs. midi/poly leaves the fm/pm inputs of
+ * its voice oscillators unconnected, so the bank runs the unmodulated
+ * oscillator in the same way.
+ *
+ * The duty, slope, cutoff and resonance ramp as they do for the stock voices,
+ * but the bank updates the oscillator and filter constants once per BANK_BLOCK
+ * samples for all voices. The output differs from midi/poly while they ramp.
+ */
+
+#include "ggm.h"
+#include "env/env.h"
+#include "filter/filter.h"
+#include "midi/midi.h"
+#include "osc/osc.h"
+
+/******************************************************************************
+ * ports
+ */
+
+#define BANK_IN_PORTS(X)										\
+	X(BANK_IN, midi, .type = PORT_TYPE_MIDI, .pf = bank_port_midi)					\
+	X(BANK_IN, attack, .type = PORT_TYPE_FLOAT, .pf = bank_port_attack, .mf = bank_midi_attack)	\
+	X(BANK_IN, decay, .type = PORT_TYPE_FLOAT, .pf = bank_port_decay, .mf = bank_midi_decay)	\
+	X(BANK_IN, sustain, .type = PORT_TYPE_FLOAT, .pf = bank_port_sustain, .mf = bank_midi_float)	\
+	X(BANK_IN, release, .type = PORT_TYPE_FLOAT, .pf = bank_port_release, .mf = bank_midi_release)	\
+	X(BANK_IN, duty, .type = PORT_TYPE_FLOAT, .pf = bank_port_duty, .mf = bank_midi_float)		\
+	X(BANK_IN, slope, .type = PORT_TYPE_FLOAT, .pf = bank_port_slope, .mf = bank_midi_float)	\
+	X(BANK_IN, cutoff, .type = PORT_TYPE_FLOAT, .pf = bank_port_cutoff, .mf = bank_midi_cutoff)	\
+	X(BANK_IN, resonance, .type = PORT_TYPE_FLOAT, .pf = bank_port_resonance, .mf = bank_midi_float)
+
+enum { BANK_IN_PORTS(PORT_ID) };
+
+#define BANK_OUT_PORTS(X)	\
+	X(BANK_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { BANK_OUT_PORTS(PORT_ID) };
+
+/******************************************************************************
+ * private state
+ */
+
+#define MIN_POLYPHONY 2         /* 1 active + 1 in soft reset */
+#define MAX_POLYPHONY 256       /* maximum number of voices */
+#define NUM_NOTES 128           /* number of MIDI notes */
+
+#define BANK_LANES 8            /* voices per group */
+#define BANK_BLOCK 32           /* samples per pass */
+
+typedef float vf32 __attribute__((vector_size(BANK_LANES * sizeof(float))));
+typedef int32_t vi32 __attribute__((vector_size(BANK_LANES * sizeof(int32_t))));
+typedef uint32_t vu32 __attribute__((vector_size(BANK_LANES * sizeof(uint32_t))));
+
+/* vsel returns a where the mask is set, otherwise b */
+#define vsel(mask, a, b) ((vf32)(((mask) & (vi32)(a)) | (~(mask) & (vi32)(b))))
+#define vseli(mask, a, b) (((mask) & (a)) | (~(mask) & (b)))
+
+/* the kernels get an AVX2 version on x86-64 Linux */
+#if defined(__x86_64__) && defined(__LINUX__)
+#define BANK_TARGET __attribute__((target_clones("avx2", "default")))
+#else
+#define BANK_TARGET
+#endif
+
+/* bank_coef are the oscillator and filter constants for a pass */
+struct bank_coef {
+	struct goom_shape shape;        /* wave shape constants */
+	float a1;                       /* filter constant */
+	float a2;                       /* filter constant */
+	float a3;                       /* filter constant */
+};
+
+/* bank_group is the per-voice state for a group of voices */
+struct bank_group {
+	int32_t state[BANK_LANES];      /* envelope state */
+	float val[BANK_LANES];          /* envelope value */
+	uint32_t x[BANK_LANES];         /* oscillator phase position */
+	uint32_t xstep[BANK_LANES];     /* oscillator phase step per sample */
+	float ic1eq[BANK_LANES];        /* filter state variable */
+	float ic2eq[BANK_LANES];        /* filter state variable */
+};
+
+struct bank {
+	uint8_t ch;                     /* MIDI channel we are using */
+	int type;                       /* voice type */
+	struct voice_slot *voice;       /* voices */
+	int nvoices;                    /* number of voices */
+	struct bank_group *grp;         /* voice state groups */
+	int ngroups;                    /* number of voice state groups */
+	uint32_t count;                 /* number of voice allocations */
+	float bend;                     /* pitch bend value for all voices */
+	struct voice_slot *note[NUM_NOTES]; /* MIDI note to voice (or NULL) */
+	/* envelope */
+	float s;                        /* sustain level */
+	float ka;                       /* attack constant */
+	float kd;                       /* decay constant */
+	float kr;                       /* release constant */
+	float k_reset;                  /* soft reset constant */
+	float d_trigger;                /* attack->decay trigger level */
+	float s_trigger;                /* decay->sustain trigger level */
+	float i_trigger;                /* release->idle trigger level */
+	/* oscillator and filter */
+	struct smooth duty;             /* wave duty cycle */
+	struct smooth slope;            /* wave slope */
+	struct smooth cutoff;           /* cutoff frequency (Hz) */
+	struct smooth resonance;        /* resonance 0..1 */
+	struct bank_coef coef;          /* current oscillator and filter constants */
+};
+
+/******************************************************************************
+ * lane access
+ */
+
+#define LANE(this, v, field) ((this)->grp[(v) / BANK_LANES].field[(v) % BANK_LANES])
+
+/* bank_set_filter sets the filter constants (see filter/svf) */
+static void bank_set_filter(struct module *m, float cutoff, float resonance)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float g = svf_get_g(cutoff, m->top->period);
+	float k = svf_get_k(resonance);
+	float a1 = 1.f / (1.f + (g * (g + k)));
+
+	this->coef.a1 = a1;
+	this->coef.a2 = g * a1;
+	this->coef.a3 = g * (g * a1);
+}
+
+/* bank_ramping returns true if any of the shared parameters are ramping */
+static bool bank_ramping(const struct bank *this)
+{
+	return smooth_active(&this->duty) || smooth_active(&this->slope) ||
+	       smooth_active(&this->cutoff) || smooth_active(&this->resonance);
+}
+
+/* bank_update steps the ramping parameters by n samples and updates the constants */
+static void bank_update(struct module *m, size_t n)
+{
+	struct bank *this = (struct bank *)m->priv;
+
+	if (smooth_active(&this->duty) || smooth_active(&this->slope)) {
+		float duty = smooth_block(&this->duty, n);
+		float slope = smooth_block(&this->slope, n);
+		goom_shape_set(&this->coef.shape, duty, slope);
+	}
+	if (smooth_active(&this->cutoff) || smooth_active(&this->resonance)) {
+		float cutoff = smooth_block(&this->cutoff, n);
+		float resonance = smooth_block(&this->resonance, n);
+		bank_set_filter(m, cutoff, resonance);
+	}
+}
+
+/******************************************************************************
+ * voice functions
+ */
+
+/* voice_set_note sets the voice oscillator frequency */
+static void voice_set_note(struct module *m, int v, float note)
+{
+	struct bank *this = (struct bank *)m->priv;
+
+	LANE(this, v, xstep) = tuning_step(&m->top->tuning, note);
+}
+
+/* voice_reset sends a hard (true) or soft (false) reset to a voice */
+static void voice_reset(struct bank *this, int v, bool reset)
+{
+	if (reset) {
+		if (LANE(this, v, state) != ADSR_STATE_IDLE) {
+			LOG_WRN("forced idle");
+		}
+		LANE(this, v, val) = 0.f;
+		LANE(this, v, state) = ADSR_STATE_IDLE;
+		/* start at a phase that gives a zero output */
+		LANE(this, v, x) = this->coef.shape.xreset;
+	} else {
+		if (LANE(this, v, state) != ADSR_STATE_IDLE) {
+			LANE(this, v, state) = ADSR_STATE_RESET;
+		}
+	}
+}
+
+/* voice_gate is the voice gate, attack(>0) or release(=0) */
+static void voice_gate(struct bank *this, int v, float gate)
+{
+	this->voice[v].gate = (gate > 0.f);
+	this->voice[v].active = true;
+	if (gate > 0.f) {
+		LANE(this, v, state) = ADSR_STATE_ATTACK;
+		return;
+	}
+	if (LANE(this, v, state) != ADSR_STATE_IDLE) {
+		if (this->kr == 1.f) {
+			/* no release - goto idle */
+			LANE(this, v, val) = 0.f;
+			LANE(this, v, state) = ADSR_STATE_IDLE;
+		} else {
+			LANE(this, v, state) = ADSR_STATE_RELEASE;
+		}
+	}
+}
+
+/* voice_unmap removes the voice from the note to voice map */
+static void voice_unmap(struct bank *this, struct voice_slot *v)
+{
+	if (this->note[v->note] == v) {
+		this->note[v->note] = NULL;
+	}
+}
+
+/* voice_alloc allocates a new voice for the MIDI note */
+static struct voice_slot *voice_alloc(struct module *m, uint8_t note)
+{
+	struct bank *this = (struct bank *)m->priv;
+
+	/* don't use more voices if the synth is overloaded */
+	int next;
+	int i = voice_select(this->voice, sizeof(struct voice_slot), this->nvoices, synth_overloaded(m->top), &next);
+	struct voice_slot *v = &this->voice[i];
+
+	LOG_INF("allocate voice %d to note %d", i, note);
+
+	/* send a hard reset to the new voice */
+	voice_reset(this, i, true);
+
+	/* set the voice note */
+	voice_set_note(m, i, (float)note + this->bend);
+	voice_unmap(this, v);
+	v->note = note & (NUM_NOTES - 1);
+	v->age = ++this->count;
+	v->reset = false;
+	this->note[v->note] = v;
+
+	/* Send a soft reset to the next voice to be stolen so it will be idle
+	 * when we need to use it. It's not needed if there is an idle voice.
+	 */
+	if (next >= 0) {
+		voice_reset(this, next, false);
+		voice_unmap(this, &this->voice[next]);
+		this->voice[next].reset = true;
+	}
+
+	return v;
+}
+
+/******************************************************************************
+ * MIDI to port event conversion functions
+ */
+
+static void bank_midi_attack(struct event *dst, const struct event *src)
+{
+	/* MIN_ATTACK_TIME..1 secs */
+	event_set_float(dst, map_lin(event_get_midi_cc_float(src), MIN_ATTACK_TIME, 1.f));
+}
+
+static void bank_midi_decay(struct event *dst, const struct event *src)
+{
+	/* MIN_DECAY_TIME..2 secs */
+	event_set_float(dst, map_lin(event_get_midi_cc_float(src), MIN_DECAY_TIME, 2.f));
+}
+
+static void bank_midi_release(struct event *dst, const struct event *src)
+{
+	/* MIN_RELEASE_TIME..1 secs */
+	event_set_float(dst, map_lin(event_get_midi_cc_float(src), MIN_RELEASE_TIME, 1.f));
+}
+
+static void bank_midi_cutoff(struct event *dst, const struct event *src)
+{
+	/* SVF_MIDI_MIN_CUTOFF..SVF_MIDI_MAX_CUTOFF Hz */
+	event_set_float(dst, map_exp(event_get_midi_cc_float(src), SVF_MIDI_MIN_CUTOFF, SVF_MIDI_MAX_CUTOFF, 4.f));
+}
+
+static void bank_midi_float(struct event *dst, const struct event *src)
+{
+	/* 0..1 */
+	event_set_float(dst, event_get_midi_cc_float(src));
+}
+
+/******************************************************************************
+ * module port functions
+ */
+
+static void bank_port_midi(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+
+	if (!is_midi_ch(e, this->ch)) {
+		/* it's not for this channel */
+		return;
+	}
+
+	switch (event_get_midi_msg(e)) {
+
+	case MIDI_STATUS_NOTEON: {
+		uint8_t note = event_get_midi_note(e);
+		float vel = event_get_midi_velocity_float(e);
+		struct voice_slot *v = this->note[note & (NUM_NOTES - 1)];
+		if (v == NULL) {
+			v = voice_alloc(m, note);
+		}
+		/* note: vel = 0 is the same as note off (gate=0) */
+		voice_gate(this, v - this->voice, vel);
+		break;
+	}
+
+	case MIDI_STATUS_NOTEOFF: {
+		struct voice_slot *v = this->note[event_get_midi_note(e) & (NUM_NOTES - 1)];
+		if (v != NULL) {
+			voice_gate(this, v - this->voice, 0.f);
+		}
+		break;
+	}
+
+	case MIDI_STATUS_PITCHWHEEL: {
+		/* get the pitch bend value */
+		this->bend = midi_pitch_bend(event_get_midi_pitch_wheel(e));
+		/* update all voices */
+		for (int i = 0; i < this->nvoices; i++) {
+			voice_set_note(m, i, (float)(this->voice[i].note) + this->bend);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+static void bank_port_attack(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float attack = clampf_lo(event_get_float(e), MIN_ATTACK_TIME);
+
+	LOG_DBG("%s:attack %f secs", m->name, attack);
+	this->ka = adsr_get_k(attack, m->top->rate);
+}
+
+static void bank_port_decay(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float decay = clampf_lo(event_get_float(e), MIN_DECAY_TIME);
+
+	LOG_DBG("%s:decay %f secs", m->name, decay);
+	this->kd = adsr_get_k(decay, m->top->rate);
+}
+
+static void bank_port_sustain(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float sustain = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_DBG("%s:sustain %f", m->name, sustain);
+	this->s = sustain;
+	this->d_trigger = 1.f - LEVEL_EPSILON;
+	this->s_trigger = sustain + (1.f - sustain) * LEVEL_EPSILON;
+	this->i_trigger = sustain * LEVEL_EPSILON;
+}
+
+static void bank_port_release(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float release = clampf_lo(event_get_float(e), MIN_RELEASE_TIME);
+
+	LOG_DBG("%s:release %f secs", m->name, release);
+	this->kr = adsr_get_k(release, m->top->rate);
+}
+
+static void bank_port_duty(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float duty = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_INF("%s:duty %f", m->name, duty);
+	smooth_set(&this->duty, duty);
+}
+
+static void bank_port_slope(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float slope = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_INF("%s:slope %f", m->name, slope);
+	smooth_set(&this->slope, slope);
+}
+
+static void bank_port_cutoff(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float cutoff = clampf(event_get_float(e), 0.f, 0.5f * (float)m->top->rate);
+
+	LOG_INF("set cutoff frequency %f Hz", cutoff);
+	smooth_set(&this->cutoff, cutoff);
+}
+
+static void bank_port_resonance(struct module *m, const struct event *e)
+{
+	struct bank *this = (struct bank *)m->priv;
+	float resonance = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_INF("set resonance %f", resonance);
+	smooth_set(&this->resonance, resonance);
+}
+
+/******************************************************************************
+ * module functions
+ */
+
+static int bank_alloc(struct module *m, va_list vargs)
+{
+	/* allocate the private data */
+	struct bank *this = synth_calloc(m->top, 1, sizeof(struct bank));
+
+	if (this == NULL) {
+		return -1;
+	}
+	m->priv = (void *)this;
+
+	/* get the MIDI channel */
+	this->ch = va_arg(vargs, int);
+
+	/* get the voice type */
+	this->type = va_arg(vargs, int);
+	if ((this->type <= 0) || (this->type >= BANK_VOICE_MAX)) {
+		LOG_ERR("bad voice type %d", this->type);
+		goto error;
+	}
+
+	/* get the number of voices */
+	int nvoices = va_arg(vargs, int);
+	if (nvoices < MIN_POLYPHONY || nvoices > MAX_POLYPHONY) {
+		LOG_ERR("bad number of voices %d (%d..%d)", nvoices, MIN_POLYPHONY, MAX_POLYPHONY);
+		goto error;
+	}
+
+	/* allocate the voices and the voice state */
+	this->voice = synth_calloc(m->top, nvoices, sizeof(struct voice_slot));
+	if (this->voice == NULL) {
+		goto error;
+	}
+	this->nvoices = nvoices;
+	this->ngroups = (nvoices + BANK_LANES - 1) / BANK_LANES;
+	this->grp = synth_calloc(m->top, this->ngroups, sizeof(struct bank_group));
+	if (this->grp == NULL) {
+		goto error;
+	}
+
+	/* set the initial envelope, oscillator and filter values */
+	this->k_reset = adsr_get_k(SOFT_RESET_TIME, m->top->rate);
+	smooth_init(&this->duty, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, 0.5f);
+	smooth_init(&this->slope, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, 0.5f);
+	smooth_init(&this->cutoff, SMOOTH_ONEPOLE, SMOOTH_TIME, m->top->rate, 0.f);
+	smooth_init(&this->resonance, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, 1.f);
+	goom_shape_set(&this->coef.shape, 0.5f, 0.5f);
+	bank_set_filter(m, 0.f, 1.f);
+	for (int i = 0; i < nvoices; i++) {
+		LANE(this, i, x) = this->coef.shape.xreset;
+	}
+
+	return 0;
+
+error:
+	synth_free(m->top, this->grp);
+	synth_free(m->top, this->voice);
+	synth_free(m->top, this);
+	return -1;
+}
+
+static void bank_free(struct module *m)
+{
+	struct bank *this = (struct bank *)m->priv;
+
+	synth_free(m->top, this->grp);
+	synth_free(m->top, this->voice);
+	synth_free(m->top, this);
+}
+
+/* bank_group_process adds the output of a group of voices to the output buffer.
+ * It returns false if all of the voices are idle. Idle voices don't run their
+ * oscillator and filter, in the same way that midi/poly doesn't process them.
+ * It sets the active flag and peak output level of the nv voices in the group.
+ * Pass i uses the constants coef[i], the last of the ncoef constants is used
+ * for the remaining passes.
+ */
+BANK_TARGET static bool bank_group_process(struct bank *this, struct bank_group *grp, struct voice_slot *voice, int nv, const struct bank_coef *coef, size_t ncoef, float *out, size_t n)
+{
+	const vi32 idle = (vi32){} + ADSR_STATE_IDLE;
+	vi32 state;
+	vf32 val, ic1eq, ic2eq;
+	vu32 x, xstep;
+
+	memcpy(&state, grp->state, sizeof(vi32));
+	vi32 run = (state != idle);
+	bool active = false;
+	for (int i = 0; i < BANK_LANES; i++) {
+		active |= (run[i] != 0);
+	}
+	if (!active) {
+		for (int i = 0; i < nv; i++) {
+			voice[i].active = false;
+			voice[i].level = 0.f;
+		}
+		return false;
+	}
+
+	memcpy(&val, grp->val, sizeof(vf32));
+	memcpy(&x, grp->x, sizeof(vu32));
+	memcpy(&xstep, grp->xstep, sizeof(vu32));
+	memcpy(&ic1eq, grp->ic1eq, sizeof(vf32));
+	memcpy(&ic2eq, grp->ic2eq, sizeof(vf32));
+	vf32 ic1eq0 = ic1eq;
+	vf32 ic2eq0 = ic2eq;
+
+	/* the idle voices don't step their phase */
+	xstep &= (vu32)run;
+
+	/* envelope constants */
+	const vf32 zero = (vf32){};
+	const vf32 one = zero + 1.f;
+	const vf32 s = zero + this->s;
+	const vf32 ka = zero + this->ka;
+	const vf32 kd = zero + this->kd;
+	const vf32 kr = zero + this->kr;
+	const vf32 k_reset = zero + this->k_reset;
+	const vf32 d_trigger = zero + this->d_trigger;
+	const vf32 s_trigger = zero + this->s_trigger;
+	const vf32 i_trigger = zero + this->i_trigger;
+	const vi32 s_nz = (vi32){} - (this->s != 0.f);
+	const vi32 attack = (vi32){} + ADSR_STATE_ATTACK;
+	const vi32 decay = (vi32){} + ADSR_STATE_DECAY;
+	const vi32 sustain = (vi32){} + ADSR_STATE_SUSTAIN;
+	const vi32 release = (vi32){} + ADSR_STATE_RELEASE;
+	const vi32 reset = (vi32){} + ADSR_STATE_RESET;
+
+	/* oscillator constants */
+	const vf32 half = zero + (float)HalfCycle;
+	const vu32 half_ofs = (vu32){} + HalfCycle;
+
+	/* filter constants */
+	bool lpf = (this->type == BANK_VOICE_GOOM);
+	const vf32 two = zero + 2.f;
+
+	/* peak output level */
+	const vi32 abs_mask = (vi32){} + 0x7fffffff;
+	vf32 peak = zero;
+
+	vf32 env[BANK_BLOCK];
+	vu32 phase[BANK_BLOCK];
+	vf32 osc[BANK_BLOCK];
+
+	for (size_t pass = 0; n > 0; pass++) {
+		size_t k = (n < BANK_BLOCK) ? n : BANK_BLOCK;
+		const struct bank_coef *c = &coef[(pass < ncoef) ? pass : ncoef - 1];
+		const vf32 tp = zero + c->shape.tp;
+		const vf32 k0 = zero + c->shape.k0;
+		const vf32 k1 = zero + c->shape.k1;
+		const vf32 a1 = zero + c->a1;
+		const vf32 a2 = zero + c->a2;
+		const vf32 a3 = zero + c->a3;
+
+		/* envelope */
+		for (size_t i = 0; i < k; i++) {
+			vi32 is_a = (state == attack);
+			vi32 is_d = (state == decay);
+			vi32 is_r = (state == release) | (state == reset);
+			vi32 up_a = is_a & (val < d_trigger);
+			vi32 up_d = is_d & (val > s_trigger);
+			vi32 up_r = is_r & (val > i_trigger);
+			vf32 kx = vsel(is_a, ka, vsel(is_d, kd, vsel(state == release, kr, k_reset)));
+			vf32 target = vsel(is_a, one, vsel(is_d, s, zero));
+			vi32 to_d = is_a & ~up_a;
+			vi32 end_d = is_d & ~up_d;
+			vi32 to_s = end_d & s_nz;
+			vi32 to_i = (end_d & ~s_nz) | (is_r & ~up_r);
+			val = vsel(up_a | up_d | up_r, val + kx * (target - val), val);
+			val = vsel(to_d, one, val);
+			val = vsel(to_s, s, val);
+			val = vsel(to_i, zero, val);
+			state = vseli(to_d, decay, state);
+			state = vseli(to_s, sustain, state);
+			state = vseli(to_i, idle, state);
+			env[i] = val;
+		}
+
+		/* oscillator phase */
+		for (size_t i = 0; i < k; i++) {
+			vf32 xf = __builtin_convertvector(x, vf32);
+			vi32 s0 = (xf < tp);
+			vf32 y = vsel(s0, xf * k0, (xf - tp) * k1);
+			y = vsel(y > one, one, y);
+			phase[i] = __builtin_convertvector(y * half, vu32) + (half_ofs & ~(vu32)s0);
+			x += xstep;
+		}
+		block_cos_lookup((float *)osc, (const uint32_t *)phase, k * BANK_LANES);
+
+		/* filter, amplitude envelope and voice mixing */
+		for (size_t i = 0; i < k; i++) {
+			vf32 y = osc[i];
+			if (lpf) {
+				vf32 v3 = y - ic2eq;
+				vf32 v1 = (a1 * ic1eq) + (a2 * v3);
+				vf32 v2 = ic2eq + (a2 * ic1eq) + (a3 * v3);
+				ic1eq = (two * v1) - ic1eq;
+				ic2eq = (two * v2) - ic2eq;
+				y = v2;
+			}
+			y *= env[i];
+			vf32 ay = (vf32)((vi32)y & abs_mask);
+			peak = vsel(ay > peak, ay, peak);
+			float sum = out[i];
+			for (int j = 0; j < BANK_LANES; j++) {
+				sum += y[j];
+			}
+			out[i] = sum;
+		}
+
+		out += k;
+		n -= k;
+	}
+
+	/* the idle voices keep their filter state */
+	ic1eq = vsel(run, ic1eq, ic1eq0);
+	ic2eq = vsel(run, ic2eq, ic2eq0);
+
+	memcpy(grp->state, &state, sizeof(vi32));
+	memcpy(grp->val, &val, sizeof(vf32));
+	memcpy(grp->x, &x, sizeof(vu32));
+	memcpy(grp->ic1eq, &ic1eq, sizeof(vf32));
+	memcpy(grp->ic2eq, &ic2eq, sizeof(vf32));
+
+	for (int i = 0; i < nv; i++) {
+		voice[i].active = (run[i] != 0);
+		voice[i].level = (run[i] != 0) ? peak[i] : 0.f;
+	}
+	return true;
+}
+
+static bool bank_process(struct module *m, float *bufs[], size_t n)
+{
+	struct bank *this = (struct bank *)m->priv;
+	struct bank_coef coef[(MaxAudioBufferSize + BANK_BLOCK - 1) / BANK_BLOCK];
+	float *out = bufs[0];
+	bool active = false;
+	size_t ncoef = 0;
+
+	/* while ramping, update the constants for each pass */
+	for (size_t ofs = 0; ofs < n; ofs += BANK_BLOCK) {
+		if (ncoef != 0 && !bank_ramping(this)) {
+			break;
+		}
+		bank_update(m, ((n - ofs) < BANK_BLOCK) ? n - ofs : BANK_BLOCK);
+		coef[ncoef++] = this->coef;
+	}
+
+	block_zero(out, n);
+	for (int i = 0; i < this->ngroups; i++) {
+		int ofs = i * BANK_LANES;
+		int nv = mini(this->nvoices - ofs, BANK_LANES);
+		active |= bank_group_process(this, &this->grp[i], &this->voice[ofs], nv, coef, ncoef, out, n);
+	}
+	return active;
+}
+
+/******************************************************************************
+ * module information
+ */
+
+static const struct port_info in_ports[] = {
+	BANK_IN_PORTS(PORT_INFO)
+	PORT_EOL,
+};
+
+static const struct port_info out_ports[] = {
+	BANK_OUT_PORTS(PORT_INFO)
+	PORT_EOL,
+};
+
+const struct module_info midi_bank_module = {
+	.mname = "midi/bank",
+	.iname = "bank",
+	.in = in_ports,
+	.out = out_ports,
+	.alloc = bank_alloc,
+	.free = bank_free,
+	.process = bank_process,
+};
+
+MODULE_REGISTER(midi_bank_module);
+
+/*****************************************************************************/
@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef GGM_SRC_MODULE_MIDI_MIDI_H
+#define GGM_SRC_MODULE_MIDI_MIDI_H
+
+/******************************************************************************
+ * midi/bank voice types
+ */
+
+enum {
+	BANK_VOICE_NULL,
+	BANK_VOICE_OSC_GOOM,    /* voice/osc with osc/goom */
+	BANK_VOICE_GOOM,        /* voice/goom */
+	BANK_VOICE_MAX          /* must be last */
+};
+
+/******************************************************************************
+ * voice allocation (midi/poly and midi/bank)
+ */
+
+/* voice_slot is the allocation state of a voice. The voice structure of a
+ * polyphonic module starts with it.
+ */
+struct voice_slot {
+	uint8_t note;           /* the MIDI note for this voice */
+	uint32_t age;           /* allocation count when the voice was allocated */
+	float level;            /* peak output level for the last buffer */
+	bool gate;              /* the voice is gated (note on) */
+	bool reset;             /* indicates a voice in soft reset mode */
+	bool active;            /* the voice is active (not idle) */
+};
+
+int voice_select(const void *voices, size_t size, int n, bool limit, int *next);
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_MODULE_MIDI_MIDI_H */
+
+/*****************************************************************************/
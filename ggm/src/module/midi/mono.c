@@ -8,6 +8,20 @@
 
 #include "ggm.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define MONO_IN_PORTS(X)	\
+	X(MONO_IN, midi, .type = PORT_TYPE_MIDI, .pf = mono_port_midi)
+
+enum { MONO_IN_PORTS(PORT_ID) };
+
+#define MONO_OUT_PORTS(X)	\
+	X(MONO_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { MONO_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -17,6 +31,9 @@ struct mono {
 	uint8_t note;           /* the MIDI note for this voice */
 	float bend;             /* pitch bend value */
 	struct module *voice;   /* the voice module */
+	struct port_hdl voice_gate;     /* voice gate port */
+	struct port_hdl voice_note;     /* voice note port */
+	struct port_hdl voice_midi;     /* voice MIDI port (optional) */
 };
 
 /******************************************************************************
@@ -26,7 +43,6 @@ struct mono {
 static void mono_port_midi(struct module *m, const struct event *e)
 {
 	struct mono *this = (struct mono *)m->priv;
-	struct module *voice = this->voice;
 
 	if (!is_midi_ch(e, this->ch)) {
 		/* it's not for this channel */
@@ -40,17 +56,17 @@ static void mono_port_midi(struct module *m, const struct event *e)
 		float vel = event_get_midi_velocity_float(e);
 		if (note != this->note) {
 			/* set the note */
-			event_in_float(voice, "note", (float)note + this->bend, NULL);
+			event_in_hdl_float(&this->voice_note, (float)note + this->bend);
 			this->note = note;
 		}
 		/* note: vel = 0 is the same as note off (gate=0) */
-		event_in_float(voice, "gate", vel, NULL);
+		event_in_hdl_float(&this->voice_gate, vel);
 		break;
 	}
 
 	case MIDI_STATUS_NOTEOFF: {
 		/* send a note off control event, ignore the note off velocity (for now) */
-		event_in_float(voice, "gate", 0.f, NULL);
+		event_in_hdl_float(&this->voice_gate, 0.f);
 		break;
 	}
 
@@ -58,13 +74,13 @@ static void mono_port_midi(struct module *m, const struct event *e)
 		/* get the pitch bend value */
 		this->bend = midi_pitch_bend(event_get_midi_pitch_wheel(e));
 		/* update the voice */
-		event_in_float(voice, "note", (float)(this->note) + this->bend, NULL);
+		event_in_hdl_float(&this->voice_note, (float)(this->note) + this->bend);
 		break;
 	}
 
 	default: {
 		/* pass through the MIDI event to the voice */
-		event_in(voice, "midi", e, NULL);
+		event_in_hdl(&this->voice_midi, e);
 		break;
 	}
 
@@ -78,7 +94,7 @@ static void mono_port_midi(struct module *m, const struct event *e)
 static int mono_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct mono *this = ggm_calloc(1, sizeof(struct mono));
+	struct mono *this = synth_calloc(m->top, 1, sizeof(struct mono));
 
 	if (this == NULL) {
 		return -1;
@@ -95,11 +111,19 @@ static int mono_alloc(struct module *m, va_list vargs)
 		goto error;
 	}
 
+	/* resolve the voice ports, the MIDI port is optional */
+	if (port_get_hdl(&this->voice_gate, this->voice, "gate") != 0 ||
+	    port_get_hdl(&this->voice_note, this->voice, "note") != 0) {
+		LOG_ERR("%s needs gate and note ports", this->voice->name);
+		goto error;
+	}
+	port_get_hdl(&this->voice_midi, this->voice, "midi");
+
 	return 0;
 
 error:
 	module_del(this->voice);
-	ggm_free(this);
+	synth_free(m->top, this);
 	return -1;
 }
 
@@ -108,16 +132,15 @@ static void mono_free(struct module *m)
 	struct mono *this = (struct mono *)m->priv;
 
 	module_del(this->voice);
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool mono_process(struct module *m, float *bufs[])
+static int mono_compile(struct module *m, struct plan *p, const int *bufs, int cond)
 {
 	struct mono *this = (struct mono *)m->priv;
-	struct module *voice = this->voice;
-	float *out = bufs[0];
 
-	return voice->info->process(voice, (float *[]){ out, });
+	/* the voice output is the module output */
+	return plan_module_out(p, this->voice, bufs, cond);
 }
 
 /******************************************************************************
@@ -125,12 +148,12 @@ static bool mono_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "midi", .type = PORT_TYPE_MIDI, .pf = mono_port_midi },
+	MONO_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	MONO_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -141,7 +164,7 @@ const struct module_info midi_mono_module = {
 	.out = out_ports,
 	.alloc = mono_alloc,
 	.free = mono_free,
-	.process = mono_process,
+	.compile = mono_compile,
 };
 
 MODULE_REGISTER(midi_mono_module);
@@ -6,27 +6,78 @@
  * Polyphonic Module
  * Manage concurrent instances (voices) of a given sub-module.
  * Note: The single channel output is the sum of outputs from each single channel voice.
+ *
+ * Arguments:
+ * int ch, MIDI channel
+ * module_func new_voice, function to create a voice module
+ * int nvoices, number of voices (N active + 1 in soft reset)
+ *
+ * Only the voices on the active list are processed. A voice is added to the
+ * list when it is gated and removed when its process function returns false,
+ * so a voice module must stay silent until its next gate event once it has
+ * returned false. Each voice module is compiled into its own execution plan.
+ *
+ * If the synth has worker threads the voices are processed in parallel into
+ * per-voice buffers. The voice buffers are summed in voice order, so the output
+ * is the same as for serial processing. Voice modules must not push events
+ * (event_push) because they may run on a worker thread. For serial processing
+ * the voices share one output buffer and one set of plan buffers.
+ *
+ * A new note uses an idle voice if there is one, otherwise it steals a voice
+ * (see midi/voice.c). The next voice to be stolen is then sent a soft reset so
+ * it is quiet when it is stolen. If the synth DSP load is over its limit the
+ * idle voices aren't used, so the number of active voices doesn't grow.
  */
 
 #include "ggm.h"
+#include "midi/midi.h"
+
+/******************************************************************************
+ * ports
+ */
+
+#define POLY_IN_PORTS(X)	\
+	X(POLY_IN, midi, .type = PORT_TYPE_MIDI, .pf = poly_port_midi, .bf = poly_batch_midi)
+
+enum { POLY_IN_PORTS(PORT_ID) };
+
+#define POLY_OUT_PORTS(X)	\
+	X(POLY_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { POLY_OUT_PORTS(PORT_ID) };
 
 /******************************************************************************
  * private state
  */
 
-#define MAX_POLYPHONY 5 /* N active + 1 in soft reset */
+#define MIN_POLYPHONY 2         /* 1 active + 1 in soft reset */
+#define MAX_POLYPHONY 256       /* maximum number of voices */
+#define NUM_NOTES 128           /* number of MIDI notes */
 
 struct voice {
+	struct voice_slot slot; /* voice allocation state (must be first) */
 	struct module *m;       /* the voice module */
-	uint8_t note;           /* the MIDI note for this voice */
-	bool reset;             /* indicates a voice in soft reset mode */
+	struct port_hdl in_reset;       /* voice reset port */
+	struct port_hdl in_gate;        /* voice gate port */
+	struct port_hdl in_note;        /* voice note port */
+	struct port_hdl in_midi;        /* voice MIDI port (optional) */
+	struct plan *plan;      /* the voice execution plan */
+	bool out;               /* the voice output is non-zero */
+	float *buf;             /* voice output buffer */
+	float *bufs[MAX_AUDIO_PORTS];   /* voice plan buffers (unconnected inputs are NULL) */
 };
 
 struct poly {
 	uint8_t ch;                             /* MIDI channel we are using */
-	struct voice voice[MAX_POLYPHONY];      /* voices*/
-	int idx;                                /* round robin voice index */
+	struct voice *voice;                    /* voices */
+	int nvoices;                            /* number of voices */
+	uint32_t count;                         /* number of voice allocations */
 	float bend;                             /* pitch bend value for all voices */
+	struct voice *note[NUM_NOTES];          /* MIDI note to voice (or NULL) */
+	struct voice **active;                  /* active voices (in voice order) */
+	int nactive;                            /* number of active voices */
+	bool parallel;                          /* process the voices in parallel */
+	size_t n;                               /* samples to process (parallel processing) */
 };
 
 /******************************************************************************
@@ -38,13 +89,68 @@ static struct voice *voice_lookup(struct module *m, uint8_t note)
 {
 	struct poly *this = (struct poly *)m->priv;
 
-	for (int i = 0; i < MAX_POLYPHONY; i++) {
-		struct voice *v = &this->voice[i];
-		if (v->note == note && (v->reset == false)) {
-			return &this->voice[i];
+	return this->note[note & (NUM_NOTES - 1)];
+}
+
+/* voice_unmap removes the voice from the note to voice map */
+static void voice_unmap(struct poly *this, struct voice *v)
+{
+	if (this->note[v->slot.note] == v) {
+		this->note[v->slot.note] = NULL;
+	}
+}
+
+/* voice_wake adds a voice to the active list */
+static void voice_wake(struct poly *this, struct voice *v)
+{
+	if (v->slot.active) {
+		return;
+	}
+	/* keep the list in voice order */
+	int i = this->nactive;
+	while (i > 0 && this->active[i - 1] > v) {
+		this->active[i] = this->active[i - 1];
+		i--;
+	}
+	this->active[i] = v;
+	this->nactive++;
+	v->slot.active = true;
+}
+
+/* voice_sleep_idle removes voices with no output from the active list */
+static void voice_sleep_idle(struct poly *this)
+{
+	int k = 0;
+
+	for (int i = 0; i < this->nactive; i++) {
+		struct voice *v = this->active[i];
+		if (v->out) {
+			this->active[k++] = v;
+		} else {
+			v->slot.active = false;
 		}
 	}
-	return NULL;
+	this->nactive = k;
+}
+
+/* voice_gate sends a gate event to a voice */
+static void voice_gate(struct poly *this, struct voice *v, float gate)
+{
+	event_in_hdl_float(&v->in_gate, gate);
+	v->slot.gate = (gate > 0.f);
+	voice_wake(this, v);
+}
+
+/* voice_peak returns the peak level of a voice output buffer */
+static float voice_peak(const float *buf, size_t n)
+{
+	float peak = 0.f;
+
+	for (size_t i = 0; i < n; i++) {
+		float x = fabsf(buf[i]);
+		peak = (x > peak) ? x : peak;
+	}
+	return peak;
 }
 
 /* voice_alloc allocates a new voice module for the MIDI note */
@@ -52,33 +158,46 @@ static struct voice *voice_alloc(struct module *m, uint8_t note)
 {
 	struct poly *this = (struct poly *)m->priv;
 
-	LOG_INF("allocate voice %d to note %d", this->idx, note);
+	/* don't use more voices if the synth is overloaded */
+	int next;
+	int i = voice_select(this->voice, sizeof(struct voice), this->nvoices, synth_overloaded(m->top), &next);
+	struct voice *v = &this->voice[i];
 
-	/* do round-robin voice allocation */
-	struct voice *v = &this->voice[this->idx];
-	this->idx += 1;
-	if (this->idx == MAX_POLYPHONY) {
-		this->idx = 0;
-	}
+	LOG_INF("allocate voice %d to note %d", i, note);
 
 	/* send a hard reset to the new voice */
-	event_in_bool(v->m, "reset", true, NULL);
+	event_in_hdl_bool(&v->in_reset, true);
 
 	/* set the voice note */
-	event_in_float(v->m, "note", (float)note + this->bend, NULL);
-	v->note = note;
-	v->reset = false;
-
-	/* Send a soft reset to the next voice so it will be idle
-	 * when we need to use it.
+	event_in_hdl_float(&v->in_note, (float)note + this->bend);
+	voice_unmap(this, v);
+	v->slot.note = note & (NUM_NOTES - 1);
+	v->slot.age = ++this->count;
+	v->slot.reset = false;
+	this->note[v->slot.note] = v;
+
+	/* Send a soft reset to the next voice to be stolen so it will be idle
+	 * when we need to use it. It's not needed if there is an idle voice.
 	 */
-	struct voice *next_v = &this->voice[this->idx];
-	event_in_bool(next_v->m, "reset", false, NULL);
-	next_v->reset = true;
+	if (next >= 0) {
+		struct voice *next_v = &this->voice[next];
+		event_in_hdl_bool(&next_v->in_reset, false);
+		voice_unmap(this, next_v);
+		next_v->slot.reset = true;
+	}
 
 	return v;
 }
 
+/* poly_bend sends the pitch bend to all voices */
+static void poly_bend(struct poly *this)
+{
+	for (int i = 0; i < this->nvoices; i++) {
+		struct voice *v = &this->voice[i];
+		event_in_hdl_float(&v->in_note, (float)(v->slot.note) + this->bend);
+	}
+}
+
 /******************************************************************************
  * module port functions
  */
@@ -102,7 +221,7 @@ static void poly_port_midi(struct module *m, const struct event *e)
 			v = voice_alloc(m, note);
 		}
 		/* note: vel = 0 is the same as note off (gate=0) */
-		event_in_float(v->m, "gate", vel, NULL);
+		voice_gate(this, v, vel);
 		break;
 	}
 
@@ -110,7 +229,7 @@ static void poly_port_midi(struct module *m, const struct event *e)
 		struct voice *v = voice_lookup(m, event_get_midi_note(e));
 		if (v != NULL) {
 			/* send a note off control event, ignore the note off velocity (for now) */
-			event_in_float(v->m, "gate", 0.f, NULL);
+			voice_gate(this, v, 0.f);
 		}
 		break;
 	}
@@ -119,17 +238,14 @@ static void poly_port_midi(struct module *m, const struct event *e)
 		/* get the pitch bend value */
 		this->bend = midi_pitch_bend(event_get_midi_pitch_wheel(e));
 		/* update all voices */
-		for (int i = 0; i < MAX_POLYPHONY; i++) {
-			struct voice *v = &this->voice[i];
-			event_in_float(v->m, "note", (float)(v->note) + this->bend, NULL);
-		}
+		poly_bend(this);
 		break;
 	}
 
 	default: {
 		/* pass through the MIDI event to the voices */
-		for (int i = 0; i < MAX_POLYPHONY; i++) {
-			event_in(this->voice[i].m, "midi", e, NULL);
+		for (int i = 0; i < this->nvoices; i++) {
+			event_in_hdl(&this->voice[i].in_midi, e);
 		}
 		break;
 	}
@@ -138,6 +254,41 @@ static void poly_port_midi(struct module *m, const struct event *e)
 
 }
 
+/* poly_batch_midi handles a batch of MIDI events. The voices are updated
+ * once for the last pitch bend, and the pass through events are sent to each
+ * voice as a batch.
+ */
+static void poly_batch_midi(struct module *m, const struct event_batch *b)
+{
+	struct poly *this = (struct poly *)m->priv;
+	struct event_batch pass;
+	bool bend = false;
+
+	pass.n = 0;
+	for (size_t i = 0; i < b->n; i++) {
+		const struct event *e = &b->e[i];
+		if (!is_midi_ch(e, this->ch)) {
+			continue;
+		}
+		switch (event_get_midi_msg(e)) {
+		case MIDI_STATUS_PITCHWHEEL:
+			this->bend = midi_pitch_bend(event_get_midi_pitch_wheel(e));
+			bend = true;
+			break;
+		default:
+			event_batch_add(&pass, e);
+			break;
+		}
+	}
+
+	if (bend) {
+		poly_bend(this);
+	}
+	for (int i = 0; i < this->nvoices; i++) {
+		event_in_batch(&this->voice[i].in_midi, &pass);
+	}
+}
+
 /******************************************************************************
  * module functions
  */
@@ -145,7 +296,7 @@ static void poly_port_midi(struct module *m, const struct event *e)
 static int poly_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct poly *this = ggm_calloc(1, sizeof(struct poly));
+	struct poly *this = synth_calloc(m->top, 1, sizeof(struct poly));
 
 	if (this == NULL) {
 		return -1;
@@ -155,11 +306,83 @@ static int poly_alloc(struct module *m, va_list vargs)
 	/* get the MIDI channel */
 	this->ch = va_arg(vargs, int);
 
-	/* allocate the voices */
+	/* get the voice constructor and the number of voices */
 	module_func new_voice = va_arg(vargs, module_func);
-	for (int i = 0; i < MAX_POLYPHONY; i++) {
-		this->voice[i].m = new_voice(m, i);
-		if (this->voice[i].m == NULL) {
+	int nvoices = va_arg(vargs, int);
+	if (nvoices < MIN_POLYPHONY || nvoices > MAX_POLYPHONY) {
+		LOG_ERR("bad number of voices %d (%d..%d)", nvoices, MIN_POLYPHONY, MAX_POLYPHONY);
+		goto error;
+	}
+
+	/* allocate the voices */
+	this->voice = synth_calloc(m->top, nvoices, sizeof(struct voice));
+	if (this->voice == NULL) {
+		goto error;
+	}
+	this->nvoices = nvoices;
+
+	/* allocate the active voice list */
+	this->active = synth_calloc(m->top, nvoices, sizeof(struct voice *));
+	if (this->active == NULL) {
+		goto error;
+	}
+
+	/* allocate the voice output buffers */
+	this->parallel = (m->top->pool != NULL);
+	size_t bufstride = m->top->bufstride;
+	float *vbuf = synth_buf_alloc(m->top, this->parallel ? nvoices : 1);
+	if (vbuf == NULL) {
+		goto error;
+	}
+	for (int i = 0; i < nvoices; i++) {
+		this->voice[i].buf = this->parallel ? &vbuf[i * bufstride] : vbuf;
+	}
+
+	/* create the voice modules */
+	for (int i = 0; i < nvoices; i++) {
+		struct voice *v = &this->voice[i];
+		v->m = new_voice(m, i);
+		if (v->m == NULL) {
+			goto error;
+		}
+		/* resolve the voice ports, the MIDI port is optional */
+		if (port_get_hdl(&v->in_reset, v->m, "reset") != 0 ||
+		    port_get_hdl(&v->in_gate, v->m, "gate") != 0 ||
+		    port_get_hdl(&v->in_note, v->m, "note") != 0) {
+			LOG_ERR("%s needs reset, gate and note ports", v->m->name);
+			goto error;
+		}
+		port_get_hdl(&v->in_midi, v->m, "midi");
+		/* the voice audio inputs (E.g. oscillator modulation) are unconnected */
+		unsigned int n_in = port_count_by_type(v->m->info->in, PORT_TYPE_AUDIO);
+		if (n_in >= MAX_AUDIO_PORTS) {
+			LOG_ERR("%s has too many audio inputs", v->m->name);
+			goto error;
+		}
+		v->bufs[n_in] = v->buf;
+	}
+
+	/* compile the voice modules */
+	int nslots = 0;
+	for (int i = 0; i < nvoices; i++) {
+		struct plan *p = plan_new(this->voice[i].m);
+		if (p == NULL) {
+			goto error;
+		}
+		this->voice[i].plan = p;
+		nslots = (p->nslots > nslots) ? p->nslots : nslots;
+	}
+
+	/* allocate the voice plan buffers */
+	float *pbuf = NULL;
+	if (!this->parallel && nslots > 0) {
+		pbuf = synth_buf_alloc(m->top, nslots);
+		if (pbuf == NULL) {
+			goto error;
+		}
+	}
+	for (int i = 0; i < nvoices; i++) {
+		if (plan_set_bufs(this->voice[i].plan, pbuf) != 0) {
 			goto error;
 		}
 	}
@@ -167,10 +390,13 @@ static int poly_alloc(struct module *m, va_list vargs)
 	return 0;
 
 error:
-	for (int i = 0; i < MAX_POLYPHONY; i++) {
+	for (int i = 0; i < this->nvoices; i++) {
+		plan_del(this->voice[i].plan);
 		module_del(this->voice[i].m);
 	}
-	ggm_free(this);
+	synth_free(m->top, this->active);
+	synth_free(m->top, this->voice);
+	synth_free(m->top, this);
 	return -1;
 }
 
@@ -178,32 +404,75 @@ static void poly_free(struct module *m)
 {
 	struct poly *this = (struct poly *)m->priv;
 
-	for (int i = 0; i < MAX_POLYPHONY; i++) {
+	for (int i = 0; i < this->nvoices; i++) {
+		plan_del(this->voice[i].plan);
 		module_del(this->voice[i].m);
 	}
-	ggm_free(this);
+	synth_free(m->top, this->active);
+	synth_free(m->top, this->voice);
+	synth_free(m->top, this);
+}
+
+/* poly_voice_process processes an active voice into its buffer (called by a pool thread) */
+static void poly_voice_process(void *arg, unsigned int i)
+{
+	struct poly *this = (struct poly *)arg;
+	struct voice *v = this->active[i];
+
+	v->out = plan_run(v->plan, v->bufs, this->n);
+	v->slot.level = v->out ? voice_peak(v->buf, this->n) : 0.f;
+}
+
+/* poly_process_parallel processes the active voices on the synth worker threads */
+static bool poly_process_parallel(struct module *m, float *out, size_t n)
+{
+	struct poly *this = (struct poly *)m->priv;
+	bool active = false;
+
+	// run the voices
+	this->n = n;
+	ggm_pool_run(m->top->pool, poly_voice_process, this, this->nactive);
+
+	// sum the voice outputs in voice order
+	block_zero(out, n);
+	for (int i = 0; i < this->nactive; i++) {
+		struct voice *v = this->active[i];
+		if (v->out) {
+			block_add(out, v->buf, n);
+			active = true;
+		}
+	}
+
+	voice_sleep_idle(this);
+	return active;
 }
 
-static bool poly_process(struct module *m, float *bufs[])
+static bool poly_process(struct module *m, float *bufs[], size_t n)
 {
 	struct poly *this = (struct poly *)m->priv;
 	float *out = bufs[0];
 	bool active = false;
 
+	if (this->parallel) {
+		return poly_process_parallel(m, out, n);
+	}
+
 	// zero the output buffer
-	block_zero(out);
+	block_zero(out, n);
 
-	// run each voice
-	for (int i = 0; i < MAX_POLYPHONY; i++) {
-		struct module *vm = this->voice[i].m;
-		float vbuf[AudioBufferSize];
+	// run the active voices
+	for (int i = 0; i < this->nactive; i++) {
+		struct voice *v = this->active[i];
 
-		if (vm->info->process(vm, (float *[]){ vbuf, })) {
-			block_add(out, vbuf);
+		v->out = plan_run(v->plan, v->bufs, n);
+		v->slot.level = v->out ? voice_peak(v->buf, n) : 0.f;
+		if (v->out) {
+			block_add(out, v->buf, n);
 			active = true;
 		}
 	}
 
+	voice_sleep_idle(this);
 	return active;
 }
 
@@ -212,12 +481,12 @@ static bool poly_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "midi", .type = PORT_TYPE_MIDI, .pf = poly_port_midi },
+	POLY_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	POLY_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
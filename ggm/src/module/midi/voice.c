@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Voice Allocation
+ * The voice stealing policy of the polyphonic MIDI modules (midi/poly, midi/bank).
+ *
+ * A new note uses an idle voice if there is one, otherwise it steals a voice.
+ * The voice to steal is (in order of preference) the voice in soft reset, the
+ * quietest released voice (peak output level) or the oldest gated voice.
+ */
+
+#include "ggm.h"
+#include "midi/midi.h"
+
+/******************************************************************************
+ * voice stealing
+ */
+
+/* voice stealing preference (lowest first) */
+enum {
+	VOICE_IDLE,
+	VOICE_RESET,
+	VOICE_RELEASED,
+	VOICE_GATED,
+};
+
+static int voice_rank(const struct voice_slot *v)
+{
+	if (!v->active) {
+		return VOICE_IDLE;
+	}
+	if (v->reset) {
+		return VOICE_RESET;
+	}
+	return v->gate ? VOICE_GATED : VOICE_RELEASED;
+}
+
+/* voice_better returns true if voice a should be stolen before voice b */
+static bool voice_better(const struct voice_slot *a, const struct voice_slot *b)
+{
+	int ra = voice_rank(a);
+	int rb = voice_rank(b);
+
+	if (ra != rb) {
+		return ra < rb;
+	}
+	if (ra == VOICE_RELEASED && a->level != b->level) {
+		return a->level < b->level;
+	}
+	/* the oldest voice */
+	return (int32_t)(a->age - b->age) < 0;
+}
+
+/* voice_get returns voice i of an array of voices of size bytes */
+static const struct voice_slot *voice_get(const void *voices, size_t size, int i)
+{
+	return (const struct voice_slot *)((const uint8_t *)voices + ((size_t)i * size));
+}
+
+/* voice_steal returns the voice to use for a new note (not skip), or -1 if
+ * there isn't one. Idle voices aren't used if limit is true.
+ */
+static int voice_steal(const void *voices, size_t size, int n, int skip, bool limit)
+{
+	const struct voice_slot *best = NULL;
+	int idx = -1;
+
+	for (int i = 0; i < n; i++) {
+		const struct voice_slot *v = voice_get(voices, size, i);
+		if (i == skip || (limit && !v->active)) {
+			continue;
+		}
+		if (best == NULL || voice_better(v, best)) {
+			best = v;
+			idx = i;
+		}
+	}
+	return idx;
+}
+
+/******************************************************************************
+ * voice_select returns the voice to use for a new note. voices is an array of
+ * n voices of size bytes, each starting with a struct voice_slot. If limit is
+ * true (E.g. the synth is overloaded) the idle voices aren't used, unless all
+ * of the voices are idle. next is set to the next voice to be stolen, chosen
+ * in the same way, if it should be sent a soft reset so it will be quiet when
+ * it is stolen. Otherwise (E.g. there is an idle voice) it is set to -1.
+ */
+
+int voice_select(const void *voices, size_t size, int n, bool limit, int *next)
+{
+	int v = voice_steal(voices, size, n, -1, limit);
+
+	if (v < 0) {
+		/* all of the voices are idle */
+		limit = false;
+		v = voice_steal(voices, size, n, -1, false);
+	}
+
+	*next = voice_steal(voices, size, n, v, limit);
+	if (*next >= 0) {
+		const struct voice_slot *nv = voice_get(voices, size, *next);
+		if (!nv->active || nv->reset) {
+			*next = -1;
+		}
+	}
+	return v;
+}
+
+/*****************************************************************************/
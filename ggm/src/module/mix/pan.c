@@ -9,6 +9,23 @@
 
 #include "ggm.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define PAN_IN_PORTS(X)									\
+	X(PAN_IN, in, .type = PORT_TYPE_AUDIO)						\
+	X(PAN_IN, vol, .type = PORT_TYPE_FLOAT, .pf = pan_port_vol, .mf = pan_midi_cc)	\
+	X(PAN_IN, pan, .type = PORT_TYPE_FLOAT, .pf = pan_port_pan, .mf = pan_midi_cc)
+
+enum { PAN_IN_PORTS(PORT_ID) };
+
+#define PAN_OUT_PORTS(X)				\
+	X(PAN_OUT, out0, .type = PORT_TYPE_AUDIO)	\
+	X(PAN_OUT, out1, .type = PORT_TYPE_AUDIO)
+
+enum { PAN_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -16,10 +33,8 @@
 struct pan {
 	float vol;              /* overall volume */
 	float pan;              /* pan value 0 == left, 1 == right */
-	float new_vol_l;        /* target left channel volume */
-	float new_vol_r;        /* target right channel volume */
-	float vol_l;            /* left channel volume */
-	float vol_r;            /* right channel volume */
+	struct smooth vol_l;    /* left channel volume */
+	struct smooth vol_r;    /* right channel volume */
 };
 
 /******************************************************************************
@@ -41,8 +56,8 @@ static void pan_set(struct module *m)
 	struct pan *this = (struct pan *)m->priv;
 
 	/* Use sin/cos so that l*l + r*r = K (constant power) */
-	this->new_vol_l = this->vol * cosf(this->pan);
-	this->new_vol_r = this->vol * sinf(this->pan);
+	smooth_set(&this->vol_l, this->vol * cosf(this->pan));
+	smooth_set(&this->vol_r, this->vol * sinf(this->pan));
 }
 
 static void pan_port_vol(struct module *m, const struct event *e)
@@ -73,13 +88,17 @@ static void pan_port_pan(struct module *m, const struct event *e)
 static int pan_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct pan *this = ggm_calloc(1, sizeof(struct pan));
+	struct pan *this = synth_calloc(m->top, 1, sizeof(struct pan));
 
 	if (this == NULL) {
 		return -1;
 	}
 	m->priv = (void *)this;
 
+	/* the channel volumes ramp up from 0 */
+	smooth_init(&this->vol_l, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, 0.f);
+	smooth_init(&this->vol_r, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, 0.f);
+
 	/* set some default values */
 	event_in_float(m, "vol", 1.f, NULL);
 	event_in_float(m, "pan", 0.5f, NULL);
@@ -91,25 +110,25 @@ static void pan_free(struct module *m)
 {
 	struct pan *this = (struct pan *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool pan_process(struct module *m, float *bufs[])
+static bool pan_process(struct module *m, float *bufs[], size_t n)
 {
 	struct pan *this = (struct pan *)m->priv;
 	float *in = bufs[0];
 	float *out0 = bufs[1];
 	float *out1 = bufs[2];
 
-	/* use a proportional update to control the actual channel volume */
-	float err_l = this->new_vol_l - this->vol_l;
-	float err_r = this->new_vol_r - this->vol_r;
-
-	this->vol_l += 0.01f * err_l;
-	this->vol_r += 0.01f * err_r;
+	/* ramp the channel volumes */
+	size_t i = 0;
+	for (; i < n && (smooth_active(&this->vol_l) || smooth_active(&this->vol_r)); i++) {
+		float x = in[i];
+		out0[i] = x * smooth_next(&this->vol_l);
+		out1[i] = x * smooth_next(&this->vol_r);
+	}
 
-	block_copy_mul_k(out0, in, this->vol_l);
-	block_copy_mul_k(out1, in, this->vol_r);
+	block_copy_mul_k2(&out0[i], &out1[i], &in[i], this->vol_l.x, this->vol_r.x, n - i);
 	return true;
 }
 
@@ -118,15 +137,12 @@ static bool pan_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "in", .type = PORT_TYPE_AUDIO, },
-	{ .name = "vol", .type = PORT_TYPE_FLOAT, .pf = pan_port_vol, .mf = pan_midi_cc, },
-	{ .name = "pan", .type = PORT_TYPE_FLOAT, .pf = pan_port_pan, .mf = pan_midi_cc, },
+	PAN_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out0", .type = PORT_TYPE_AUDIO, },
-	{ .name = "out1", .type = PORT_TYPE_AUDIO, },
+	PAN_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
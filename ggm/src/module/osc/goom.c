@@ -20,75 +20,89 @@
  */
 
 #include "ggm.h"
+#include "osc/osc.h"
+
+/******************************************************************************
+ * ports
+ */
+
+#define GOOM_IN_PORTS(X)													\
+	X(GOOM_IN, frequency, .type = PORT_TYPE_FLOAT, .pf = goom_port_frequency)						\
+	X(GOOM_IN, note, .type = PORT_TYPE_FLOAT, .pf = goom_port_note)								\
+	X(GOOM_IN, duty, .type = PORT_TYPE_FLOAT, .pf = goom_port_duty, .mf = goom_midi_duty, .vf = goom_param_duty)		\
+	X(GOOM_IN, slope, .type = PORT_TYPE_FLOAT, .pf = goom_port_slope, .mf = goom_midi_slope, .vf = goom_param_slope)	\
+	X(GOOM_IN, reset, .type = PORT_TYPE_BOOL, .pf = goom_port_reset)							\
+	X(GOOM_IN, fm, .type = PORT_TYPE_AUDIO)											\
+	X(GOOM_IN, pm, .type = PORT_TYPE_AUDIO)
+
+enum { GOOM_IN_PORTS(PORT_ID) };
+
+#define GOOM_OUT_PORTS(X)	\
+	X(GOOM_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { GOOM_OUT_PORTS(PORT_ID) };
 
 /******************************************************************************
  * private state
  */
 
+#define GOOM_BLOCK_SIZE 64 /* phase values generated per pass */
+
 struct goom {
-	float freq;             /* base frequency */
-	float duty;             /* wave duty cycle */
-	float slope;            /* wave slope */
-	float tp;               /* s0f0 to s1f1 transition point */
-	float k0;               /* scaling factor for slope 0 */
-	float k1;               /* scaling factor for slope 1 */
+	struct param *pduty;    /* wave duty cycle parameter */
+	struct param *pslope;   /* wave slope parameter */
+	uint32_t gen;           /* parameter generation of the wave shape */
+	struct smooth duty;     /* wave duty cycle */
+	struct smooth slope;    /* wave slope */
+	struct goom_shape shape; /* wave shape constants */
 	uint32_t x;             /* phase position */
 	uint32_t xstep;         /* phase step per sample */
-	uint32_t xreset;        /* phase value for zero output */
 };
 
 /******************************************************************************
  * goom functions
  */
 
-/* goom_sample returns a single sample for the current phase value. */
-static float goom_sample(struct module *m)
+/* goom_phase returns the cosine phase for a goom phase value. */
+static inline uint32_t goom_phase(struct goom *this, uint32_t xg)
 {
-	struct goom *this = (struct goom *)m->priv;
 	uint32_t ofs = 0;
 	float x;
 
 	/* what portion of the goom wave are we in? */
-	if (this->x < this->tp) {
+	if (xg < this->shape.tp) {
 		/* we are in the s0/f0 portion */
-		x = (float)(this->x) * this->k0;
+		x = (float)(xg) * this->shape.k0;
 	} else {
 		/* we are in the s1/f1 portion */
-		x = (float)(this->x - this->tp) * this->k1;
+		x = (float)(xg - this->shape.tp) * this->shape.k1;
 		ofs = HalfCycle;
 	}
 	// clamp x to 1
 	if (x > 1.f) {
 		x = 1.f;
 	}
-	return cos_lookup((uint32_t)(x * (float)HalfCycle) + ofs);
+	return (uint32_t)(x * (float)HalfCycle) + ofs;
 }
 
-static void goom_set_shape(struct module *m, float duty, float slope)
+/* goom_update ramps to the (possibly shared) shape parameters if they have changed */
+static void goom_update(struct module *m)
 {
 	struct goom *this = (struct goom *)m->priv;
+	uint32_t gen = this->pduty->gen + this->pslope->gen;
 
-	/* update duty cycle */
-	this->duty = duty;
-	this->tp = (uint32_t)((float)FullCycle * map_lin(duty, 0.05f, 0.5f));
-	/* update the slope */
-	this->slope = slope;
-	/* Work out the portion of s0f0/s1f1 that is sloped. */
-	slope = map_lin(slope, 0.1f, 1.f);
-	/* scaling constant for s0, map the slope to the LUT. */
-	this->k0 = 1.f / ((float)(this->tp) * slope);
-	/* scaling constant for s1, map the slope to the LUT. */
-	this->k1 = 1.f / ((float)(FullCycle - 1 - this->tp) * slope);
-	/* this phase reset value gives zero output */
-	this->xreset = (uint32_t)((float)(this->tp) * slope * 0.5f);
+	if (gen != this->gen) {
+		this->gen = gen;
+		smooth_set(&this->duty, this->pduty->val);
+		smooth_set(&this->slope, this->pslope->val);
+	}
 }
 
 static void goom_set_frequency(struct module *m, float freq)
 {
 	struct goom *this = (struct goom *)m->priv;
 
-	this->freq = freq;
-	this->xstep = (uint32_t)(freq * FrequencyScale);
+	this->xstep = (uint32_t)(freq * m->top->fscale);
 }
 
 /******************************************************************************
@@ -107,6 +121,28 @@ static void goom_midi_slope(struct event *dst, const struct event *src)
 	event_set_float(dst, event_get_midi_cc_float(src));
 }
 
+/******************************************************************************
+ * shared parameter functions
+ */
+
+/* goom_param_duty sets the wave duty cycle */
+static void goom_param_duty(struct param *p, const struct event *e)
+{
+	float duty = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_INF("duty %f", duty);
+	param_set(p, duty);
+}
+
+/* goom_param_slope sets the wave slope */
+static void goom_param_slope(struct param *p, const struct event *e)
+{
+	float slope = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_INF("slope %f", slope);
+	param_set(p, slope);
+}
+
 /******************************************************************************
  * module port functions
  */
@@ -123,30 +159,27 @@ static void goom_port_frequency(struct module *m, const struct event *e)
 /* goom_port_note is the pitch bent MIDI note (float) used to set frequency */
 static void goom_port_note(struct module *m, const struct event *e)
 {
+	struct goom *this = (struct goom *)m->priv;
 	float note = event_get_float(e);
 
 	LOG_DBG("%s:note %f", m->name, note);
-	goom_set_frequency(m, midi_to_frequency(note));
+	this->xstep = tuning_step(&m->top->tuning, note);
 }
 
 /* goom_port_duty sets the wave duty cycle */
 static void goom_port_duty(struct module *m, const struct event *e)
 {
 	struct goom *this = (struct goom *)m->priv;
-	float duty = clampf(event_get_float(e), 0.f, 1.f);
 
-	LOG_INF("%s:duty %f", m->name, duty);
-	goom_set_shape(m, duty, this->slope);
+	goom_param_duty(this->pduty, e);
 }
 
 /* goom_port_slope sets the wave slope */
 static void goom_port_slope(struct module *m, const struct event *e)
 {
 	struct goom *this = (struct goom *)m->priv;
-	float slope = clampf(event_get_float(e), 0.f, 1.f);
 
-	LOG_INF("%s:slope %f", m->name, slope);
-	goom_set_shape(m, this->duty, slope);
+	goom_param_slope(this->pslope, e);
 }
 
 /* goom_port_reset resets the phase of the oscillator */
@@ -157,8 +190,13 @@ static void goom_port_reset(struct module *m, const struct event *e)
 	if (reset) {
 		struct goom *this = (struct goom *)m->priv;
 		LOG_DBG("%s:reset phase", m->name);
+		/* a new note starts with the current shape (no ramp) */
+		smooth_reset(&this->duty, this->pduty->val);
+		smooth_reset(&this->slope, this->pslope->val);
+		this->gen = this->pduty->gen + this->pslope->gen;
+		goom_shape_set(&this->shape, this->pduty->val, this->pslope->val);
 		/* start at a phase that gives a zero output */
-		this->x = this->xreset;
+		this->x = this->shape.xreset;
 	}
 }
 
@@ -169,17 +207,28 @@ static void goom_port_reset(struct module *m, const struct event *e)
 static int goom_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct goom *this = ggm_calloc(1, sizeof(struct goom));
+	struct goom *this = synth_calloc(m->top, 1, sizeof(struct goom));
 
 	if (this == NULL) {
 		return -1;
 	}
 	m->priv = (void *)this;
 
+	/* the shape parameters may be shared with other oscillators */
+	this->pduty = param_new(m, "duty", 0.5f);
+	this->pslope = param_new(m, "slope", 0.5f);
+	if (this->pduty == NULL || this->pslope == NULL) {
+		synth_free(m->top, this);
+		return -1;
+	}
+
 	/* set initial shape values */
-	goom_set_shape(m, 0.5f, 0.5f);
+	smooth_init(&this->duty, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, this->pduty->val);
+	smooth_init(&this->slope, SMOOTH_LINEAR, SMOOTH_TIME, m->top->rate, this->pslope->val);
+	this->gen = this->pduty->gen + this->pslope->gen;
+	goom_shape_set(&this->shape, this->pduty->val, this->pslope->val);
 	/* start at a phase that gives a zero output */
-	this->x = this->xreset;
+	this->x = this->shape.xreset;
 	return 0;
 }
 
@@ -187,20 +236,37 @@ static void goom_free(struct module *m)
 {
 	struct goom *this = (struct goom *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool goom_process(struct module *m, float *bufs[])
+static bool goom_process(struct module *m, float *bufs[], size_t n)
 {
 	struct goom *this = (struct goom *)m->priv;
-	float *out = bufs[0];
-
-	for (int i = 0; i < AudioBufferSize; i++) {
-		out[i] = goom_sample(m);
-		/* step the phase */
-		this->x += this->xstep;
-		// fm: m.x += uint32((m.freq + fm[i]) * core.FrequencyScale)
-		// pm: m.x += uint32(float32(m.xstep) + (pm[i] * core.PhaseScale))
+	const float *fm = bufs[0];
+	const float *pm = bufs[1];
+	float *out = bufs[2];
+	uint32_t phase[GOOM_BLOCK_SIZE];
+	float kfm = 1.f / (float)m->top->rate;
+
+	goom_update(m);
+
+	for (size_t ofs = 0; ofs < n; ofs += GOOM_BLOCK_SIZE) {
+		size_t k = ((n - ofs) < GOOM_BLOCK_SIZE) ? n - ofs : GOOM_BLOCK_SIZE;
+		/* while ramping, update the wave shape for each block */
+		if (smooth_active(&this->duty) || smooth_active(&this->slope)) {
+			float duty = smooth_block(&this->duty, k);
+			float slope = smooth_block(&this->slope, k);
+			goom_shape_set(&this->shape, duty, slope);
+		}
+		/* step the goom phase (fm is in Hz, pm is in radians) */
+		const float *fmk = (fm != NULL) ? &fm[ofs] : NULL;
+		const float *pmk = (pm != NULL) ? &pm[ofs] : NULL;
+		this->x = phase_block(phase, this->x, this->xstep, fmk, kfm, pmk, k);
+		/* map the goom phase to the cosine phase */
+		for (size_t i = 0; i < k; i++) {
+			phase[i] = goom_phase(this, phase[i]);
+		}
+		cos_lookup_buf(&out[ofs], phase, k);
 	}
 	return true;
 }
@@ -210,16 +276,12 @@ static bool goom_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "frequency", .type = PORT_TYPE_FLOAT, .pf = goom_port_frequency },
-	{ .name = "note", .type = PORT_TYPE_FLOAT, .pf = goom_port_note },
-	{ .name = "duty", .type = PORT_TYPE_FLOAT, .pf = goom_port_duty, .mf = goom_midi_duty },
-	{ .name = "slope", .type = PORT_TYPE_FLOAT, .pf = goom_port_slope, .mf = goom_midi_slope },
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = goom_port_reset },
+	GOOM_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	GOOM_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -17,6 +17,25 @@
 
 #include "ggm.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define KS_IN_PORTS(X)																\
+	X(KS_IN, reset, .type = PORT_TYPE_BOOL, .pf = ks_port_reset)										\
+	X(KS_IN, gate, .type = PORT_TYPE_FLOAT, .pf = ks_port_gate)										\
+	X(KS_IN, note, .type = PORT_TYPE_FLOAT, .pf = ks_port_note)										\
+	X(KS_IN, frequency, .type = PORT_TYPE_FLOAT, .pf = ks_port_frequency)									\
+	X(KS_IN, attenuation, .type = PORT_TYPE_FLOAT, .pf = ks_port_attenuation, .mf = ks_midi_attenuation, .vf = ks_param_attenuation)	\
+	X(KS_IN, fm, .type = PORT_TYPE_AUDIO)
+
+enum { KS_IN_PORTS(PORT_ID) };
+
+#define KS_OUT_PORTS(X)	\
+	X(KS_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { KS_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -37,12 +56,14 @@ enum ks_state {
 #define KS_FRAC_MASK ((1 << KS_FRAC_BITS) - 1)
 #define KS_FRAC_SCALE (1.f / (float)(1 << KS_FRAC_BITS))
 
+#define KS_BLOCK_SIZE 64 /* phase values generated per pass (fm) */
+
 struct ks {
 	int state;                      /* string state */
 	uint32_t rand;                  /* random state */
 	float delay[KS_DELAY_SIZE];     /* delay line */
+	struct param *attenuation;      /* plucked string attenuation */
 	float kval[KS_STATE_MAX];       /* attenuation per string state */
-	float freq;                     /* base frequency */
 	uint32_t x;                     /* phase position */
 	uint32_t xstep;                 /* phase step per sample */
 };
@@ -57,8 +78,7 @@ static void ks_set_frequency(struct module *m, float freq)
 	struct ks *this = (struct ks *)m->priv;
 
 	LOG_DBG("%s frequency %f", m->name, freq);
-	this->freq = freq;
-	this->xstep = (uint32_t)(freq * FrequencyScale);
+	this->xstep = (uint32_t)(freq * m->top->fscale);
 }
 
 /* ks_pluck_buffer initialises the delay buffer with random samples
@@ -86,6 +106,28 @@ static void ks_pluck_buffer(struct module *m, float gate)
 	this->delay[KS_DELAY_SIZE - 1] = -sum;
 }
 
+/* ks_sample returns the output for phase position x and filters the delay
+ * line if the next position, xn, has moved beyond the delay line index.
+ */
+static inline float ks_sample(struct ks *this, uint32_t x, uint32_t xn)
+{
+	uint32_t x0 = x >> KS_FRAC_BITS;
+	uint32_t x1 = (x0 + 1) & KS_DELAY_MASK;
+	float y0 = this->delay[x0];
+	float y1 = this->delay[x1];
+	/* interpolate */
+	float y = y0 + (y1 - y0) * KS_FRAC_SCALE * (float)(x & KS_FRAC_MASK);
+
+	/* filter: once we have moved beyond the delay line index we
+	 * will average it's amplitude with the next value.
+	 */
+	if (x0 != (xn >> KS_FRAC_BITS)) {
+		float k = this->kval[this->state];
+		this->delay[x0] = k * (y0 + y1);
+	}
+	return y;
+}
+
 /* ks_zero_buffer resets the delay buffer */
 static void ks_zero_buffer(struct module *m)
 {
@@ -109,6 +151,19 @@ static void ks_midi_attenuation(struct event *dst, const struct event *src)
 	event_set_float(dst, x);
 }
 
+/******************************************************************************
+ * shared parameter functions
+ */
+
+/* ks_param_attenuation sets the plucked string attenuation */
+static void ks_param_attenuation(struct param *p, const struct event *e)
+{
+	float attenuation = clampf(event_get_float(e), 0.f, 1.f);
+
+	LOG_DBG("attenuation %f", attenuation);
+	param_set(p, 0.5f * attenuation);
+}
+
 /******************************************************************************
  * module port functions
  */
@@ -146,10 +201,8 @@ static void ks_port_gate(struct module *m, const struct event *e)
 static void ks_port_attenuation(struct module *m, const struct event *e)
 {
 	struct ks *this = (struct ks *)m->priv;
-	float attenuation = clampf(event_get_float(e), 0.f, 1.f);
 
-	LOG_DBG("%s attenuation %f", m->name, attenuation);
-	this->kval[KS_STATE_PLUCKED] = 0.5 * attenuation;
+	ks_param_attenuation(this->attenuation, e);
 }
 
 static void ks_port_frequency(struct module *m, const struct event *e)
@@ -159,7 +212,9 @@ static void ks_port_frequency(struct module *m, const struct event *e)
 
 static void ks_port_note(struct module *m, const struct event *e)
 {
-	ks_set_frequency(m, midi_to_frequency(event_get_float(e)));
+	struct ks *this = (struct ks *)m->priv;
+
+	this->xstep = tuning_step(&m->top->tuning, event_get_float(e));
 }
 
 /******************************************************************************
@@ -169,7 +224,7 @@ static void ks_port_note(struct module *m, const struct event *e)
 static int ks_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct ks *this = ggm_calloc(1, sizeof(struct ks));
+	struct ks *this = synth_calloc(m->top, 1, sizeof(struct ks));
 
 	if (this == NULL) {
 		return -1;
@@ -179,8 +234,14 @@ static int ks_alloc(struct module *m, va_list vargs)
 	/* initialise the random seed */
 	rand_init(0, &this->rand);
 
+	/* the attenuation may be shared with other strings */
+	this->attenuation = param_new(m, "attenuation", 0.5f);
+	if (this->attenuation == NULL) {
+		synth_free(m->top, this);
+		return -1;
+	}
+
 	/* set default attenuation values */
-	this->kval[KS_STATE_PLUCKED] = 0.5f;
 	this->kval[KS_STATE_RELEASE] = 0.8f * 0.5f;
 	this->kval[KS_STATE_RESET] = 0.1f * 0.1f * 0.5f;
 
@@ -191,35 +252,42 @@ static void ks_free(struct module *m)
 {
 	struct ks *this = (struct ks *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool ks_process(struct module *m, float *bufs[])
+static bool ks_process(struct module *m, float *bufs[], size_t n)
 {
 	struct ks *this = (struct ks *)m->priv;
-	float *out = bufs[0];
+	const float *fm = bufs[0];
+	float *out = bufs[1];
 
 	if (this->state == KS_STATE_IDLE) {
 		/* no output */
 		return false;
 	}
 
-	for (int i = 0; i < AudioBufferSize; i++) {
-		uint32_t x0 = this->x >> KS_FRAC_BITS;
-		uint32_t x1 = (x0 + 1) & KS_DELAY_MASK;
-		float y0 = this->delay[x0];
-		float y1 = this->delay[x1];
-		/* interpolate */
-		out[i] = y0 + (y1 - y0) * KS_FRAC_SCALE * (float)(this->x & KS_FRAC_MASK);
-		/* step the x position */
-		this->x += this->xstep;
-		/* filter: once we have moved beyond the delay line index we
-		 * will average it's amplitude with the next value.
-		 */
-		if (x0 != (this->x >> KS_FRAC_BITS)) {
-			float k = this->kval[this->state];
-			this->delay[x0] = k * (y0 + y1);
+	this->kval[KS_STATE_PLUCKED] = this->attenuation->val;
+
+	if (fm == NULL) {
+		for (size_t i = 0; i < n; i++) {
+			uint32_t x = this->x;
+			/* step the x position */
+			this->x += this->xstep;
+			out[i] = ks_sample(this, x, this->x);
+		}
+		return true;
+	}
+
+	/* fm is in Hz */
+	uint32_t phase[KS_BLOCK_SIZE + 1];
+	float kfm = 1.f / (float)m->top->rate;
+	for (size_t ofs = 0; ofs < n; ofs += KS_BLOCK_SIZE) {
+		size_t k = ((n - ofs) < KS_BLOCK_SIZE) ? n - ofs : KS_BLOCK_SIZE;
+		phase[k] = phase_block(phase, this->x, this->xstep, &fm[ofs], kfm, NULL, k);
+		for (size_t i = 0; i < k; i++) {
+			out[ofs + i] = ks_sample(this, phase[i], phase[i + 1]);
 		}
+		this->x = phase[k];
 	}
 
 	return true;
@@ -230,16 +298,12 @@ static bool ks_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = ks_port_reset },
-	{ .name = "gate", .type = PORT_TYPE_FLOAT, .pf = ks_port_gate },
-	{ .name = "note", .type = PORT_TYPE_FLOAT, .pf = ks_port_note },
-	{ .name = "frequency", .type = PORT_TYPE_FLOAT, .pf = ks_port_frequency },
-	{ .name = "attenuation", .type = PORT_TYPE_FLOAT, .pf = ks_port_attenuation, .mf = ks_midi_attenuation, },
+	KS_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	KS_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
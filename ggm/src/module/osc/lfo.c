@@ -10,6 +10,23 @@
 #include "ggm.h"
 #include "osc/osc.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define LFO_IN_PORTS(X)							\
+	X(LFO_IN, rate, .type = PORT_TYPE_FLOAT, .pf = lfo_port_rate)	\
+	X(LFO_IN, depth, .type = PORT_TYPE_FLOAT, .pf = lfo_port_depth)	\
+	X(LFO_IN, shape, .type = PORT_TYPE_INT, .pf = lfo_port_shape)	\
+	X(LFO_IN, sync, .type = PORT_TYPE_BOOL, .pf = lfo_port_sync)
+
+enum { LFO_IN_PORTS(PORT_ID) };
+
+#define LFO_OUT_PORTS(X)	\
+	X(LFO_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { LFO_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -32,7 +49,7 @@ static void lfo_port_rate(struct module *m, const struct event *e)
 	float rate = clampf_lo(event_get_float(e), 0.f);
 
 	LOG_INF("set rate %f Hz", rate);
-	this->xstep = (uint32_t)(rate * FrequencyScale);
+	this->xstep = (uint32_t)(rate * m->top->fscale);
 }
 
 static void lfo_port_depth(struct module *m, const struct event *e)
@@ -69,7 +86,7 @@ static void lfo_port_sync(struct module *m, const struct event *e)
 static int lfo_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct lfo *this = ggm_calloc(1, sizeof(struct lfo));
+	struct lfo *this = synth_calloc(m->top, 1, sizeof(struct lfo));
 
 	if (this == NULL) {
 		return -1;
@@ -81,7 +98,7 @@ static int lfo_alloc(struct module *m, va_list vargs)
 
 static void lfo_free(struct module *m)
 {
-	ggm_free(m->priv);
+	synth_free(m->top, m->priv);
 }
 
 static float lfo_sample(struct module *m)
@@ -131,12 +148,23 @@ static float lfo_sample(struct module *m)
 	return (float)sample / (float)(1 << 24);
 }
 
-static bool lfo_process(struct module *m, float *bufs[])
+static bool lfo_process(struct module *m, float *bufs[], size_t n)
 {
 	struct lfo *this = (struct lfo *)m->priv;
 	float *out = bufs[0];
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	if (this->shape == LFO_SHAPE_SINE) {
+		/* The phase is stepped before each sample. The sine is a
+		 * quarter cycle behind the cosine.
+		 */
+		uint32_t x = this->x + this->xstep - QuarterCycle;
+		x = cos_lookup_block(out, x, this->xstep, n);
+		this->x = x + QuarterCycle - this->xstep;
+		block_mul_k(out, this->depth, n);
+		return true;
+	}
+
+	for (size_t i = 0; i < n; i++) {
 		this->x += this->xstep;
 		out[i] = this->depth * lfo_sample(m);
 	}
@@ -149,15 +177,12 @@ static bool lfo_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "rate", .type = PORT_TYPE_FLOAT, .pf = lfo_port_rate },
-	{ .name = "depth", .type = PORT_TYPE_FLOAT, .pf = lfo_port_depth },
-	{ .name = "shape", .type = PORT_TYPE_INT, .pf = lfo_port_shape },
-	{ .name = "sync", .type = PORT_TYPE_BOOL, .pf = lfo_port_sync },
+	LFO_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	LFO_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
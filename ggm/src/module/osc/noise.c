@@ -18,6 +18,21 @@
 #include "ggm.h"
 #include "osc/osc.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define NOISE_IN_PORTS(X)							\
+	X(NOISE_IN, reset, .type = PORT_TYPE_BOOL, .pf = noise_port_null)	\
+	X(NOISE_IN, frequency, .type = PORT_TYPE_FLOAT, .pf = noise_port_null)
+
+enum { NOISE_IN_PORTS(PORT_ID) };
+
+#define NOISE_OUT_PORTS(X)	\
+	X(NOISE_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { NOISE_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -42,21 +57,21 @@ static void noise_port_null(struct module *m, const struct event *e)
  * noise generating functions
  */
 
-static void generate_white(struct module *m, float *out)
+static void generate_white(struct module *m, float *out, size_t n)
 {
 	struct noise *this = (struct noise *)m->priv;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		out[i] = randf(&this->rand);
 	}
 }
 
-static void generate_brown(struct module *m, float *out)
+static void generate_brown(struct module *m, float *out, size_t n)
 {
 	struct noise *this = (struct noise *)m->priv;
 	float b0 = this->b0;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		float white = randf(&this->rand);
 		b0 = (b0 + (0.02f * white)) * (1.0f / 1.02f);
 		out[i] = b0 * (1.0f / 0.38f);
@@ -64,14 +79,14 @@ static void generate_brown(struct module *m, float *out)
 	this->b0 = b0;
 }
 
-static void generate_pink1(struct module *m, float *out)
+static void generate_pink1(struct module *m, float *out, size_t n)
 {
 	struct noise *this = (struct noise *)m->priv;
 	float b0 = this->b0;
 	float b1 = this->b1;
 	float b2 = this->b2;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		float white = randf(&this->rand);
 		b0 = 0.99765f * b0 + white * 0.0990460f;
 		b1 = 0.96300f * b1 + white * 0.2965164f;
@@ -84,7 +99,7 @@ static void generate_pink1(struct module *m, float *out)
 	this->b2 = b2;
 }
 
-static void generate_pink2(struct module *m, float *out)
+static void generate_pink2(struct module *m, float *out, size_t n)
 {
 	struct noise *this = (struct noise *)m->priv;
 	float b0 = this->b0;
@@ -95,7 +110,7 @@ static void generate_pink2(struct module *m, float *out)
 	float b5 = this->b5;
 	float b6 = this->b6;
 
-	for (int i = 0; i < AudioBufferSize; i++) {
+	for (size_t i = 0; i < n; i++) {
 		float white = randf(&this->rand);
 		b0 = 0.99886f * b0 + white * 0.0555179f;
 		b1 = 0.99332f * b1 + white * 0.0750759f;
@@ -123,7 +138,7 @@ static void generate_pink2(struct module *m, float *out)
 static int noise_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct noise *this = ggm_calloc(1, sizeof(struct noise));
+	struct noise *this = synth_calloc(m->top, 1, sizeof(struct noise));
 
 	if (this == NULL) {
 		return -1;
@@ -143,7 +158,7 @@ static int noise_alloc(struct module *m, va_list vargs)
 	return 0;
 
 error:
-	ggm_free(this);
+	synth_free(m->top, this);
 	return -1;
 }
 
@@ -151,26 +166,26 @@ static void noise_free(struct module *m)
 {
 	struct noise *this = (struct noise *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool noise_process(struct module *m, float *bufs[])
+static bool noise_process(struct module *m, float *bufs[], size_t n)
 {
 	struct noise *this = (struct noise *)m->priv;
 	float *out = bufs[0];
 
 	switch (this->type) {
 	case NOISE_TYPE_PINK1:
-		generate_pink1(m, out);
+		generate_pink1(m, out, n);
 		break;
 	case NOISE_TYPE_PINK2:
-		generate_pink2(m, out);
+		generate_pink2(m, out, n);
 		break;
 	case NOISE_TYPE_WHITE:
-		generate_white(m, out);
+		generate_white(m, out, n);
 		break;
 	case NOISE_TYPE_BROWN:
-		generate_brown(m, out);
+		generate_brown(m, out, n);
 		break;
 	default:
 		LOG_ERR("bad noise type %d", this->type);
@@ -184,13 +199,12 @@ static bool noise_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = noise_port_null },
-	{ .name = "frequency", .type = PORT_TYPE_FLOAT, .pf = noise_port_null },
+	NOISE_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	NOISE_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -35,6 +35,32 @@ enum {
 	NOISE_TYPE_MAX          /* must be last */
 };
 
+/******************************************************************************
+ * goom wave shape (osc/goom and midi/bank)
+ */
+
+struct goom_shape {
+	float tp;               /* s0f0 to s1f1 transition point */
+	float k0;               /* scaling factor for slope 0 */
+	float k1;               /* scaling factor for slope 1 */
+	uint32_t xreset;        /* phase value for zero output */
+};
+
+/* goom_shape_set sets the wave shape constants for the duty cycle and slope (0..1) */
+static inline void goom_shape_set(struct goom_shape *gs, float duty, float slope)
+{
+	/* update duty cycle */
+	gs->tp = (uint32_t)((float)FullCycle * map_lin(duty, 0.05f, 0.5f));
+	/* Work out the portion of s0f0/s1f1 that is sloped. */
+	slope = map_lin(slope, 0.1f, 1.f);
+	/* scaling constant for s0, map the slope to the LUT. */
+	gs->k0 = 1.f / ((float)(gs->tp) * slope);
+	/* scaling constant for s1, map the slope to the LUT. */
+	gs->k1 = 1.f / ((float)(FullCycle - 1 - gs->tp) * slope);
+	/* this phase reset value gives zero output */
+	gs->xreset = (uint32_t)((float)(gs->tp) * slope * 0.5f);
+}
+
 /*****************************************************************************/
 
 #endif /* GGM_SRC_MODULE_OSC_OSC_H */
@@ -6,12 +6,31 @@
 
 #include "ggm.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define SINE_IN_PORTS(X)								\
+	X(SINE_IN, reset, .type = PORT_TYPE_BOOL, .pf = sine_port_reset)		\
+	X(SINE_IN, frequency, .type = PORT_TYPE_FLOAT, .pf = sine_port_frequency)	\
+	X(SINE_IN, note, .type = PORT_TYPE_FLOAT, .pf = sine_port_note)			\
+	X(SINE_IN, fm, .type = PORT_TYPE_AUDIO)						\
+	X(SINE_IN, pm, .type = PORT_TYPE_AUDIO)
+
+enum { SINE_IN_PORTS(PORT_ID) };
+
+#define SINE_OUT_PORTS(X)	\
+	X(SINE_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { SINE_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
 
+#define SINE_BLOCK_SIZE 64 /* phase values generated per pass */
+
 struct sine {
-	float freq;             /* base frequency */
 	uint32_t x;             /* current x-value */
 	uint32_t xstep;         /* current x-step */
 };
@@ -25,8 +44,7 @@ static void sine_set_frequency(struct module *m, float freq)
 	struct sine *this = (struct sine *)m->priv;
 
 	LOG_DBG("%s set frequency %f Hz", m->name, freq);
-	this->freq = freq;
-	this->xstep = (uint32_t)(freq * FrequencyScale);
+	this->xstep = (uint32_t)(freq * m->top->fscale);
 }
 
 /******************************************************************************
@@ -57,9 +75,9 @@ static void sine_port_frequency(struct module *m, const struct event *e)
 /* sine_port_note is the pitch bent MIDI note (float) used to set frequency */
 static void sine_port_note(struct module *m, const struct event *e)
 {
-	float freq = midi_to_frequency(event_get_float(e));
+	struct sine *this = (struct sine *)m->priv;
 
-	sine_set_frequency(m, freq);
+	this->xstep = tuning_step(&m->top->tuning, event_get_float(e));
 }
 
 /******************************************************************************
@@ -69,7 +87,7 @@ static void sine_port_note(struct module *m, const struct event *e)
 static int sine_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct sine *this = ggm_calloc(1, sizeof(struct sine));
+	struct sine *this = synth_calloc(m->top, 1, sizeof(struct sine));
 
 	if (this == NULL) {
 		return -1;
@@ -84,19 +102,30 @@ static int sine_alloc(struct module *m, va_list vargs)
 
 static void sine_free(struct module *m)
 {
-	ggm_free(m->priv);
+	synth_free(m->top, m->priv);
 }
 
-static bool sine_process(struct module *m, float *buf[])
+static bool sine_process(struct module *m, float *buf[], size_t n)
 {
 	struct sine *this = (struct sine *)m->priv;
-	float *out = buf[0];
+	const float *fm = buf[0];
+	const float *pm = buf[1];
+	float *out = buf[2];
+
+	if (fm == NULL && pm == NULL) {
+		this->x = cos_lookup_block(out, this->x, this->xstep, n);
+		return true;
+	}
 
-	for (int i = 0; i < AudioBufferSize; i++) {
-		out[i] = cos_lookup(this->x);
-		this->x += this->xstep;
-		// fm: this->x += (uint32_t)((this->freq + fm[i]) * FrequencyScale);
-		// pm: this->x += (uint32_t)((float)this->xstep + (pm[i] * PhaseScale));
+	/* fm is in Hz, pm is in radians */
+	uint32_t phase[SINE_BLOCK_SIZE];
+	float kfm = 1.f / (float)m->top->rate;
+	for (size_t i = 0; i < n; i += SINE_BLOCK_SIZE) {
+		size_t k = ((n - i) < SINE_BLOCK_SIZE) ? n - i : SINE_BLOCK_SIZE;
+		const float *fmk = (fm != NULL) ? &fm[i] : NULL;
+		const float *pmk = (pm != NULL) ? &pm[i] : NULL;
+		this->x = phase_block(phase, this->x, this->xstep, fmk, kfm, pmk, k);
+		cos_lookup_buf(&out[i], phase, k);
 	}
 	return true;
 }
@@ -106,14 +135,12 @@ static bool sine_process(struct module *m, float *buf[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = sine_port_reset },
-	{ .name = "frequency", .type = PORT_TYPE_FLOAT, .pf = sine_port_frequency },
-	{ .name = "note", .type = PORT_TYPE_FLOAT, .pf = sine_port_note },
+	SINE_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	SINE_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
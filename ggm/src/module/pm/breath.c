@@ -9,6 +9,27 @@
 #include "ggm.h"
 #include "osc/osc.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define BREATH_IN_PORTS(X)								\
+	X(BREATH_IN, reset, .type = PORT_TYPE_BOOL, .pf = breath_port_reset)		\
+	X(BREATH_IN, gate, .type = PORT_TYPE_FLOAT, .pf = breath_port_gate)		\
+	X(BREATH_IN, attack, .type = PORT_TYPE_FLOAT, .pf = breath_port_attack)		\
+	X(BREATH_IN, decay, .type = PORT_TYPE_FLOAT, .pf = breath_port_decay)		\
+	X(BREATH_IN, sustain, .type = PORT_TYPE_FLOAT, .pf = breath_port_sustain)	\
+	X(BREATH_IN, release, .type = PORT_TYPE_FLOAT, .pf = breath_port_release)	\
+	X(BREATH_IN, kn, .type = PORT_TYPE_FLOAT, .pf = breath_port_kn)			\
+	X(BREATH_IN, ka, .type = PORT_TYPE_FLOAT, .pf = breath_port_ka)
+
+enum { BREATH_IN_PORTS(PORT_ID) };
+
+#define BREATH_OUT_PORTS(X)	\
+	X(BREATH_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { BREATH_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -16,6 +37,12 @@
 struct breath {
 	struct module *noise;   /* noise module */
 	struct module *adsr;    /* adsr module */
+	struct port_hdl reset;  /* adsr ports */
+	struct port_hdl gate;
+	struct port_hdl attack;
+	struct port_hdl decay;
+	struct port_hdl sustain;
+	struct port_hdl release;
 	float kn;               /* noise scale */
 	float ka;               /* amplitude scale */
 	float kd;               /* derived scale */
@@ -43,7 +70,7 @@ static void breath_port_reset(struct module *m, const struct event *e)
 {
 	struct breath *this = (struct breath *)m->priv;
 
-	event_in(this->adsr, "reset", e, NULL);
+	event_in_hdl(&this->reset, e);
 }
 
 /* breath_port_gate is the envelope gate control, attack(>0) or release(=0) */
@@ -51,7 +78,7 @@ static void breath_port_gate(struct module *m, const struct event *e)
 {
 	struct breath *this = (struct breath *)m->priv;
 
-	event_in(this->adsr, "gate", e, NULL);
+	event_in_hdl(&this->gate, e);
 }
 
 /* breath_port_attack sets the attack time (secs) */
@@ -59,7 +86,7 @@ static void breath_port_attack(struct module *m, const struct event *e)
 {
 	struct breath *this = (struct breath *)m->priv;
 
-	event_in(this->adsr, "attack", e, NULL);
+	event_in_hdl(&this->attack, e);
 }
 
 /* breath_port_decay sets the decay time (secs) */
@@ -67,7 +94,7 @@ static void breath_port_decay(struct module *m, const struct event *e)
 {
 	struct breath *this = (struct breath *)m->priv;
 
-	event_in(this->adsr, "decay", e, NULL);
+	event_in_hdl(&this->decay, e);
 }
 
 /* breath_port_sustain sets the sustain level 0..1 */
@@ -75,7 +102,7 @@ static void breath_port_sustain(struct module *m, const struct event *e)
 {
 	struct breath *this = (struct breath *)m->priv;
 
-	event_in(this->adsr, "sustain", e, NULL);
+	event_in_hdl(&this->sustain, e);
 }
 
 /* breath_port_release sets the release time (secs) */
@@ -83,7 +110,7 @@ static void breath_port_release(struct module *m, const struct event *e)
 {
 	struct breath *this = (struct breath *)m->priv;
 
-	event_in(this->adsr, "release", e, NULL);
+	event_in_hdl(&this->release, e);
 }
 
 /* breath_port_kn sets the scale for the breath noise */
@@ -116,7 +143,7 @@ static int breath_alloc(struct module *m, va_list vargs)
 	struct module *adsr = NULL;
 
 	/* allocate the private data */
-	struct breath *this = ggm_calloc(1, sizeof(struct breath));
+	struct breath *this = synth_calloc(m->top, 1, sizeof(struct breath));
 
 	if (this == NULL) {
 		return -1;
@@ -138,18 +165,24 @@ static int breath_alloc(struct module *m, va_list vargs)
 	if (adsr == NULL) {
 		goto error;
 	}
-	event_in_float(adsr, "attack", 0.1f, NULL);
-	event_in_float(adsr, "decay", 0.5f, NULL);
-	event_in_float(adsr, "sustain", 0.85f, NULL);
-	event_in_float(adsr, "release", 1.f, NULL);
 	this->adsr = adsr;
+	port_get_hdl(&this->reset, adsr, "reset");
+	port_get_hdl(&this->gate, adsr, "gate");
+	port_get_hdl(&this->attack, adsr, "attack");
+	port_get_hdl(&this->decay, adsr, "decay");
+	port_get_hdl(&this->sustain, adsr, "sustain");
+	port_get_hdl(&this->release, adsr, "release");
+	event_in_hdl_float(&this->attack, 0.1f);
+	event_in_hdl_float(&this->decay, 0.5f);
+	event_in_hdl_float(&this->sustain, 0.85f);
+	event_in_hdl_float(&this->release, 1.f);
 
 	return 0;
 
 error:
 	module_del(noise);
 	module_del(adsr);
-	ggm_free(m->priv);
+	synth_free(m->top, m->priv);
 	return -1;
 }
 
@@ -159,27 +192,29 @@ static void breath_free(struct module *m)
 
 	module_del(this->noise);
 	module_del(this->adsr);
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool breath_process(struct module *m, float *bufs[])
+/* breath_mix mixes the noise with the envelope */
+static bool breath_mix(struct module *m, float *bufs[], size_t n)
 {
 	struct breath *this = (struct breath *)m->priv;
-	struct module *adsr = this->adsr;
-	float env[AudioBufferSize];
-	bool active = adsr->info->process(adsr, (float *[]){ env, });
-
-	if (active) {
-		struct module *noise = this->noise;
-		float *out = bufs[0];
-		/* out = ((noise * env * kn) + env) * kd */
-		noise->info->process(noise, (float *[]){ out, });
-		block_mul(out, env);
-		block_mul_k(out, this->kn);
-		block_add(out, env);
-		block_mul_k(out, this->kd);
-	}
 
+	/* out = ((noise * env * kn) + env) * kd */
+	block_mul_k_add(bufs[0], bufs[1], this->kn * this->kd, this->kd, n);
+	return true;
+}
+
+static int breath_compile(struct module *m, struct plan *p, const int *bufs, int cond)
+{
+	struct breath *this = (struct breath *)m->priv;
+	int out = bufs[0];
+	int env = plan_buf(p);
+
+	/* the noise only runs when the envelope is active */
+	int active = plan_module(p, this->adsr, (int[]){ env, }, cond);
+	plan_module(p, this->noise, (int[]){ out, }, active);
+	plan_step(p, breath_mix, m, (int[]){ out, env, }, 2, active);
 	return active;
 }
 
@@ -188,19 +223,12 @@ static bool breath_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = breath_port_reset },
-	{ .name = "gate", .type = PORT_TYPE_FLOAT, .pf = breath_port_gate },
-	{ .name = "attack", .type = PORT_TYPE_FLOAT, .pf = breath_port_attack },
-	{ .name = "decay", .type = PORT_TYPE_FLOAT, .pf = breath_port_decay },
-	{ .name = "sustain", .type = PORT_TYPE_FLOAT, .pf = breath_port_sustain },
-	{ .name = "release", .type = PORT_TYPE_FLOAT, .pf = breath_port_release },
-	{ .name = "kn", .type = PORT_TYPE_FLOAT, .pf = breath_port_kn },
-	{ .name = "ka", .type = PORT_TYPE_FLOAT, .pf = breath_port_ka },
+	BREATH_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	BREATH_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -211,7 +239,7 @@ const struct module_info pm_breath_module = {
 	.out = out_ports,
 	.alloc = breath_alloc,
 	.free = breath_free,
-	.process = breath_process,
+	.compile = breath_compile,
 };
 
 MODULE_REGISTER(pm_breath_module);
@@ -9,6 +9,22 @@
 #include "ggm.h"
 #include "seq/seq.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define ROOT_IN_PORTS(X)	\
+	X(ROOT_IN, midi, .type = PORT_TYPE_MIDI, .pf = metro_port_midi)
+
+enum { ROOT_IN_PORTS(PORT_ID) };
+
+#define ROOT_OUT_PORTS(X)				\
+	X(ROOT_OUT, midi, .type = PORT_TYPE_MIDI)	\
+	X(ROOT_OUT, out0, .type = PORT_TYPE_AUDIO)	\
+	X(ROOT_OUT, out1, .type = PORT_TYPE_AUDIO)
+
+enum { ROOT_OUT_PORTS(PORT_ID) };
+
 
 /******************************************************************************
  * MIDI setup
@@ -90,7 +106,7 @@ static int metro_alloc(struct module *m, va_list vargs)
 	struct module *pan = NULL;
 
 	/* allocate the private data */
-	struct metro *this = ggm_calloc(1, sizeof(struct metro));
+	struct metro *this = synth_calloc(m->top, 1, sizeof(struct metro));
 
 	if (this == NULL) {
 		return -1;
@@ -138,7 +154,7 @@ error:
 	module_del(seq);
 	module_del(mono);
 	module_del(pan);
-	ggm_free(this);
+	synth_free(m->top, this);
 	return -1;
 }
 
@@ -149,26 +165,18 @@ static void metro_free(struct module *m)
 	module_del(this->seq);
 	module_del(this->mono);
 	module_del(this->pan);
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool metro_process(struct module *m, float *bufs[])
+static int metro_compile(struct module *m, struct plan *p, const int *bufs, int cond)
 {
 	struct metro *this = (struct metro *)m->priv;
-	struct module *seq = this->seq;
-	struct module *mono = this->mono;
-	float tmp[AudioBufferSize];
-
-	seq->info->process(seq, NULL);
-
-	bool active = mono->info->process(mono, (float *[]){ tmp, });
-	if (active) {
-		struct module *pan = this->pan;
-		float *out0 = bufs[0];
-		float *out1 = bufs[1];
-		pan->info->process(pan, (float *[]){ tmp, out0, out1, });
-	}
+	int tmp = plan_buf(p);
 
+	plan_module(p, this->seq, NULL, cond);
+	/* the pan only runs when the voice is active */
+	int active = plan_module(p, this->mono, (int[]){ tmp, }, cond);
+	plan_module(p, this->pan, (int[]){ tmp, bufs[0], bufs[1], }, active);
 	return active;
 }
 
@@ -177,14 +185,12 @@ static bool metro_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "midi", .type = PORT_TYPE_MIDI, .pf = metro_port_midi },
+	ROOT_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "midi", .type = PORT_TYPE_MIDI, },
-	{ .name = "out0", .type = PORT_TYPE_AUDIO },
-	{ .name = "out1", .type = PORT_TYPE_AUDIO },
+	ROOT_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -195,7 +201,7 @@ const struct module_info root_metro_module = {
 	.out = out_ports,
 	.alloc = metro_alloc,
 	.free = metro_free,
-	.process = metro_process,
+	.compile = metro_compile,
 };
 
 MODULE_REGISTER(root_metro_module);
@@ -6,12 +6,29 @@
 
 #include "ggm.h"
 #include "osc/osc.h"
+#include "midi/midi.h"
+
+/******************************************************************************
+ * ports
+ */
+
+#define ROOT_IN_PORTS(X)	\
+	X(ROOT_IN, midi, .type = PORT_TYPE_MIDI, .pf = poly_port_midi, .bf = poly_batch_midi)
+
+enum { ROOT_IN_PORTS(PORT_ID) };
+
+#define ROOT_OUT_PORTS(X)				\
+	X(ROOT_OUT, out0, .type = PORT_TYPE_AUDIO)	\
+	X(ROOT_OUT, out1, .type = PORT_TYPE_AUDIO)
+
+enum { ROOT_OUT_PORTS(PORT_ID) };
 
 /******************************************************************************
  * MIDI setup
  */
 
 #define MIDI_CH 0
+#define NUM_VOICES 5 /* 4 active + 1 in soft reset */
 
 #define SYNTH_SIMPLE_GOOM
 
@@ -83,6 +100,34 @@ static struct module *poly_voice(struct module *m, int id)
 	return module_new(m, "voice/osc", id, voice_osc);
 }
 
+/******************************************************************************
+ * polyphonic synth with envelope on goom wave oscillator (voice bank)
+ */
+
+#elif defined(SYNTH_BANK_GOOM)
+
+static const struct synth_cfg cfg[] = {
+	{ "root.bank:attack",
+	  &(struct port_float_cfg){ .init = 0.2f, .id = MIDI_ID(MIDI_CH, 1), }, },
+	{ "root.bank:decay",
+	  &(struct port_float_cfg){ .init = 0.1f, .id = MIDI_ID(MIDI_CH, 2), }, },
+	{ "root.bank:sustain",
+	  &(struct port_float_cfg){ .init = 0.3f, .id = MIDI_ID(MIDI_CH, 3), }, },
+	{ "root.bank:release",
+	  &(struct port_float_cfg){ .init = 0.3f, .id = MIDI_ID(MIDI_CH, 4), }, },
+	{ "root.bank:duty",
+	  &(struct port_float_cfg){ .init = 0.5f, .id = MIDI_ID(MIDI_CH, 5), }, },
+	{ "root.bank:slope",
+	  &(struct port_float_cfg){ .init = 0.5f, .id = MIDI_ID(MIDI_CH, 6), }, },
+	{ "root.pan:pan",
+	  &(struct port_float_cfg){ .init = 0.5f, .id = MIDI_ID(MIDI_CH, 7), }, },
+	{ "root.pan:vol",
+	  &(struct port_float_cfg){ .init = 0.8f, .id = MIDI_ID(MIDI_CH, 8), }, },
+	SYNTH_CFG_EOL
+};
+
+#define POLY_BANK BANK_VOICE_OSC_GOOM
+
 /******************************************************************************
  * polyphonic synth with karplus-strong voices
  */
@@ -114,6 +159,7 @@ static struct module *poly_voice(struct module *m, int id)
 
 struct poly {
 	struct module *poly;    /* polyphonic control */
+	struct port_hdl midi;   /* polyphonic control MIDI port */
 	struct module *pan;     /* ouput left/right panning */
 };
 
@@ -134,7 +180,17 @@ static void poly_port_midi(struct module *m, const struct event *e)
 	char tmp[64];
 	LOG_DBG("%s", log_strdup(midi_str(tmp, sizeof(tmp), e)));
 	/* forward the MIDI events */
-	event_in(this->poly, "midi", e, NULL);
+	event_in_hdl(&this->midi, e);
+}
+
+static void poly_batch_midi(struct module *m, const struct event_batch *b)
+{
+	struct poly *this = (struct poly *)m->priv;
+	struct event_batch rest;
+
+	/* dispatch the events in the synth level midi cc map, forward the rest */
+	synth_midi_cc_batch(m->top, b, &rest);
+	event_in_batch(&this->midi, &rest);
 }
 
 /******************************************************************************
@@ -147,7 +203,7 @@ static int poly_alloc(struct module *m, va_list vargs)
 	struct module *pan = NULL;
 
 	/* allocate the private data */
-	struct poly *this = ggm_calloc(1, sizeof(struct poly));
+	struct poly *this = synth_calloc(m->top, 1, sizeof(struct poly));
 
 	if (this == NULL) {
 		return -1;
@@ -161,11 +217,16 @@ static int poly_alloc(struct module *m, va_list vargs)
 	}
 
 	/* polyphony */
-	poly = module_new(m, "midi/poly", -1, MIDI_CH, poly_voice);
+#if defined(POLY_BANK)
+	poly = module_new(m, "midi/bank", -1, MIDI_CH, POLY_BANK, NUM_VOICES);
+#else
+	poly = module_new(m, "midi/poly", -1, MIDI_CH, poly_voice, NUM_VOICES);
+#endif
 	if (poly == NULL) {
 		goto error;
 	}
 	this->poly = poly;
+	port_get_hdl(&this->midi, poly, "midi");
 
 	/* pan */
 	pan = module_new(m, "mix/pan", -1);
@@ -179,7 +240,7 @@ static int poly_alloc(struct module *m, va_list vargs)
 error:
 	module_del(poly);
 	module_del(pan);
-	ggm_free(this);
+	synth_free(m->top, this);
 	return -1;
 }
 
@@ -189,21 +250,16 @@ static void poly_free(struct module *m)
 
 	module_del(this->poly);
 	module_del(this->pan);
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool poly_process(struct module *m, float *bufs[])
+static int poly_compile(struct module *m, struct plan *p, const int *bufs, int cond)
 {
 	struct poly *this = (struct poly *)m->priv;
-	struct module *poly = this->poly;
-	struct module *pan = this->pan;
-	float *out0 = bufs[0];
-	float *out1 = bufs[1];
-	float tmp[AudioBufferSize];
-
-	poly->info->process(poly, (float *[]){ tmp, });
-	pan->info->process(pan, (float *[]){ tmp, out0, out1, });
-	return true;
+	int tmp = plan_buf(p);
+
+	plan_module(p, this->poly, (int[]){ tmp, }, cond);
+	return plan_module(p, this->pan, (int[]){ tmp, bufs[0], bufs[1], }, cond);
 }
 
 /******************************************************************************
@@ -211,13 +267,12 @@ static bool poly_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "midi", .type = PORT_TYPE_MIDI, .pf = poly_port_midi },
+	ROOT_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out0", .type = PORT_TYPE_AUDIO },
-	{ .name = "out1", .type = PORT_TYPE_AUDIO },
+	ROOT_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -228,7 +283,7 @@ const struct module_info root_poly_module = {
 	.out = out_ports,
 	.alloc = poly_alloc,
 	.free = poly_free,
-	.process = poly_process,
+	.compile = poly_compile,
 };
 
 MODULE_REGISTER(root_poly_module);
@@ -7,6 +7,21 @@
 #include "ggm.h"
 #include "seq/seq.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define SEQ_IN_PORTS(X)									\
+	X(SEQ_IN, bpm, .type = PORT_TYPE_FLOAT, .pf = seq_port_bpm, .mf = seq_midi_bpm)	\
+	X(SEQ_IN, ctrl, .type = PORT_TYPE_INT, .pf = seq_port_ctrl)
+
+enum { SEQ_IN_PORTS(PORT_ID) };
+
+#define SEQ_OUT_PORTS(X)	\
+	X(SEQ_OUT, midi, .type = PORT_TYPE_MIDI)
+
+enum { SEQ_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -83,7 +98,7 @@ static int op_note(struct module *m)
 		LOG_INF("note on %d (%d)", args->note, this->ticks);
 		struct event e;
 		event_set_midi_note(&e, MIDI_STATUS_NOTEON, args->chan, args->note, args->vel);
-		event_push_name(m, "midi", &e);
+		event_push(m, SEQ_OUT_midi, &e);
 	}
 	sm->duration -= 1;
 	if (sm->duration == 0) {
@@ -92,7 +107,7 @@ static int op_note(struct module *m)
 		LOG_INF("note off (%d)", this->ticks);
 		struct event e;
 		event_set_midi_note(&e, MIDI_STATUS_NOTEOFF, args->chan, args->note, 0);
-		event_push_name(m, "midi", &e);
+		event_push(m, SEQ_OUT_midi, &e);
 		return sizeof(struct note_args);
 	}
 	/* waiting... */
@@ -198,7 +213,7 @@ static void seq_port_ctrl(struct module *m, const struct event *e)
 static int seq_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct seq *this = ggm_calloc(1, sizeof(struct seq));
+	struct seq *this = synth_calloc(m->top, 1, sizeof(struct seq));
 
 	if (this == NULL) {
 		LOG_ERR("could not allocate private data");
@@ -214,10 +229,10 @@ static int seq_alloc(struct module *m, va_list vargs)
 
 static void seq_free(struct module *m)
 {
-	ggm_free(m->priv);
+	synth_free(m->top, m->priv);
 }
 
-static bool seq_process(struct module *m, float *buf[])
+static bool seq_process(struct module *m, float *buf[], size_t n)
 {
 	struct seq *this = (struct seq *)m->priv;
 
@@ -228,7 +243,7 @@ static bool seq_process(struct module *m, float *buf[])
 	 * ie- Bresenham style.
 	 */
 
-	this->tick_error += SecsPerAudioBuffer;
+	this->tick_error += (float)n * m->top->period;
 	if (this->tick_error > this->secs_per_tick) {
 		this->tick_error -= this->secs_per_tick;
 		this->ticks++;
@@ -243,13 +258,12 @@ static bool seq_process(struct module *m, float *buf[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "bpm", .type = PORT_TYPE_FLOAT, .pf = seq_port_bpm, .mf = seq_midi_bpm, },
-	{ .name = "ctrl", .type = PORT_TYPE_INT, .pf = seq_port_ctrl },
+	SEQ_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "midi", .type = PORT_TYPE_MIDI, },
+	SEQ_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -9,6 +9,21 @@
 #include "ggm.h"
 #include "seq/seq.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define SMF_IN_PORTS(X)									\
+	X(SMF_IN, bpm, .type = PORT_TYPE_FLOAT, .pf = smf_port_bpm, .mf = smf_midi_bpm)	\
+	X(SMF_IN, ctrl, .type = PORT_TYPE_INT, .pf = smf_port_ctrl)
+
+enum { SMF_IN_PORTS(PORT_ID) };
+
+#define SMF_OUT_PORTS(X)	\
+	X(SMF_OUT, midi, .type = PORT_TYPE_MIDI)
+
+enum { SMF_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -74,7 +89,7 @@ static void smf_port_ctrl(struct module *m, const struct event *e)
 static int smf_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct smf *this = ggm_calloc(1, sizeof(struct smf));
+	struct smf *this = synth_calloc(m->top, 1, sizeof(struct smf));
 
 	if (this == NULL) {
 		return -1;
@@ -88,16 +103,14 @@ static void smf_free(struct module *m)
 {
 	struct smf *this = (struct smf *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool smf_process(struct module *m, float *bufs[])
+static bool smf_process(struct module *m, float *bufs[], size_t n)
 {
 	struct smf *this = (struct smf *)m->priv;
-	float *out = bufs[0];
 
 	(void)this;
-	(void)out;
 
 	return true;
 }
@@ -107,13 +120,12 @@ static bool smf_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "bpm", .type = PORT_TYPE_FLOAT, .pf = smf_port_bpm, .mf = smf_midi_bpm, },
-	{ .name = "ctrl", .type = PORT_TYPE_INT, .pf = smf_port_ctrl },
+	SMF_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "midi", .type = PORT_TYPE_MIDI, },
+	SMF_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -6,6 +6,20 @@
 
 #include "ggm.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define XMOD_IN_PORTS(X)	\
+	X(XMOD_IN, name, .type = PORT_TYPE_FLOAT, .pf = xmod_port_name)
+
+enum { XMOD_IN_PORTS(PORT_ID) };
+
+#define XMOD_OUT_PORTS(X)	\
+	X(XMOD_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { XMOD_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -28,7 +42,7 @@ static void xmod_port_name(struct module *m, const struct event *e)
 static int xmod_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct xmod *this = ggm_calloc(1, sizeof(struct xmod));
+	struct xmod *this = synth_calloc(m->top, 1, sizeof(struct xmod));
 
 	if (this == NULL) {
 		return -1;
@@ -42,10 +56,10 @@ static void xmod_free(struct module *m)
 {
 	struct xmod *this = (struct xmod *)m->priv;
 
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool xmod_process(struct module *m, float *bufs[])
+static bool xmod_process(struct module *m, float *bufs[], size_t n)
 {
 	struct xmod *this = (struct xmod *)m->priv;
 	float *out = bufs[0];
@@ -61,12 +75,12 @@ static bool xmod_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "name", .type = PORT_TYPE_FLOAT, .pf = xmod_port_name },
+	XMOD_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	XMOD_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -16,6 +16,17 @@
 #error "Sorry, this module only works with Linux."
 #endif
 
+/******************************************************************************
+ * ports
+ */
+
+#define PLOT_IN_PORTS(X)			\
+	X(PLOT_IN, x, .type = PORT_TYPE_AUDIO)	\
+	X(PLOT_IN, y0, .type = PORT_TYPE_AUDIO)	\
+	X(PLOT_IN, trigger, .type = PORT_TYPE_BOOL, .pf = plot_port_trigger)
+
+enum { PLOT_IN_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -39,7 +50,7 @@ static struct plot_cfg default_cfg = {
 	.title = "Plot",
 	.x_name = "time",
 	.y0_name = "amplitude",
-	.duration = 30.f * SecsPerAudioBuffer,
+	.duration = 0.08f, /* secs */
 };
 
 static void plot_set_config(struct module *m, struct plot_cfg *cfg)
@@ -217,7 +228,7 @@ static void plot_port_trigger(struct module *m, const struct event *e)
 static int plot_alloc(struct module *m, va_list vargs)
 {
 	/* allocate the private data */
-	struct plot *this = ggm_calloc(1, sizeof(struct plot));
+	struct plot *this = synth_calloc(m->top, 1, sizeof(struct plot));
 
 	if (this == NULL) {
 		return -1;
@@ -231,9 +242,9 @@ static int plot_alloc(struct module *m, va_list vargs)
 	/* set the sampling duration */
 	if (this->cfg->duration <= 0) {
 		/* get N buffers of samples */
-		this->samples = 4 * AudioBufferSize;
+		this->samples = 4 * m->top->bufsize;
 	} else {
-		this->samples = maxi(16, (int)(this->cfg->duration / AudioSamplePeriod));
+		this->samples = maxi(16, (int)(this->cfg->duration * (float)m->top->rate));
 	}
 
 	return 0;
@@ -246,10 +257,10 @@ static void plot_free(struct module *m)
 	if (this->triggered) {
 		plot_close(m);
 	}
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool plot_process(struct module *m, float *bufs[])
+static bool plot_process(struct module *m, float *bufs[], size_t n)
 {
 	struct plot *this = (struct plot *)m->priv;
 
@@ -258,27 +269,27 @@ static bool plot_process(struct module *m, float *bufs[])
 		float *y0 = bufs[1];
 
 		/* how many samples should we plot? */
-		int n = mini(this->samples_left, AudioBufferSize);
+		int k = mini(this->samples_left, n);
 
 		/* plot x */
 		if (x != NULL) {
-			plot_append(m, "x", x, n);
+			plot_append(m, "x", x, k);
 		} else {
 			/* no x data - use the internal timebase */
-			float time[n];
-			float base = (float)this->x * AudioSamplePeriod;
-			for (int i = 0; i < n; i++) {
+			float time[k];
+			float base = (float)this->x * m->top->period;
+			for (int i = 0; i < k; i++) {
 				time[i] = base;
-				base += AudioSamplePeriod;
+				base += m->top->period;
 			}
-			plot_append(m, "x", time, n);
+			plot_append(m, "x", time, k);
 		}
 
 		/* plot y */
 		if (y0 != NULL) {
-			plot_append(m, "y0", y0, n);
+			plot_append(m, "y0", y0, k);
 		}
-		this->samples_left -= n;
+		this->samples_left -= k;
 		/* are we done? */
 		if (this->samples_left == 0) {
 			plot_close(m);
@@ -287,7 +298,7 @@ static bool plot_process(struct module *m, float *bufs[])
 	}
 
 	/* increment the internal time base */
-	this->x += AudioBufferSize;
+	this->x += n;
 	return false;
 }
 
@@ -296,9 +307,7 @@ static bool plot_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "x", .type = PORT_TYPE_AUDIO },
-	{ .name = "y0", .type = PORT_TYPE_AUDIO },
-	{ .name = "trigger", .type = PORT_TYPE_BOOL, .pf = plot_port_trigger },
+	PLOT_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
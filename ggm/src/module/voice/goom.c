@@ -5,6 +5,23 @@
  */
 
 #include "ggm.h"
+#include "filter/filter.h"
+
+/******************************************************************************
+ * ports
+ */
+
+#define GOOM_IN_PORTS(X)							\
+	X(GOOM_IN, reset, .type = PORT_TYPE_BOOL, .pf = goom_port_reset)	\
+	X(GOOM_IN, gate, .type = PORT_TYPE_FLOAT, .pf = goom_port_gate)		\
+	X(GOOM_IN, note, .type = PORT_TYPE_FLOAT, .pf = goom_port_note)
+
+enum { GOOM_IN_PORTS(PORT_ID) };
+
+#define GOOM_OUT_PORTS(X)	\
+	X(GOOM_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { GOOM_OUT_PORTS(PORT_ID) };
 
 /******************************************************************************
  * private state
@@ -15,6 +32,11 @@ struct goom {
 	struct module *lpf_env; /* low pass filter adsr envelope */
 	struct module *osc;     /* goom oscillator */
 	struct module *lpf;     /* low pass filter */
+	struct port_hdl amp_reset;      /* amplitude envelope reset port */
+	struct port_hdl amp_gate;       /* amplitude envelope gate port */
+	struct port_hdl lpf_gate;       /* filter envelope gate port */
+	struct port_hdl osc_reset;      /* oscillator reset port */
+	struct port_hdl osc_note;       /* oscillator note port */
 	float vel;              /* note velocity */
 };
 
@@ -28,8 +50,8 @@ static void goom_port_reset(struct module *m, const struct event *e)
 	struct goom *this = (struct goom *)m->priv;
 
 	/* forward the reset to the sub-modules */
-	event_in(this->amp_env, "reset", e, NULL);
-	event_in(this->osc, "reset", e, NULL);
+	event_in_hdl(&this->amp_reset, e);
+	event_in_hdl(&this->osc_reset, e);
 }
 
 /* goom_port_gate is the voice gate event */
@@ -38,8 +60,8 @@ static void goom_port_gate(struct module *m, const struct event *e)
 	struct goom *this = (struct goom *)m->priv;
 
 	/* gate the envelopes */
-	event_in(this->amp_env, "gate", e, NULL);
-	event_in(this->lpf_env, "gate", e, NULL);
+	event_in_hdl(&this->amp_gate, e);
+	event_in_hdl(&this->lpf_gate, e);
 	/* record the velocity */
 	this->vel = event_get_float(e);
 }
@@ -50,7 +72,7 @@ static void goom_port_note(struct module *m, const struct event *e)
 	struct goom *this = (struct goom *)m->priv;
 
 	/* set the oscillator note */
-	event_in(this->osc, "note", e, NULL);
+	event_in_hdl(&this->osc_note, e);
 }
 
 /******************************************************************************
@@ -65,7 +87,7 @@ static int goom_alloc(struct module *m, va_list vargs)
 	struct module *lpf = NULL;
 
 	/* allocate the private data */
-	struct goom *this = ggm_calloc(1, sizeof(struct goom));
+	struct goom *this = synth_calloc(m->top, 1, sizeof(struct goom));
 
 	if (this == NULL) {
 		return -1;
@@ -80,26 +102,33 @@ static int goom_alloc(struct module *m, va_list vargs)
 	this->amp_env = amp_env;
 
 	/* low pass filter adsr envelope */
-	lpf_env = module_new(m, "env/adsr", -1);;
+	lpf_env = module_new(m, "env/adsr", -1);
 	if (lpf_env == NULL) {
 		goto error;
 	}
 	this->lpf_env = lpf_env;
 
 	/* goom oscillator */
-	osc = module_new(m, "osc/goom", -1);;
+	osc = module_new(m, "osc/goom", -1);
 	if (osc == NULL) {
 		goto error;
 	}
 	this->osc = osc;
 
 	/* low pass filter */
-	lpf = module_new(m, "filter/svf", -1);;
+	lpf = module_new(m, "filter/svf", -1, SVF_TYPE_TRAPEZOIDAL);
 	if (lpf == NULL) {
 		goto error;
 	}
 	this->lpf = lpf;
 
+	/* resolve the sub-module ports */
+	port_get_hdl(&this->amp_reset, amp_env, "reset");
+	port_get_hdl(&this->amp_gate, amp_env, "gate");
+	port_get_hdl(&this->lpf_gate, lpf_env, "gate");
+	port_get_hdl(&this->osc_reset, osc, "reset");
+	port_get_hdl(&this->osc_note, osc, "note");
+
 	return 0;
 
 error:
@@ -107,7 +136,7 @@ error:
 	module_del(lpf_env);
 	module_del(osc);
 	module_del(lpf);
-	ggm_free(m->priv);
+	synth_free(m->top, m->priv);
 	return -1;
 }
 
@@ -119,36 +148,29 @@ static void goom_free(struct module *m)
 	module_del(this->lpf_env);
 	module_del(this->osc);
 	module_del(this->lpf);
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool goom_process(struct module *m, float *bufs[])
+/* goom_vca applies the amplitude envelope to the filter output */
+static bool goom_vca(struct module *m, float *bufs[], size_t n)
 {
-	struct goom *this = (struct goom *)m->priv;
-	struct module *amp_env = this->amp_env;
-	float env[AudioBufferSize];
-	bool active = amp_env->info->process(amp_env, (float *[]){ env, });
-
-	if (active) {
-		// struct module *lpf_env = this->lpf_env;
-		struct module *osc = this->osc;
-		struct module *lpf = this->lpf;
-		float *out = bufs[0];
-
-		float buf[AudioBufferSize];
-
-		// get the oscillator output
-		osc->info->process(osc, (float *[]){ buf, });
-
-		// feed it to the LPF
-		lpf->info->process(lpf, (float *[]){ buf, out, });
-
-		// apply the amplitude envelope
-		block_mul(out, env);
-
-
-	}
+	block_mul(bufs[0], bufs[1], n);
+	return true;
+}
 
+static int goom_compile(struct module *m, struct plan *p, const int *bufs, int cond)
+{
+	struct goom *this = (struct goom *)m->priv;
+	int out = bufs[0];
+	int env = plan_buf(p);
+	int buf = plan_buf(p);
+
+	/* the oscillator and filter only run when the amplitude envelope is active */
+	int active = plan_module(p, this->amp_env, (int[]){ env, }, cond);
+	// lpf_env is not used yet
+	plan_module_out(p, this->osc, (int[]){ buf, }, active);
+	plan_module(p, this->lpf, (int[]){ buf, out, }, active);
+	plan_step(p, goom_vca, m, (int[]){ out, env, }, 2, active);
 	return active;
 }
 
@@ -157,14 +179,12 @@ static bool goom_process(struct module *m, float *bufs[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = goom_port_reset },
-	{ .name = "gate", .type = PORT_TYPE_FLOAT, .pf = goom_port_gate },
-	{ .name = "note", .type = PORT_TYPE_FLOAT, .pf = goom_port_note },
+	GOOM_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	GOOM_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -175,7 +195,7 @@ const struct module_info voice_goom_module = {
 	.out = out_ports,
 	.alloc = goom_alloc,
 	.free = goom_free,
-	.process = goom_process,
+	.compile = goom_compile,
 };
 
 MODULE_REGISTER(voice_goom_module);
@@ -12,6 +12,22 @@
 
 #include "ggm.h"
 
+/******************************************************************************
+ * ports
+ */
+
+#define VOICE_IN_PORTS(X)							\
+	X(VOICE_IN, reset, .type = PORT_TYPE_BOOL, .pf = osc_port_reset)	\
+	X(VOICE_IN, gate, .type = PORT_TYPE_FLOAT, .pf = osc_port_gate)		\
+	X(VOICE_IN, note, .type = PORT_TYPE_FLOAT, .pf = osc_port_note)
+
+enum { VOICE_IN_PORTS(PORT_ID) };
+
+#define VOICE_OUT_PORTS(X)	\
+	X(VOICE_OUT, out, .type = PORT_TYPE_AUDIO)
+
+enum { VOICE_OUT_PORTS(PORT_ID) };
+
 /******************************************************************************
  * private state
  */
@@ -19,8 +35,11 @@
 struct osc {
 	struct module *adsr;    /* adsr envelope */
 	struct module *osc;     /* oscillator */
-	port_func gate;         /* port function cache */
-	port_func freq;         /* port function cache */
+	struct port_hdl adsr_reset;     /* adsr reset port */
+	struct port_hdl adsr_gate;      /* adsr gate port */
+	struct port_hdl osc_reset;      /* oscillator reset port */
+	struct port_hdl osc_note;       /* oscillator note port */
+	struct port_hdl osc_freq;       /* oscillator frequency port (no note port) */
 };
 
 /******************************************************************************
@@ -33,8 +52,8 @@ static void osc_port_reset(struct module *m, const struct event *e)
 	struct osc *this = (struct osc *)m->priv;
 
 	/* forward the reset to the sub-modules */
-	event_in(this->adsr, "reset", e, NULL);
-	event_in(this->osc, "reset", e, NULL);
+	event_in_hdl(&this->adsr_reset, e);
+	event_in_hdl(&this->osc_reset, e);
 }
 
 /* osc_port_gate is the voice gate event */
@@ -42,16 +61,19 @@ static void osc_port_gate(struct module *m, const struct event *e)
 {
 	struct osc *this = (struct osc *)m->priv;
 
-	event_in(this->adsr, "gate", e, &this->gate);
+	event_in_hdl(&this->adsr_gate, e);
 }
 
 /* osc_port_note is the pitch bent MIDI note (float) used to set the voice frequency */
 static void osc_port_note(struct module *m, const struct event *e)
 {
 	struct osc *this = (struct osc *)m->priv;
-	float f = midi_to_frequency(event_get_float(e));
 
-	event_in_float(this->osc, "frequency", f, &this->freq);
+	if (this->osc_note.pf != NULL) {
+		event_in_hdl(&this->osc_note, e);
+	} else {
+		event_in_hdl_float(&this->osc_freq, midi_to_frequency(event_get_float(e)));
+	}
 }
 
 /******************************************************************************
@@ -64,7 +86,7 @@ static int osc_alloc(struct module *m, va_list vargs)
 	struct module *adsr = NULL;
 
 	/* allocate the private data */
-	struct osc *this = ggm_calloc(1, sizeof(struct osc));
+	struct osc *this = synth_calloc(m->top, 1, sizeof(struct osc));
 
 	if (this == NULL) {
 		return -1;
@@ -86,12 +108,22 @@ static int osc_alloc(struct module *m, va_list vargs)
 	}
 	this->adsr = adsr;
 
+	/* resolve the sub-module ports */
+	port_get_hdl(&this->adsr_reset, adsr, "reset");
+	port_get_hdl(&this->adsr_gate, adsr, "gate");
+	port_get_hdl(&this->osc_reset, osc, "reset");
+	if (port_get_hdl(&this->osc_note, osc, "note") != 0 &&
+	    port_get_hdl(&this->osc_freq, osc, "frequency") != 0) {
+		LOG_ERR("%s needs a note or frequency port", osc->name);
+		goto error;
+	}
+
 	return 0;
 
 error:
 	module_del(osc);
 	module_del(adsr);
-	ggm_free(m->priv);
+	synth_free(m->top, m->priv);
 	return -1;
 }
 
@@ -101,23 +133,27 @@ static void osc_free(struct module *m)
 
 	module_del(this->osc);
 	module_del(this->adsr);
-	ggm_free(this);
+	synth_free(m->top, this);
 }
 
-static bool osc_process(struct module *m, float *buf[])
+/* osc_vca applies the envelope to the oscillator output */
+static bool osc_vca(struct module *m, float *bufs[], size_t n)
 {
-	struct osc *this = (struct osc *)m->priv;
-	struct module *adsr = this->adsr;
-	float env[AudioBufferSize];
-	bool active = adsr->info->process(adsr, (float *[]){ env, });
-
-	if (active) {
-		struct module *osc = this->osc;
-		float *out = buf[0];
-		osc->info->process(osc, (float *[]){ out, });
-		block_mul(out, env);
-	}
+	block_mul(bufs[0], bufs[1], n);
+	return true;
+}
 
+static int osc_compile(struct module *m, struct plan *p, const int *bufs, int cond)
+{
+	struct osc *this = (struct osc *)m->priv;
+	int out = bufs[0];
+	int env = plan_buf(p);
+
+	/* the oscillator only runs when the envelope is active */
+	int active = plan_module(p, this->adsr, (int[]){ env, }, cond);
+	/* the oscillator modulation inputs (if any) are unconnected */
+	plan_module_out(p, this->osc, (int[]){ out, }, active);
+	plan_step(p, osc_vca, m, (int[]){ out, env, }, 2, active);
 	return active;
 }
 
@@ -126,14 +162,12 @@ static bool osc_process(struct module *m, float *buf[])
  */
 
 static const struct port_info in_ports[] = {
-	{ .name = "reset", .type = PORT_TYPE_BOOL, .pf = osc_port_reset },
-	{ .name = "gate", .type = PORT_TYPE_FLOAT, .pf = osc_port_gate },
-	{ .name = "note", .type = PORT_TYPE_FLOAT, .pf = osc_port_note },
+	VOICE_IN_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
 static const struct port_info out_ports[] = {
-	{ .name = "out", .type = PORT_TYPE_AUDIO, },
+	VOICE_OUT_PORTS(PORT_INFO)
 	PORT_EOL,
 };
 
@@ -144,7 +178,7 @@ const struct module_info voice_osc_module = {
 	.out = out_ports,
 	.alloc = osc_alloc,
 	.free = osc_free,
-	.process = osc_process,
+	.compile = osc_compile,
 };
 
 MODULE_REGISTER(voice_osc_module);
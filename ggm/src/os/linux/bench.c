@@ -0,0 +1,766 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Module Benchmarks
+ *
+ * Instantiates each registered module standalone, drives its process function
+ * with representative port events and reports the cost per sample.
+ */
+
+#define GGM_MAIN
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ggm.h"
+#include "module.h"
+#include "filter/filter.h"
+#include "midi/midi.h"
+#include "osc/osc.h"
+#include "seq/seq.h"
+
+/******************************************************************************
+ * benchmark configuration
+ */
+
+#define MIDI_CH 0
+
+#define BENCH_BUFFERS 20000     /* default number of buffers to process */
+#define BENCH_WARMUP 100        /* buffers to process before timing */
+
+struct bench {
+	const char *mname;                                      /* module name */
+	const char *desc;                                       /* benchmark description */
+	struct module *(*create)(struct synth *s);              /* create the module */
+	void (*setup)(struct module *m);                        /* initial port events */
+	void (*event)(struct module *m, unsigned int n);        /* per buffer port events */
+};
+
+/******************************************************************************
+ * module constructors
+ */
+
+static struct module *voice_goom_osc(struct module *m, int id)
+{
+	return module_new(m, "osc/goom", id);
+}
+
+static struct module *voice_osc_goom(struct module *m, int id)
+{
+	return module_new(m, "voice/osc", id, voice_goom_osc);
+}
+
+static struct module *new_default(struct synth *s, const char *name)
+{
+	return module_root(s, name, -1);
+}
+
+static struct module *new_delay(struct synth *s)
+{
+	return module_root(s, "delay/delay", -1, (int)(s->rate / 10));
+}
+
+static struct module *new_adsr(struct synth *s)
+{
+	return new_default(s, "env/adsr");
+}
+
+static struct module *new_biquad(struct synth *s)
+{
+	return new_default(s, "filter/biquad");
+}
+
+static struct module *new_svf_hc(struct synth *s)
+{
+	return module_root(s, "filter/svf", -1, SVF_TYPE_HC);
+}
+
+static struct module *new_svf_trap(struct synth *s)
+{
+	return module_root(s, "filter/svf", -1, SVF_TYPE_TRAPEZOIDAL);
+}
+
+static struct module *new_midi_bank(struct synth *s)
+{
+	return module_root(s, "midi/bank", -1, MIDI_CH, BANK_VOICE_OSC_GOOM, 5);
+}
+
+static struct module *new_midi_bank64(struct synth *s)
+{
+	return module_root(s, "midi/bank", -1, MIDI_CH, BANK_VOICE_OSC_GOOM, 64);
+}
+
+static struct module *new_midi_bank_goom(struct synth *s)
+{
+	return module_root(s, "midi/bank", -1, MIDI_CH, BANK_VOICE_GOOM, 64);
+}
+
+static struct module *new_midi_mono(struct synth *s)
+{
+	return module_root(s, "midi/mono", -1, MIDI_CH, voice_osc_goom);
+}
+
+static struct module *new_midi_poly(struct synth *s)
+{
+	return module_root(s, "midi/poly", -1, MIDI_CH, voice_osc_goom, 5);
+}
+
+static struct module *new_midi_poly64(struct synth *s)
+{
+	return module_root(s, "midi/poly", -1, MIDI_CH, voice_osc_goom, 64);
+}
+
+static struct module *new_pan(struct synth *s)
+{
+	return new_default(s, "mix/pan");
+}
+
+static struct module *new_goom(struct synth *s)
+{
+	return new_default(s, "osc/goom");
+}
+
+static struct module *new_ks(struct synth *s)
+{
+	return new_default(s, "osc/ks");
+}
+
+static struct module *new_lfo(struct synth *s)
+{
+	return new_default(s, "osc/lfo");
+}
+
+static struct module *new_noise_white(struct synth *s)
+{
+	return module_root(s, "osc/noise", -1, NOISE_TYPE_WHITE);
+}
+
+static struct module *new_noise_pink2(struct synth *s)
+{
+	return module_root(s, "osc/noise", -1, NOISE_TYPE_PINK2);
+}
+
+static struct module *new_sine(struct synth *s)
+{
+	return new_default(s, "osc/sine");
+}
+
+static struct module *new_breath(struct synth *s)
+{
+	return new_default(s, "pm/breath");
+}
+
+static struct module *new_root_metro(struct synth *s)
+{
+	return new_default(s, "root/metro");
+}
+
+static struct module *new_root_poly(struct synth *s)
+{
+	return new_default(s, "root/poly");
+}
+
+static const uint8_t bench_prog[] = {
+	SEQ_OP_NOTE, MIDI_CH, 69, 100, 4,
+	SEQ_OP_REST, 4,
+	SEQ_OP_LOOP,
+};
+
+static struct module *new_seq(struct synth *s)
+{
+	return module_root(s, "seq/seq", -1, bench_prog);
+}
+
+static struct module *new_smf(struct synth *s)
+{
+	return new_default(s, "seq/smf");
+}
+
+static struct module *new_voice_goom(struct synth *s)
+{
+	return new_default(s, "voice/goom");
+}
+
+static struct module *new_voice_osc(struct synth *s)
+{
+	return module_root(s, "voice/osc", -1, voice_goom_osc);
+}
+
+static struct module *new_plot(struct synth *s)
+{
+	return module_root(s, "view/plot", -1, NULL);
+}
+
+/******************************************************************************
+ * port events
+ */
+
+/* the gate is retriggered periodically so envelopes run through all states */
+#define GATE_PERIOD 256
+
+static void event_gate(struct module *m, unsigned int n)
+{
+	unsigned int k = n % GATE_PERIOD;
+
+	if (k == 0) {
+		event_in_float(m, "gate", 1.f, NULL);
+	} else if (k == (GATE_PERIOD / 2)) {
+		event_in_float(m, "gate", 0.f, NULL);
+	}
+}
+
+static void event_midi(struct module *m, unsigned int n)
+{
+	static const uint8_t chord[] = { 60, 64, 67, 71 };
+	unsigned int k = n % GATE_PERIOD;
+	struct event e;
+
+	if (k == 0 || k == (GATE_PERIOD / 2)) {
+		uint8_t msg = (k == 0) ? MIDI_STATUS_NOTEON : MIDI_STATUS_NOTEOFF;
+		for (size_t i = 0; i < sizeof(chord); i++) {
+			event_set_midi_note(&e, msg, MIDI_CH, chord[i], 100);
+			event_in(m, "midi", &e, NULL);
+		}
+	}
+}
+
+static void event_note(struct module *m, unsigned int n)
+{
+	if (n % GATE_PERIOD == 0) {
+		event_in_float(m, "note", 69.f, NULL);
+	}
+	event_gate(m, n);
+}
+
+static void setup_adsr(struct module *m)
+{
+	event_in_float(m, "attack", 0.1f, NULL);
+	event_in_float(m, "decay", 0.2f, NULL);
+	event_in_float(m, "sustain", 0.5f, NULL);
+	event_in_float(m, "release", 0.3f, NULL);
+}
+
+static void setup_filter(struct module *m)
+{
+	event_in_float(m, "cutoff", 2000.f, NULL);
+	event_in_float(m, "resonance", 0.5f, NULL);
+}
+
+static void event_filter(struct module *m, unsigned int n)
+{
+	/* sweep the cutoff */
+	float cutoff = 200.f + (float)(n % GATE_PERIOD) * 40.f;
+
+	event_in_float(m, "cutoff", cutoff, NULL);
+}
+
+/* dense polyphony: 64 notes are held for the whole benchmark */
+#define DENSE_NOTES 64
+#define DENSE_BASE 36
+
+static void setup_dense(struct module *m)
+{
+	struct event e;
+
+	for (uint8_t i = 0; i < DENSE_NOTES; i++) {
+		event_set_midi_note(&e, MIDI_STATUS_NOTEON, MIDI_CH, DENSE_BASE + i, 100);
+		event_in(m, "midi", &e, NULL);
+	}
+}
+
+static void setup_pan(struct module *m)
+{
+	event_in_float(m, "pan", 0.3f, NULL);
+	event_in_float(m, "vol", 0.8f, NULL);
+}
+
+static void setup_goom(struct module *m)
+{
+	event_in_float(m, "note", 69.f, NULL);
+	event_in_float(m, "duty", 0.3f, NULL);
+	event_in_float(m, "slope", 0.7f, NULL);
+}
+
+static void setup_ks(struct module *m)
+{
+	event_in_float(m, "note", 57.f, NULL);
+}
+
+static void event_ks(struct module *m, unsigned int n)
+{
+	if (n % GATE_PERIOD == 0) {
+		event_in_float(m, "gate", 1.f, NULL);
+	}
+}
+
+static void setup_lfo(struct module *m)
+{
+	event_in_float(m, "rate", 5.f, NULL);
+	event_in_float(m, "depth", 1.f, NULL);
+	event_in_int(m, "shape", LFO_SHAPE_SINE, NULL);
+}
+
+static void setup_sine(struct module *m)
+{
+	event_in_float(m, "note", 69.f, NULL);
+}
+
+static void setup_seq(struct module *m)
+{
+	event_in_float(m, "bpm", 120.f, NULL);
+	event_in_int(m, "ctrl", SEQ_CTRL_START, NULL);
+}
+
+static void setup_voice(struct module *m)
+{
+	event_in_float(m, "note", 69.f, NULL);
+}
+
+/******************************************************************************
+ * benchmark table
+ */
+
+static const struct bench bench_table[] = {
+	{ "delay/delay", "0.1 secs", new_delay, NULL, NULL },
+	{ "env/adsr", "retriggered gate", new_adsr, setup_adsr, event_gate },
+	{ "filter/biquad", "", new_biquad, setup_filter, NULL },
+	{ "filter/svf", "hc, cutoff sweep", new_svf_hc, setup_filter, event_filter },
+	{ "filter/svf", "trapezoidal, cutoff sweep", new_svf_trap, setup_filter, event_filter },
+	{ "midi/bank", "4 notes, voice/osc + osc/goom", new_midi_bank, NULL, event_midi },
+	{ "midi/bank", "4 notes, 64 voices", new_midi_bank64, NULL, event_midi },
+	{ "midi/bank", "4 notes, 64 voice/goom voices", new_midi_bank_goom, setup_filter, event_midi },
+	{ "midi/bank", "64 held notes, 64 voices", new_midi_bank64, setup_dense, NULL },
+	{ "midi/mono", "voice/osc + osc/goom", new_midi_mono, NULL, event_midi },
+	{ "midi/poly", "4 notes, voice/osc + osc/goom", new_midi_poly, NULL, event_midi },
+	{ "midi/poly", "4 notes, 64 voices", new_midi_poly64, NULL, event_midi },
+	{ "midi/poly", "64 held notes, 64 voices", new_midi_poly64, setup_dense, NULL },
+	{ "mix/pan", "", new_pan, setup_pan, NULL },
+	{ "osc/goom", "fm + pm noise", new_goom, setup_goom, NULL },
+	{ "osc/ks", "plucked, fm noise", new_ks, setup_ks, event_ks },
+	{ "osc/lfo", "sine", new_lfo, setup_lfo, NULL },
+	{ "osc/noise", "white", new_noise_white, NULL, NULL },
+	{ "osc/noise", "pink2", new_noise_pink2, NULL, NULL },
+	{ "osc/sine", "fm + pm noise", new_sine, setup_sine, NULL },
+	{ "pm/breath", "retriggered gate", new_breath, NULL, event_gate },
+	{ "root/metro", "", new_root_metro, NULL, NULL },
+	{ "root/poly", "4 notes", new_root_poly, NULL, event_midi },
+	{ "seq/seq", "120 bpm", new_seq, setup_seq, NULL },
+	{ "seq/smf", "", new_smf, NULL, NULL },
+	{ "voice/goom", "retriggered gate", new_voice_goom, setup_voice, event_note },
+	{ "voice/osc", "osc/goom, retriggered gate", new_voice_osc, setup_voice, event_note },
+	{ "view/plot", "not triggered", new_plot, NULL, NULL },
+};
+
+#define NUM_BENCH (sizeof(bench_table) / sizeof(bench_table[0]))
+
+/******************************************************************************
+ * benchmark functions
+ */
+
+static double bench_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+static void bench_midi_out(void *arg, const struct event *e, int idx)
+{
+	/* no MIDI output device - drop the event */
+}
+
+/* bench_run runs a single module benchmark */
+static int bench_run(const struct bench *b, unsigned int nbufs, unsigned int rate, size_t bufsize, unsigned int threads)
+{
+	int rc = -1;
+
+	struct synth *s = synth_new();
+
+	if (s == NULL) {
+		return -1;
+	}
+	s->midi_out = bench_midi_out;
+
+	if (synth_set_audio(s, rate, bufsize) != 0) {
+		goto exit;
+	}
+
+	if (synth_set_threads(s, threads, 0) != 0) {
+		goto exit;
+	}
+
+	struct module *m = b->create(s);
+	if (m == NULL) {
+		LOG_ERR("could not create %s", b->mname);
+		goto exit;
+	}
+
+	/* run the module as the root patch so queued events are dispatched */
+	int err = synth_set_root(s, m);
+	if (err != 0) {
+		LOG_ERR("could not set %s as the root patch", b->mname);
+		module_del(m);
+		goto exit;
+	}
+
+	/* fill the inputs with noise */
+	size_t n_in = port_count_by_type(m->info->in, PORT_TYPE_AUDIO);
+	uint32_t rand;
+	rand_init(1, &rand);
+	for (size_t i = 0; i < n_in; i++) {
+		for (size_t j = 0; j < bufsize; j++) {
+			s->bufs[i][j] = randf(&rand);
+		}
+	}
+
+	if (b->setup != NULL) {
+		b->setup(m);
+	}
+
+	/* warmup */
+	for (unsigned int i = 0; i < BENCH_WARMUP; i++) {
+		if (b->event != NULL) {
+			b->event(m, i);
+		}
+		synth_loop(s);
+	}
+
+	/* timed run */
+	double t0 = bench_time();
+	for (unsigned int i = 0; i < nbufs; i++) {
+		if (b->event != NULL) {
+			b->event(m, i);
+		}
+		synth_loop(s);
+	}
+	double t = bench_time() - t0;
+
+	/* report */
+	double secs_per_buf = t / (double)nbufs;
+	double ns_per_sample = (secs_per_buf * 1e9) / (double)bufsize;
+	double budget = (double)bufsize / (double)rate;
+	printf("%-18s %-30s %10.2f %12.0f %12.1f\n", b->mname, b->desc,
+	       ns_per_sample, 1.0 / secs_per_buf, budget / secs_per_buf);
+	rc = 0;
+
+exit:
+	synth_del(s);
+	return rc;
+}
+
+/******************************************************************************
+ * block operations
+ * Each cpu specific implementation is checked against the scalar reference
+ * and then timed.
+ */
+
+#define BLOCK_GUARD 8           /* samples after the block that must not change */
+#define BLOCK_MAX_OFS 4         /* check misaligned buffers */
+#define BLOCK_BUFSIZE (MaxAudioBufferSize + BLOCK_MAX_OFS + BLOCK_GUARD)
+
+struct block_test {
+	const char *name;                                                                       /* operation name */
+	void (*run)(const struct block_ops *ops, float *out[], float *in[], float k, size_t n);          /* run the operation */
+};
+
+static void run_zero(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->zero(out[0], n);
+}
+
+static void run_mul(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->mul(out[0], in[0], n);
+}
+
+static void run_add(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->add(out[0], in[0], n);
+}
+
+static void run_mul_k(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->mul_k(out[0], k, n);
+}
+
+static void run_add_k(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->add_k(out[0], k, n);
+}
+
+static void run_copy(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->copy(out[0], in[0], n);
+}
+
+static void run_copy_mul_k(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->copy_mul_k(out[0], in[0], k, n);
+}
+
+static void run_mla(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->mla(out[0], in[0], in[1], n);
+}
+
+static void run_mul_k_add(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->mul_k_add(out[0], in[0], k, 1.f - k, n);
+}
+
+static void run_copy_mul_k2(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	ops->copy_mul_k2(out[0], out[1], in[0], k, 1.f - k, n);
+}
+
+static void run_cos_lookup(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	uint32_t x[MaxAudioBufferSize];
+
+	/* map the input values onto the full phase range */
+	for (size_t i = 0; i < n; i++) {
+		x[i] = (uint32_t)(int32_t)(in[0][i] * 2147483647.f);
+	}
+	ops->cos_lookup(out[0], x, n);
+}
+
+/* phase_out stores the phase values (as a fraction of a cycle) for the check */
+static void phase_out(float *out, const uint32_t *x, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] = (float)x[i] * (1.f / (float)FullCycle);
+	}
+}
+
+static void run_phase_fm(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	uint32_t x[MaxAudioBufferSize];
+
+	/* check the returned phase as well */
+	uint32_t end = ops->phase_fm(x, 0x9abcdef0, 0x01234567, in[0], k, n);
+	phase_out(out[0], x, n);
+	phase_out(out[1], &end, 1);
+}
+
+static void run_phase_pm(const struct block_ops *ops, float *out[], float *in[], float k, size_t n)
+{
+	uint32_t x[MaxAudioBufferSize];
+
+	/* map the input values onto the full phase range */
+	for (size_t i = 0; i < n; i++) {
+		x[i] = (uint32_t)(int32_t)(in[1][i] * 2147483647.f);
+	}
+	ops->phase_pm(x, in[0], k, n);
+	phase_out(out[0], x, n);
+}
+
+static const struct block_test block_table[] = {
+	{ "block/zero", run_zero },
+	{ "block/mul", run_mul },
+	{ "block/add", run_add },
+	{ "block/mul_k", run_mul_k },
+	{ "block/add_k", run_add_k },
+	{ "block/copy", run_copy },
+	{ "block/copy_mul_k", run_copy_mul_k },
+	{ "block/mla", run_mla },
+	{ "block/mul_k_add", run_mul_k_add },
+	{ "block/copy_mul_k2", run_copy_mul_k2 },
+	{ "block/cos_lookup", run_cos_lookup },
+	{ "block/phase_fm", run_phase_fm },
+	{ "block/phase_pm", run_phase_pm },
+};
+
+#define NUM_BLOCK_TEST (sizeof(block_table) / sizeof(block_table[0]))
+
+/* block_fill fills the buffers with the same pseudo-random values for a given seed */
+static void block_fill(float *buf[], size_t nbufs, uint32_t seed)
+{
+	uint32_t rand;
+
+	rand_init(seed, &rand);
+	for (size_t i = 0; i < nbufs; i++) {
+		for (size_t j = 0; j < BLOCK_BUFSIZE; j++) {
+			buf[i][j] = randf(&rand);
+		}
+	}
+}
+
+/* block_same returns true if the values match. The scalar code may be
+ * compiled with fused multiply-adds, so allow for a rounding difference.
+ */
+static bool block_same(float a, float b)
+{
+	return fabsf(a - b) <= 1e-6f * (1.f + fabsf(a));
+}
+
+/* bench_block_check checks a block operation against the scalar implementation */
+static int bench_block_check(const struct block_test *t, const struct block_ops *ops)
+{
+	static float mem[6][BLOCK_BUFSIZE];
+	float *in[2] = { mem[0], mem[1] };
+	float *ref[2] = { mem[2], mem[3] };
+	float *out[2] = { mem[4], mem[5] };
+	const struct block_ops *scalar = block_get_ops(0);
+
+	for (size_t n = 1; n <= MaxAudioBufferSize; n = (n < 80) ? n + 1 : n * 2) {
+		for (size_t ofs = 0; ofs < BLOCK_MAX_OFS; ofs++) {
+			block_fill(in, 2, n);
+			block_fill(ref, 2, n + 1);
+			block_fill(out, 2, n + 1);
+			t->run(scalar, (float *[]){ &ref[0][ofs], &ref[1][ofs], }, (float *[]){ &in[0][ofs], &in[1][ofs], }, 0.7f, n);
+			t->run(ops, (float *[]){ &out[0][ofs], &out[1][ofs], }, (float *[]){ &in[0][ofs], &in[1][ofs], }, 0.7f, n);
+			for (size_t i = 0; i < 2; i++) {
+				for (size_t j = 0; j < BLOCK_BUFSIZE; j++) {
+					if (!block_same(ref[i][j], out[i][j])) {
+						LOG_ERR("%s %s: n %d offset %d, out%d[%d] %f != %f", t->name, ops->name,
+							n, ofs, i, j, out[i][j], ref[i][j]);
+						return -1;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+/* bench_block times a block operation */
+static void bench_block(const struct block_test *t, const struct block_ops *ops, unsigned int nbufs, unsigned int rate, size_t bufsize)
+{
+	static float mem[4][BLOCK_BUFSIZE];
+	float *in[2] = { mem[0], mem[1] };
+	float *out[2] = { mem[2], mem[3] };
+
+	/* unity values so repeated operations don't produce denormals */
+	for (size_t i = 0; i < BLOCK_BUFSIZE; i++) {
+		in[0][i] = 1.f;
+		in[1][i] = 1.f;
+		out[0][i] = 1.f;
+		out[1][i] = 1.f;
+	}
+
+	double t0 = bench_time();
+	for (unsigned int i = 0; i < nbufs; i++) {
+		t->run(ops, out, in, 1.f, bufsize);
+	}
+	double t1 = bench_time() - t0;
+
+	double secs_per_buf = t1 / (double)nbufs;
+	double ns_per_sample = (secs_per_buf * 1e9) / (double)bufsize;
+	double budget = (double)bufsize / (double)rate;
+	printf("%-18s %-30s %10.2f %12.0f %12.1f\n", t->name, ops->name,
+	       ns_per_sample, 1.0 / secs_per_buf, budget / secs_per_buf);
+}
+
+/* bench_selected returns true if the module was selected on the command line */
+static bool bench_selected(const char *mname, int argc, char *argv[])
+{
+	if (argc == 0) {
+		return true;
+	}
+	for (int i = 0; i < argc; i++) {
+		if (match(argv[i], mname)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/******************************************************************************
+ * main
+ */
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [options] [module ...]\n", name);
+	fprintf(stderr, "  -n <buffers>  number of buffers to process (default %d)\n", BENCH_BUFFERS);
+	fprintf(stderr, "  -s <rate>     sample rate (default %u Hz)\n", AudioSampleFrequency);
+	fprintf(stderr, "  -b <size>     audio buffer size (default %d, max %d)\n", AudioBufferSize, MaxAudioBufferSize);
+	fprintf(stderr, "  -j <n>        number of processing threads (default 1)\n");
+	fprintf(stderr, "  -v            verbose logging\n");
+	fprintf(stderr, "module names may contain * and ? wild cards\n");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int nbufs = BENCH_BUFFERS;
+	unsigned int rate = AudioSampleFrequency;
+	size_t bufsize = AudioBufferSize;
+	unsigned int threads = 1;
+	int errors = 0;
+	int opt;
+
+	log_set_prefix("ggm/src/");
+	log_set_level(LOG_WARN);
+
+	while ((opt = getopt(argc, argv, "n:s:b:j:vh")) != -1) {
+		switch (opt) {
+		case 'n':
+			nbufs = (unsigned int)maxi(1, atoi(optarg));
+			break;
+		case 's':
+			rate = (unsigned int)maxi(0, atoi(optarg));
+			break;
+		case 'b':
+			bufsize = (size_t)maxi(0, atoi(optarg));
+			break;
+		case 'j':
+			threads = (unsigned int)maxi(1, atoi(optarg));
+			break;
+		case 'v':
+			log_set_level(LOG_TRACE);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	printf("GooGooMuck %s (%s) module benchmarks\n", GGM_VERSION, CONFIG_BOARD);
+	printf("%u samples/buffer, %u Hz, %u buffers, %u threads\n\n", (unsigned int)bufsize, rate, nbufs, threads);
+	printf("%-18s %-30s %10s %12s %12s\n", "module", "benchmark", "ns/sample", "buffers/s", "per core");
+
+	/* check and time the block operations for each implementation */
+	for (size_t i = 0; i < NUM_BLOCK_TEST; i++) {
+		const struct block_test *t = &block_table[i];
+		if (!bench_selected(t->name, argc - optind, &argv[optind])) {
+			continue;
+		}
+		const struct block_ops *ops;
+		for (unsigned int j = 0; (ops = block_get_ops(j)) != NULL; j++) {
+			if (bench_block_check(t, ops) != 0) {
+				errors++;
+				continue;
+			}
+			bench_block(t, ops, nbufs * 10, rate, bufsize);
+		}
+	}
+
+	/* run the benchmarks for every registered module */
+	const struct module_info *mi;
+	for (unsigned int i = 0; (mi = module_get_info(i)) != NULL; i++) {
+		if (!bench_selected(mi->mname, argc - optind, &argv[optind])) {
+			continue;
+		}
+		bool found = false;
+		for (size_t j = 0; j < NUM_BENCH; j++) {
+			const struct bench *b = &bench_table[j];
+			if (strcmp(b->mname, mi->mname) == 0) {
+				if (bench_run(b, nbufs, rate, bufsize, threads) != 0) {
+					errors++;
+				}
+				found = true;
+			}
+		}
+		if (!found) {
+			printf("%-18s no benchmark\n", mi->mname);
+		}
+	}
+
+	return (errors == 0) ? 0 : 1;
+}
+
+/*****************************************************************************/
@@ -44,4 +44,21 @@ void ggm_free(void *ptr)
 	return free(ptr);
 }
 
+/******************************************************************************
+ * ggm_ticks returns the monotonic clock in nanoseconds (used for profiling)
+ */
+
+uint32_t ggm_ticks(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)ts.tv_sec * 1000000000U + (uint32_t)ts.tv_nsec;
+}
+
+uint32_t ggm_ticks_per_sec(void)
+{
+	return 1000000000U;
+}
+
 /*****************************************************************************/
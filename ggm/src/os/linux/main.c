@@ -7,17 +7,32 @@
 #define GGM_MAIN
 
 #include <signal.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <jack/jack.h>
 #include <jack/midiport.h>
 
 #include "ggm.h"
 #include "module.h"
+#include "linux/scl.h"
 
 /******************************************************************************
  * jack data
  */
 
+#define JACK_HIST_BINS 11       /* 10% of the buffer period per bin, the last is >= 100% */
+#define JACK_WORST_MODULES 16   /* number of modules recorded for the worst buffer */
+
+/* jack_worst records the slowest process callback */
+struct jack_worst {
+	uint32_t ticks;                                 /* callback time */
+	uint32_t frame;                                 /* synth frame at the start of the buffer */
+	int nmod;                                       /* number of modules (GGM_PROFILE only) */
+#if defined(GGM_PROFILE)
+	struct prof_module mod[JACK_WORST_MODULES];     /* slowest modules in the buffer */
+#endif
+};
+
 struct jack {
 	struct synth *synth;
 	jack_client_t *client;
@@ -31,6 +46,14 @@ struct jack {
 	jack_port_t *midi_out[MAX_MIDI_OUT];    /* MIDI output jack ports */
 	port_func midi_in_pf[MAX_MIDI_IN];      /* MIDI input port functions */
 	void *midi_out_buf[MAX_MIDI_OUT];       /* MIDI output buffers */
+	bool bufsize_ok;                        /* the jack buffer size matches the synth */
+	uint32_t period;                        /* buffer period (ticks) */
+	atomic_uint xruns;                      /* number of xruns reported by jack */
+	atomic_uint overruns;                   /* number of callbacks longer than the buffer period */
+	atomic_uint hist[JACK_HIST_BINS];       /* callback time histogram */
+	atomic_bool worst_req;                  /* the monitor thread wants the worst buffer */
+	struct jack_worst worst;                /* worst buffer (process thread) */
+	struct jack_worst worst_out;            /* worst buffer passed to the monitor thread */
 };
 
 /******************************************************************************
@@ -89,6 +112,93 @@ static struct event *jack_convert_midi_event(struct event *dst, jack_midi_event_
 	return NULL;
 }
 
+/******************************************************************************
+ * Telemetry
+ *
+ * The process callback time is recorded in a histogram, and callbacks that
+ * take longer than the buffer period are counted as overruns. The worst
+ * buffer is passed to the monitor thread when it sets worst_req. If the synth
+ * is built with GGM_PROFILE it includes the slowest modules in the buffer.
+ */
+
+/* jack_telemetry records the time of a process callback (process thread) */
+static void jack_telemetry(struct jack *j, uint32_t t)
+{
+	struct synth *s = j->synth;
+
+	unsigned int bin = (unsigned int)(((uint64_t)t * (JACK_HIST_BINS - 1)) / j->period);
+	if (bin >= JACK_HIST_BINS - 1) {
+		bin = JACK_HIST_BINS - 1;
+		atomic_fetch_add_explicit(&j->overruns, 1, memory_order_relaxed);
+	}
+	atomic_fetch_add_explicit(&j->hist[bin], 1, memory_order_relaxed);
+
+	if (t > j->worst.ticks) {
+		j->worst.ticks = t;
+		j->worst.frame = synth_frame(s) - s->bufsize;
+#if defined(GGM_PROFILE)
+		j->worst.nmod = prof_buffer(s, j->worst.frame, j->worst.mod, JACK_WORST_MODULES);
+#endif
+	}
+
+	if (atomic_load_explicit(&j->worst_req, memory_order_acquire)) {
+		j->worst_out = j->worst;
+		j->worst.ticks = 0;
+		j->worst.nmod = 0;
+		atomic_store_explicit(&j->worst_req, false, memory_order_release);
+	}
+}
+
+/* jack_xrun is called by jack when there is an xrun (not in the process thread) */
+static int jack_xrun(void *arg)
+{
+	struct jack *j = (struct jack *)arg;
+
+	atomic_fetch_add_explicit(&j->xruns, 1, memory_order_relaxed);
+	return 0;
+}
+
+/* jack_report logs and resets the telemetry (monitor thread) */
+static void jack_report(struct jack *j)
+{
+	float us = 1e6f / (float)ggm_ticks_per_sec();
+	float pct = 100.f / (float)j->period;
+	unsigned int hist[JACK_HIST_BINS];
+	unsigned int n = 0;
+	char str[JACK_HIST_BINS * 12];
+	int ofs = 0;
+
+	for (int i = 0; i < JACK_HIST_BINS; i++) {
+		hist[i] = atomic_exchange_explicit(&j->hist[i], 0, memory_order_relaxed);
+		n += hist[i];
+	}
+	unsigned int xruns = atomic_exchange_explicit(&j->xruns, 0, memory_order_relaxed);
+	unsigned int overruns = atomic_exchange_explicit(&j->overruns, 0, memory_order_relaxed);
+
+	LOG_INF("%u callbacks, %u xruns, %u overruns", n, xruns, overruns);
+	for (int i = 0; i < JACK_HIST_BINS && n > 0; i++) {
+		ofs += snprintf(&str[ofs], sizeof(str) - ofs, " %u", hist[i]);
+	}
+	if (n > 0) {
+		LOG_INF("callback time histogram (10%% bins):%s", str);
+	}
+
+	/* the worst buffer since the last request */
+	if (!atomic_load_explicit(&j->worst_req, memory_order_acquire)) {
+		struct jack_worst *w = &j->worst_out;
+		if (w->ticks != 0) {
+			LOG_INF("worst buffer at frame %u, %.1f us (%.1f%%)", w->frame, (float)w->ticks * us, (float)w->ticks * pct);
+#if defined(GGM_PROFILE)
+			for (int i = 0; i < w->nmod; i++) {
+				LOG_INF("%-32s %.1f us", w->mod[i].name, (float)w->mod[i].ticks * us);
+			}
+#endif
+			w->ticks = 0;
+		}
+		atomic_store_explicit(&j->worst_req, true, memory_order_release);
+	}
+}
+
 /******************************************************************************
  * jack ports
  */
@@ -151,10 +261,23 @@ static int jack_process(jack_nframes_t nframes, void *arg)
 {
 	struct jack *j = (struct jack *)arg;
 	struct synth *s = (struct synth *)j->synth;
+	uint32_t t0 = ggm_ticks();
 	size_t i;
 
 	// LOG_DBG("nframes %d", nframes);
 
+	if (!j->bufsize_ok) {
+		/* the synth can't process this buffer size - output silence */
+		for (i = 0; i < j->n_audio_out; i++) {
+			float *buf = (float *)jack_port_get_buffer(j->audio_out[i], nframes);
+			memset(buf, 0, nframes * sizeof(float));
+		}
+		for (i = 0; i < j->n_midi_out; i++) {
+			jack_midi_clear_buffer(jack_port_get_buffer(j->midi_out[i], nframes));
+		}
+		return 0;
+	}
+
 	/* read MIDI input events */
 	for (i = 0; i < j->n_midi_in; i++) {
 		void *buf = jack_port_get_buffer(j->midi_in[i], nframes);
@@ -170,11 +293,18 @@ static int jack_process(jack_nframes_t nframes, void *arg)
 				LOG_ERR("jack_midi_event_get() returned %d", err);
 				continue;
 			}
-			/* forward the MIDI event to the root module of the synth  */
+			/* forward the MIDI event to the root module of the synth at its sample frame */
 			port_func func = j->midi_in_pf[i];
 			if (func != NULL) {
 				struct event e;
-				func(s->root, jack_convert_midi_event(&e, &event));
+				if (jack_convert_midi_event(&e, &event) == NULL) {
+					continue;
+				}
+				uint32_t time = synth_frame(s) + event.time;
+				if (synth_event_in(s, s->root, func, &e, time) != 0) {
+					/* the input queue is full, dispatch it now */
+					func(s->root, &e);
+				}
 			} else {
 				LOG_WRN("midi_in_%d has a null port function", i);
 			}
@@ -191,7 +321,7 @@ static int jack_process(jack_nframes_t nframes, void *arg)
 	/* read from the audio input buffers */
 	for (i = 0; i < j->n_audio_in; i++) {
 		float *buf = (float *)jack_port_get_buffer(j->audio_in[i], nframes);
-		block_copy(s->bufs[i], buf);
+		block_copy(s->bufs[i], buf, nframes);
 	}
 
 	/* run the synth loop */
@@ -202,12 +332,26 @@ static int jack_process(jack_nframes_t nframes, void *arg)
 	for (i = 0; i < j->n_audio_out; i++) {
 		float *buf = (float *)jack_port_get_buffer(j->audio_out[i], nframes);
 		if (active) {
-			block_copy(buf, s->bufs[ofs + i]);
+			block_copy(buf, s->bufs[ofs + i], nframes);
 		} else {
-			block_zero(buf);
+			block_zero(buf, nframes);
 		}
 	}
 
+	jack_telemetry(j, ggm_ticks() - t0);
+	return 0;
+}
+
+/* jack_bufsize is called when the jack buffer size changes */
+static int jack_bufsize(jack_nframes_t nframes, void *arg)
+{
+	struct jack *j = (struct jack *)arg;
+	struct synth *s = (struct synth *)j->synth;
+
+	j->bufsize_ok = (nframes == s->bufsize);
+	if (!j->bufsize_ok) {
+		LOG_ERR("jack buffer size %d != ggm buffer size %d, output is muted", nframes, s->bufsize);
+	}
 	return 0;
 }
 
@@ -260,19 +404,15 @@ static void jack_del(struct jack *j)
 	ggm_free(j);
 }
 
+/* jack_new opens a jack client and sets the synth to the jack sample rate
+ * and buffer size. It is called before the root patch is created.
+ */
 static struct jack *jack_new(struct synth *s)
 {
 	jack_status_t status;
-	size_t n;
-	int err;
 
 	LOG_INF("jack version %s", jack_get_version_string());
 
-	if (!synth_has_root(s)) {
-		LOG_ERR("synth does not have a root patch");
-		return NULL;
-	}
-
 	struct jack *j = ggm_calloc(1, sizeof(struct jack));
 	if (j == NULL) {
 		LOG_ERR("cannot allocate jack data");
@@ -284,6 +424,47 @@ static struct jack *jack_new(struct synth *s)
 	s->driver = (void *)j;
 	s->midi_out = jack_midi_out;
 
+	/* open the client */
+	j->client = jack_client_open("ggm", JackNoStartServer, &status);
+	if (j->client == NULL) {
+		LOG_ERR("jack server not running");
+		goto error;
+	}
+
+	/* use the jack sample rate and buffer size */
+	jack_nframes_t rate = jack_get_sample_rate(j->client);
+	jack_nframes_t bufsize = jack_get_buffer_size(j->client);
+	int err = synth_set_audio(s, rate, bufsize);
+	if (err != 0) {
+		LOG_ERR("can't run with jack sample rate %d, buffer size %d", rate, bufsize);
+		goto error;
+	}
+	j->bufsize_ok = true;
+
+	return j;
+
+error:
+	if (j->client != NULL) {
+		jack_client_close(j->client);
+	}
+	ggm_free(j);
+	return NULL;
+}
+
+/* jack_start registers the jack ports for the synth root patch and
+ * activates the client.
+ */
+static int jack_start(struct jack *j)
+{
+	struct synth *s = j->synth;
+	size_t n;
+	int err;
+
+	if (!synth_has_root(s)) {
+		LOG_ERR("synth does not have a root patch");
+		return -1;
+	}
+
 	/* count and check the in/out ports */
 	struct module *m = s->root;
 	j->n_audio_in = port_count_by_type(m->info->in, PORT_TYPE_AUDIO);
@@ -307,33 +488,27 @@ static struct jack *jack_new(struct synth *s)
 		goto error;
 	}
 
-	/* open the client */
-	j->client = jack_client_open("ggm", JackNoStartServer, &status);
-	if (j->client == NULL) {
-		LOG_ERR("jack server not running");
-		goto error;
-	}
-
-	/* check sample rate */
-	jack_nframes_t rate = jack_get_sample_rate(j->client);
-	if (rate != AudioSampleFrequency) {
-		LOG_ERR("jack sample rate %d != ggm sample rate %d", rate, AudioSampleFrequency);
+	/* tell the JACK server to call jack_process() whenever there is work to be done. */
+	err = jack_set_process_callback(j->client, jack_process, (void *)j);
+	if (err != 0) {
+		LOG_ERR("jack_set_process_callback() error %d", err);
 		goto error;
 	}
 
-	/* check audio buffer size */
-	jack_nframes_t bufsize = jack_get_buffer_size(j->client);
-	if (bufsize != AudioBufferSize) {
-		LOG_ERR("jack buffer size %d != ggm buffer size %d", bufsize, AudioBufferSize);
+	/* tell the JACK server to call jack_bufsize() if the buffer size changes. */
+	err = jack_set_buffer_size_callback(j->client, jack_bufsize, (void *)j);
+	if (err != 0) {
+		LOG_ERR("jack_set_buffer_size_callback() error %d", err);
 		goto error;
 	}
 
-	/* tell the JACK server to call jack_process() whenever there is work to be done. */
-	err = jack_set_process_callback(j->client, jack_process, (void *)j);
+	/* tell the JACK server to call jack_xrun() when there is an xrun. */
+	err = jack_set_xrun_callback(j->client, jack_xrun, (void *)j);
 	if (err != 0) {
-		LOG_ERR("jack_set_process_callback() error %d", err);
+		LOG_ERR("jack_set_xrun_callback() error %d", err);
 		goto error;
 	}
+	j->period = (uint32_t)(((uint64_t)ggm_ticks_per_sec() * s->bufsize) / s->rate);
 
 	/* tell the JACK server to call shutdown() if it ever shuts down,
 	 * either entirely, or if it just decides to stop calling us.
@@ -379,21 +554,18 @@ static struct jack *jack_new(struct synth *s)
 		goto error;
 	}
 
-	return j;
+	return 0;
 
 error:
-
-	if (j->client != NULL) {
-		jack_unregister_ports(j->client, j->audio_in, j->n_audio_in, "audio_in");
-		jack_unregister_ports(j->client, j->audio_out, j->n_audio_out, "audio_out");
-		jack_unregister_ports(j->client, j->midi_in, j->n_midi_in, "midi_in");
-		jack_unregister_ports(j->client, j->midi_out, j->n_midi_out, "midi_out");
-		jack_client_close(j->client);
-	}
-
-	ggm_free(j);
-
-	return NULL;
+	jack_unregister_ports(j->client, j->audio_in, j->n_audio_in, "audio_in");
+	jack_unregister_ports(j->client, j->audio_out, j->n_audio_out, "audio_out");
+	jack_unregister_ports(j->client, j->midi_in, j->n_midi_in, "midi_in");
+	jack_unregister_ports(j->client, j->midi_out, j->n_midi_out, "midi_out");
+	j->n_audio_in = 0;
+	j->n_audio_out = 0;
+	j->n_midi_in = 0;
+	j->n_midi_out = 0;
+	return -1;
 }
 
 /******************************************************************************
@@ -406,10 +578,44 @@ static void ctrl_c_handler(int sig)
 	synth_running = false;
 }
 
-int main(void)
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [options]\n", name);
+	fprintf(stderr, "  -j <n>  number of processing threads (default 1)\n");
+	fprintf(stderr, "  -l <n>  dsp load limit for new voices in percent (default 80, 0 = off)\n");
+	fprintf(stderr, "  -t <n>  telemetry report period in seconds (default 10, 0 = off)\n");
+	fprintf(stderr, "  -T <f>  tuning scale file (.scl, default 12-TET)\n");
+}
+
+int main(int argc, char *argv[])
 {
 	struct jack *j = NULL;
+	const char *scale = NULL;
+	unsigned int threads = 1;
+	int report = 10;
+	int limit = 80;
 	int err;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "j:l:t:T:h")) != -1) {
+		switch (opt) {
+		case 'j':
+			threads = (unsigned int)maxi(1, atoi(optarg));
+			break;
+		case 'l':
+			limit = maxi(0, atoi(optarg));
+			break;
+		case 't':
+			report = maxi(0, atoi(optarg));
+			break;
+		case 'T':
+			scale = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
 
 	log_set_prefix("ggm/src/");
 
@@ -420,6 +626,24 @@ int main(void)
 		goto exit;
 	}
 
+	/* open jack first to get the sample rate and buffer size */
+	j = jack_new(s);
+	if (j == NULL) {
+		goto exit;
+	}
+
+	/* the worker threads run at the jack process thread priority */
+	err = synth_set_threads(s, threads, maxi(0, jack_client_real_time_priority(j->client)));
+	if (err != 0) {
+		goto exit;
+	}
+
+	synth_set_load_limit(s, (float)limit / 100.f);
+
+	if (scale != NULL && scl_load(s, scale) != 0) {
+		goto exit;
+	}
+
 	struct module *m = module_root(s, "root/poly", -1);
 	if (m == NULL) {
 		goto exit;
@@ -427,11 +651,12 @@ int main(void)
 
 	err = synth_set_root(s, m);
 	if (err != 0) {
+		module_del(m);
 		goto exit;
 	}
 
-	j = jack_new(s);
-	if (j == NULL) {
+	err = jack_start(j);
+	if (err != 0) {
 		goto exit;
 	}
 
@@ -443,8 +668,16 @@ int main(void)
 	}
 
 	synth_running = true;
+	int secs = 0;
 	while (synth_running) {
 		sleep(1);
+		if (report > 0 && ++secs >= report) {
+			secs = 0;
+			jack_report(j);
+#if defined(GGM_PROFILE)
+			prof_dump(s);
+#endif
+		}
 	}
 
 exit:
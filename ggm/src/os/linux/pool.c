@@ -0,0 +1,230 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Worker Thread Pool for Linux
+ *
+ * ggm_pool_run() splits a job into n items and runs them on the worker
+ * threads and the calling thread. The calling thread is the audio thread,
+ * so running a job doesn't allocate memory or take locks. The workers run at
+ * the priority of the audio thread, and if a worker that has claimed an item
+ * isn't done after a while the audio thread yields to it (it may have been
+ * preempted on the same cpu).
+ *
+ * The job state is a single 64-bit atomic word holding the job generation,
+ * the number of items and the next item to run. A thread claims an item
+ * with a compare and swap on the word, so a worker that is late to see the
+ * end of a job can't claim an item of the next job by mistake.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "ggm.h"
+
+/******************************************************************************
+ * pool data
+ */
+
+#define POOL_MAX_ITEMS 0xffff   /* maximum number of items in a job */
+#define POOL_SPIN 20000         /* idle loops before a worker sleeps */
+#define POOL_SLEEP_NS 50000     /* idle worker sleep time (nsecs) */
+#define POOL_WAIT_SPIN 2000     /* wait loops before the calling thread yields */
+
+/* job word fields */
+#define JOB_GEN(x) ((uint32_t)((x) >> 32))
+#define JOB_N(x) ((unsigned int)(((x) >> 16) & 0xffff))
+#define JOB_IDX(x) ((unsigned int)((x) & 0xffff))
+#define JOB(gen, n) (((uint64_t)(gen) << 32) | ((uint64_t)(n) << 16))
+
+struct ggm_pool {
+	pthread_t *thread;      /* worker threads */
+	unsigned int nthreads;  /* number of worker threads */
+	_Atomic uint64_t job;   /* job generation, number of items, next item */
+	atomic_uint done;       /* number of items completed */
+	atomic_bool quit;       /* tell the workers to exit */
+	pool_func func;         /* job function */
+	void *arg;              /* job function argument */
+	uint32_t gen;           /* current job generation */
+};
+
+/******************************************************************************
+ * job functions
+ */
+
+static inline void pool_relax(void)
+{
+#if defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ volatile ("yield");
+#endif
+}
+
+/* pool_work runs items of the job generation until there are none left.
+ * It returns true if it ran any items.
+ */
+static bool pool_work(struct ggm_pool *p, uint32_t gen)
+{
+	uint64_t x = atomic_load_explicit(&p->job, memory_order_acquire);
+	bool worked = false;
+
+	while (JOB_GEN(x) == gen && JOB_IDX(x) < JOB_N(x)) {
+		/* claim the next item */
+		if (!atomic_compare_exchange_weak_explicit(&p->job, &x, x + 1,
+							   memory_order_acq_rel, memory_order_acquire)) {
+			continue;
+		}
+		p->func(p->arg, JOB_IDX(x));
+		atomic_fetch_add_explicit(&p->done, 1, memory_order_release);
+		worked = true;
+		x = atomic_load_explicit(&p->job, memory_order_acquire);
+	}
+	return worked;
+}
+
+/* pool_worker is the worker thread main loop */
+static void *pool_worker(void *arg)
+{
+	struct ggm_pool *p = (struct ggm_pool *)arg;
+	const struct timespec ts = { 0, POOL_SLEEP_NS };
+	unsigned int idle = 0;
+
+	while (!atomic_load_explicit(&p->quit, memory_order_relaxed)) {
+		uint64_t x = atomic_load_explicit(&p->job, memory_order_acquire);
+		if (pool_work(p, JOB_GEN(x))) {
+			idle = 0;
+			continue;
+		}
+		/* spin for a while, then sleep so an idle pool doesn't burn cpu */
+		if (idle < POOL_SPIN) {
+			idle++;
+			pool_relax();
+		} else {
+			nanosleep(&ts, NULL);
+		}
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * ggm_pool_run runs a job of n items and returns when they are all done.
+ * The items may run in any order and on any thread. It must only be called
+ * from one thread at a time.
+ */
+
+void ggm_pool_run(struct ggm_pool *p, pool_func func, void *arg, unsigned int n)
+{
+	if (p == NULL || n <= 1 || n > POOL_MAX_ITEMS) {
+		/* run it on this thread */
+		for (unsigned int i = 0; i < n; i++) {
+			func(arg, i);
+		}
+		return;
+	}
+
+	/* setup and publish the job */
+	p->func = func;
+	p->arg = arg;
+	p->gen++;
+	atomic_store_explicit(&p->done, 0, memory_order_relaxed);
+	atomic_store_explicit(&p->job, JOB(p->gen, n), memory_order_release);
+
+	/* work on the job */
+	pool_work(p, p->gen);
+
+	/* wait for the items claimed by the workers */
+	unsigned int spin = 0;
+	while (atomic_load_explicit(&p->done, memory_order_acquire) != n) {
+		if (spin < POOL_WAIT_SPIN) {
+			spin++;
+			pool_relax();
+		} else {
+			sched_yield();
+		}
+	}
+}
+
+/******************************************************************************
+ * pool new/del
+ */
+
+/* pool_thread_create creates a worker thread with a real-time (SCHED_FIFO)
+ * priority, or a normal thread if the priority is 0.
+ */
+static int pool_thread_create(struct ggm_pool *p, pthread_t *thread, int priority)
+{
+	struct sched_param param = { .sched_priority = priority };
+	pthread_attr_t attr;
+	int err;
+
+	if (priority <= 0) {
+		return pthread_create(thread, NULL, pool_worker, (void *)p);
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	err = pthread_create(thread, &attr, pool_worker, (void *)p);
+	pthread_attr_destroy(&attr);
+	return err;
+}
+
+/* ggm_pool_new creates a pool with nthreads worker threads.
+ * priority is the real-time priority of the calling (audio) thread, 0 if it
+ * isn't real-time. A real-time audio thread can't wait on a normal priority
+ * worker, so if the real-time workers can't be created the pool isn't created.
+ */
+struct ggm_pool *ggm_pool_new(unsigned int nthreads, int priority)
+{
+	struct ggm_pool *p = ggm_calloc(1, sizeof(struct ggm_pool));
+
+	if (p == NULL) {
+		LOG_ERR("could not allocate pool");
+		return NULL;
+	}
+
+	p->thread = ggm_calloc(nthreads, sizeof(pthread_t));
+	if (p->thread == NULL) {
+		LOG_ERR("could not allocate pool threads");
+		ggm_free(p);
+		return NULL;
+	}
+
+	atomic_init(&p->job, 0);
+	atomic_init(&p->done, 0);
+	atomic_init(&p->quit, false);
+
+	for (unsigned int i = 0; i < nthreads; i++) {
+		int err = pool_thread_create(p, &p->thread[i], priority);
+		if (err != 0) {
+			LOG_ERR("could not create worker thread %u (priority %d, error %d)", i, priority, err);
+			ggm_pool_del(p);
+			return NULL;
+		}
+		p->nthreads++;
+	}
+
+	LOG_INF("%u worker threads (priority %d)", nthreads, priority);
+	return p;
+}
+
+/* ggm_pool_del stops the worker threads and deallocates the pool */
+void ggm_pool_del(struct ggm_pool *p)
+{
+	if (p == NULL) {
+		return;
+	}
+	atomic_store(&p->quit, true);
+	for (unsigned int i = 0; i < p->nthreads; i++) {
+		pthread_join(p->thread[i], NULL);
+	}
+	ggm_free(p->thread);
+	ggm_free(p);
+}
+
+/*****************************************************************************/
@@ -0,0 +1,743 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Offline Render Driver
+ *
+ * Runs the synth loop as fast as the CPU allows. MIDI input is read from a
+ * standard MIDI file and the audio output is written to a WAV or raw float file.
+ */
+
+#define GGM_MAIN
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ggm.h"
+#include "module.h"
+#include "linux/scl.h"
+
+/******************************************************************************
+ * render data
+ */
+
+enum {
+	RENDER_FORMAT_WAV,      /* 32-bit float WAV file */
+	RENDER_FORMAT_RAW,      /* interleaved 32-bit float samples */
+};
+
+struct render_event {
+	uint64_t frame;         /* sample frame at which to dispatch the event */
+	uint32_t tick;          /* absolute time (MIDI file ticks) */
+	uint32_t order;         /* file order (for a stable sort) */
+	uint32_t tempo;         /* tempo change (usecs per quarter note) or 0 */
+	struct event e;         /* MIDI event */
+};
+
+struct render {
+	struct synth *synth;
+	const char *patch;                      /* root patch name */
+	const char *midi_name;                  /* MIDI input file name */
+	const char *out_name;                   /* audio output file name */
+	int format;                             /* output file format */
+	float tail;                             /* render time after the last event (secs) */
+	float duration;                         /* total render time (secs), 0 = use the MIDI file */
+	unsigned int rate;                      /* audio sample rate (Hz) */
+	size_t bufsize;                         /* audio buffer size (samples) */
+	unsigned int threads;                   /* number of processing threads */
+	const char *scale;                      /* tuning scale file (.scl) */
+	struct render_event *ev;                /* MIDI events */
+	size_t n_ev;                            /* number of MIDI events */
+	size_t n_audio_in;                      /* number of input audio ports */
+	size_t n_audio_out;                     /* number of output audio ports */
+	port_func midi_in_pf;                   /* MIDI input port function */
+	FILE *f;                                /* output file */
+	uint64_t frames;                        /* frames written to the output */
+	float buf[MAX_AUDIO_OUT * MaxAudioBufferSize]; /* interleaved output buffer */
+};
+
+/******************************************************************************
+ * standard MIDI file reader
+ */
+
+struct smf_reader {
+	const uint8_t *buf;     /* file data */
+	size_t n;               /* file size */
+	size_t ofs;             /* read offset */
+};
+
+static int smf_get_u8(struct smf_reader *r, uint8_t *val)
+{
+	if (r->ofs + 1 > r->n) {
+		return -1;
+	}
+	*val = r->buf[r->ofs];
+	r->ofs += 1;
+	return 0;
+}
+
+static int smf_get_u16(struct smf_reader *r, uint16_t *val)
+{
+	if (r->ofs + 2 > r->n) {
+		return -1;
+	}
+	*val = (r->buf[r->ofs] << 8) | r->buf[r->ofs + 1];
+	r->ofs += 2;
+	return 0;
+}
+
+static int smf_get_u32(struct smf_reader *r, uint32_t *val)
+{
+	if (r->ofs + 4 > r->n) {
+		return -1;
+	}
+	const uint8_t *b = &r->buf[r->ofs];
+	*val = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+	r->ofs += 4;
+	return 0;
+}
+
+/* smf_get_vlq reads a variable length quantity */
+static int smf_get_vlq(struct smf_reader *r, uint32_t *val)
+{
+	uint32_t x = 0;
+
+	for (int i = 0; i < 4; i++) {
+		uint8_t b;
+		if (smf_get_u8(r, &b) != 0) {
+			return -1;
+		}
+		x = (x << 7) | (b & 0x7f);
+		if ((b & 0x80) == 0) {
+			*val = x;
+			return 0;
+		}
+	}
+	/* too many bytes */
+	return -1;
+}
+
+static int smf_skip(struct smf_reader *r, size_t n)
+{
+	if (r->ofs + n > r->n) {
+		return -1;
+	}
+	r->ofs += n;
+	return 0;
+}
+
+/* render_add_event appends an event to the event list */
+static struct render_event *render_add_event(struct render *r, size_t *size)
+{
+	if (r->n_ev == *size) {
+		size_t n = (*size == 0) ? 256 : *size * 2;
+		struct render_event *ev = realloc(r->ev, n * sizeof(struct render_event));
+		if (ev == NULL) {
+			LOG_ERR("could not allocate MIDI events");
+			return NULL;
+		}
+		r->ev = ev;
+		*size = n;
+	}
+	struct render_event *x = &r->ev[r->n_ev];
+	memset(x, 0, sizeof(struct render_event));
+	x->order = r->n_ev;
+	r->n_ev++;
+	return x;
+}
+
+/* smf_read_track reads the events from a track chunk */
+static int smf_read_track(struct render *r, struct smf_reader *rd, size_t end, size_t *size)
+{
+	uint32_t tick = 0;
+	uint8_t status = 0;
+
+	while (rd->ofs < end) {
+		uint32_t delta;
+		uint8_t b;
+
+		if (smf_get_vlq(rd, &delta) != 0 || smf_get_u8(rd, &b) != 0) {
+			goto error;
+		}
+		tick += delta;
+
+		if (b == 0xff) {
+			/* meta event */
+			uint8_t type;
+			uint32_t len;
+			if (smf_get_u8(rd, &type) != 0 || smf_get_vlq(rd, &len) != 0) {
+				goto error;
+			}
+			if (type == 0x51 && len == 3) {
+				/* set tempo */
+				const uint8_t *t = &rd->buf[rd->ofs];
+				if (smf_skip(rd, len) != 0) {
+					goto error;
+				}
+				struct render_event *x = render_add_event(r, size);
+				if (x == NULL) {
+					return -1;
+				}
+				x->tick = tick;
+				x->tempo = (t[0] << 16) | (t[1] << 8) | t[2];
+				continue;
+			}
+			if (type == 0x2f) {
+				/* end of track */
+				rd->ofs = end;
+				break;
+			}
+			if (smf_skip(rd, len) != 0) {
+				goto error;
+			}
+			continue;
+		}
+
+		if (b == MIDI_STATUS_SYSEXSTART || b == MIDI_STATUS_SYSEXEND) {
+			/* sysex - ignore it */
+			uint32_t len;
+			if (smf_get_vlq(rd, &len) != 0 || smf_skip(rd, len) != 0) {
+				goto error;
+			}
+			status = 0;
+			continue;
+		}
+
+		uint8_t arg0 = b;
+		if (b & 0x80) {
+			/* new status */
+			if (b >= MIDI_STATUS_COMMON) {
+				LOG_ERR("unexpected status %02x in MIDI file", b);
+				goto error;
+			}
+			status = b;
+			if (smf_get_u8(rd, &arg0) != 0) {
+				goto error;
+			}
+		} else if (status == 0) {
+			LOG_ERR("running status without a status byte");
+			goto error;
+		}
+
+		uint8_t arg1 = 0;
+		switch (status & 0xf0) {
+		case MIDI_STATUS_PROGRAMCHANGE:
+		case MIDI_STATUS_CHANNELAFTERTOUCH:
+			break;
+		default:
+			if (smf_get_u8(rd, &arg1) != 0) {
+				goto error;
+			}
+			break;
+		}
+
+		struct render_event *x = render_add_event(r, size);
+		if (x == NULL) {
+			return -1;
+		}
+		x->tick = tick;
+		event_set_midi(&x->e, status, arg0, arg1);
+	}
+	return 0;
+
+error:
+	LOG_ERR("bad MIDI track data at offset %d", rd->ofs);
+	return -1;
+}
+
+/* render_event_cmp sorts events by time and then by file order */
+static int render_event_cmp(const void *a, const void *b)
+{
+	const struct render_event *x = (const struct render_event *)a;
+	const struct render_event *y = (const struct render_event *)b;
+
+	if (x->tick != y->tick) {
+		return (x->tick < y->tick) ? -1 : 1;
+	}
+	if (x->order != y->order) {
+		return (x->order < y->order) ? -1 : 1;
+	}
+	return 0;
+}
+
+/* render_event_time converts the event ticks to sample frames */
+static void render_event_time(struct render *r, uint16_t division)
+{
+	double secs_per_tick;
+	double secs = 0.0;
+	uint32_t tick = 0;
+
+	if (division & 0x8000) {
+		/* SMPTE time */
+		int fps = -(int8_t)(division >> 8);
+		int tpf = division & 0xff;
+		secs_per_tick = 1.0 / (double)(fps * tpf);
+	} else {
+		/* 120 bpm until we see a tempo event */
+		secs_per_tick = 500000e-6 / (double)division;
+	}
+
+	for (size_t i = 0; i < r->n_ev; i++) {
+		struct render_event *x = &r->ev[i];
+		secs += (double)(x->tick - tick) * secs_per_tick;
+		tick = x->tick;
+		x->frame = (uint64_t)(secs * (double)r->rate + 0.5);
+		if (x->tempo != 0 && !(division & 0x8000)) {
+			secs_per_tick = (double)x->tempo * 1e-6 / (double)division;
+		}
+	}
+}
+
+/* render_read_midi reads a standard MIDI file into the render event list */
+static int render_read_midi(struct render *r, const char *name)
+{
+	struct smf_reader rd;
+	uint8_t *buf = NULL;
+	size_t size = 0;
+
+	/* read the whole file */
+	FILE *f = fopen(name, "rb");
+	if (f == NULL) {
+		LOG_ERR("unable to open %s", name);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	long n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (n <= 0) {
+		LOG_ERR("%s is empty", name);
+		goto error;
+	}
+	buf = ggm_calloc(n, 1);
+	if (buf == NULL) {
+		LOG_ERR("could not allocate %ld bytes", n);
+		goto error;
+	}
+	if (fread(buf, 1, n, f) != (size_t)n) {
+		LOG_ERR("unable to read %s", name);
+		goto error;
+	}
+
+	rd.buf = buf;
+	rd.n = n;
+	rd.ofs = 0;
+
+	/* header chunk */
+	uint32_t id, len;
+	uint16_t format, ntrks, division;
+	if (smf_get_u32(&rd, &id) != 0 || id != 0x4d546864 /* MThd */) {
+		LOG_ERR("%s is not a MIDI file", name);
+		goto error;
+	}
+	if (smf_get_u32(&rd, &len) != 0 || len < 6 ||
+	    smf_get_u16(&rd, &format) != 0 ||
+	    smf_get_u16(&rd, &ntrks) != 0 ||
+	    smf_get_u16(&rd, &division) != 0 ||
+	    smf_skip(&rd, len - 6) != 0) {
+		LOG_ERR("bad MIDI file header");
+		goto error;
+	}
+	if (format > 1) {
+		LOG_ERR("MIDI file format %d is not supported", format);
+		goto error;
+	}
+	if (division == 0) {
+		LOG_ERR("bad MIDI file division");
+		goto error;
+	}
+
+	/* track chunks */
+	for (int i = 0; i < ntrks; i++) {
+		if (smf_get_u32(&rd, &id) != 0 || smf_get_u32(&rd, &len) != 0) {
+			LOG_ERR("missing MIDI track %d", i);
+			goto error;
+		}
+		size_t end = rd.ofs + len;
+		if (end > rd.n) {
+			LOG_ERR("truncated MIDI track %d", i);
+			goto error;
+		}
+		if (id != 0x4d54726b /* MTrk */) {
+			/* skip unknown chunks */
+			rd.ofs = end;
+			continue;
+		}
+		if (smf_read_track(r, &rd, end, &size) != 0) {
+			goto error;
+		}
+		rd.ofs = end;
+	}
+
+	/* merge the tracks and work out the event times */
+	qsort(r->ev, r->n_ev, sizeof(struct render_event), render_event_cmp);
+	render_event_time(r, division);
+
+	LOG_INF("%s: format %d, %d tracks, %d events", name, format, ntrks, r->n_ev);
+
+	ggm_free(buf);
+	fclose(f);
+	return 0;
+
+error:
+	ggm_free(buf);
+	fclose(f);
+	return -1;
+}
+
+/******************************************************************************
+ * audio output file
+ */
+
+static void put_le16(uint8_t *b, uint16_t x)
+{
+	b[0] = x & 0xff;
+	b[1] = (x >> 8) & 0xff;
+}
+
+static void put_le32(uint8_t *b, uint32_t x)
+{
+	put_le16(&b[0], x & 0xffff);
+	put_le16(&b[2], x >> 16);
+}
+
+#define WAV_HEADER_SIZE 58
+
+/* render_wav_header writes a WAV header for IEEE float samples */
+static int render_wav_header(struct render *r)
+{
+	uint32_t nch = r->n_audio_out;
+	uint32_t rate = r->synth->rate;
+	uint32_t data_size = r->frames * nch * sizeof(float);
+	uint8_t hdr[WAV_HEADER_SIZE];
+
+	memcpy(&hdr[0], "RIFF", 4);
+	put_le32(&hdr[4], WAV_HEADER_SIZE - 8 + data_size);
+	memcpy(&hdr[8], "WAVE", 4);
+	/* format chunk */
+	memcpy(&hdr[12], "fmt ", 4);
+	put_le32(&hdr[16], 18);
+	put_le16(&hdr[20], 3);                                  /* WAVE_FORMAT_IEEE_FLOAT */
+	put_le16(&hdr[22], nch);                                /* channels */
+	put_le32(&hdr[24], rate);                               /* sample rate */
+	put_le32(&hdr[28], rate * nch * sizeof(float));         /* byte rate */
+	put_le16(&hdr[32], nch * sizeof(float));                /* block align */
+	put_le16(&hdr[34], 8 * sizeof(float));                  /* bits per sample */
+	put_le16(&hdr[36], 0);                                  /* extension size */
+	/* fact chunk */
+	memcpy(&hdr[38], "fact", 4);
+	put_le32(&hdr[42], 4);
+	put_le32(&hdr[46], r->frames);
+	/* data chunk */
+	memcpy(&hdr[50], "data", 4);
+	put_le32(&hdr[54], data_size);
+
+	if (fseek(r->f, 0, SEEK_SET) != 0 || fwrite(hdr, sizeof(hdr), 1, r->f) != 1) {
+		LOG_ERR("unable to write WAV header");
+		return -1;
+	}
+	return 0;
+}
+
+static int render_open(struct render *r)
+{
+	r->f = fopen(r->out_name, "wb");
+	if (r->f == NULL) {
+		LOG_ERR("unable to open %s", r->out_name);
+		return -1;
+	}
+	if (r->format == RENDER_FORMAT_WAV) {
+		/* write a placeholder, the sizes are filled in on close */
+		return render_wav_header(r);
+	}
+	return 0;
+}
+
+static int render_close(struct render *r)
+{
+	int rc = 0;
+
+	if (r->f == NULL) {
+		return 0;
+	}
+	if (r->format == RENDER_FORMAT_WAV) {
+		rc = render_wav_header(r);
+	}
+	fclose(r->f);
+	r->f = NULL;
+	return rc;
+}
+
+/* render_write writes the synth output buffers as interleaved samples */
+static int render_write(struct render *r, bool active)
+{
+	struct synth *s = r->synth;
+	size_t nch = r->n_audio_out;
+
+	if (active) {
+		for (size_t ch = 0; ch < nch; ch++) {
+			const float *src = s->bufs[r->n_audio_in + ch];
+			for (size_t i = 0; i < s->bufsize; i++) {
+				r->buf[(i * nch) + ch] = src[i];
+			}
+		}
+	} else {
+		memset(r->buf, 0, sizeof(r->buf));
+	}
+
+	size_t n = s->bufsize * nch;
+	if (fwrite(r->buf, sizeof(float), n, r->f) != n) {
+		LOG_ERR("unable to write to %s", r->out_name);
+		return -1;
+	}
+	r->frames += s->bufsize;
+	return 0;
+}
+
+/******************************************************************************
+ * rendering
+ */
+
+static void render_midi_out(void *arg, const struct event *e, int idx)
+{
+	/* no MIDI output device - drop the event */
+}
+
+static double render_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+static int render_run(struct render *r)
+{
+	struct synth *s = r->synth;
+	uint64_t end, frame = 0;
+	size_t idx = 0;
+	double t_dsp = 0.0;
+
+	/* how many frames should we render? */
+	if (r->duration > 0.f) {
+		end = (uint64_t)(r->duration * (float)s->rate);
+	} else {
+		end = (r->n_ev > 0) ? r->ev[r->n_ev - 1].frame : 0;
+		end += (uint64_t)(r->tail * (float)s->rate);
+	}
+
+	double t_start = render_time();
+
+	while (frame < end) {
+		/* queue the MIDI events for this buffer, they are dispatched at their sample frame */
+		while (idx < r->n_ev && r->ev[idx].frame < frame + s->bufsize) {
+			struct render_event *x = &r->ev[idx];
+			if (x->tempo == 0 && r->midi_in_pf != NULL) {
+				if (synth_event_in(s, s->root, r->midi_in_pf, &x->e, (uint32_t)x->frame) != 0) {
+					/* the input queue is full, dispatch it now */
+					LOG_WRN("input queue full at frame %u", (unsigned int)x->frame);
+					r->midi_in_pf(s->root, &x->e);
+				}
+			}
+			idx++;
+		}
+
+		/* run the synth loop */
+		double t0 = render_time();
+		bool active = synth_loop(s);
+		t_dsp += render_time() - t0;
+
+		if (render_write(r, active) != 0) {
+			return -1;
+		}
+		frame += s->bufsize;
+	}
+
+	double t_total = render_time() - t_start;
+	double secs = (double)frame / (double)s->rate;
+	double nbufs = (double)frame / (double)s->bufsize;
+
+	LOG_INF("rendered %.2f secs (%.0f buffers) to %s", secs, nbufs, r->out_name);
+	if (t_dsp > 0.0 && t_total > 0.0) {
+		LOG_INF("dsp %.3f secs, %.0f buffers/sec, %.1fx realtime", t_dsp, nbufs / t_dsp, secs / t_dsp);
+		LOG_INF("total %.3f secs, %.0f buffers/sec, %.1fx realtime", t_total, nbufs / t_total, secs / t_total);
+	}
+#if defined(GGM_PROFILE)
+	prof_dump(s);
+#endif
+	return 0;
+}
+
+/* render_setup checks the root patch and connects it to the render driver */
+static int render_setup(struct render *r)
+{
+	struct synth *s = r->synth;
+	struct module *m = s->root;
+
+	s->driver = (void *)r;
+	s->midi_out = render_midi_out;
+
+	r->n_audio_in = port_count_by_type(m->info->in, PORT_TYPE_AUDIO);
+	r->n_audio_out = port_count_by_type(m->info->out, PORT_TYPE_AUDIO);
+	if (r->n_audio_out == 0 || r->n_audio_out > MAX_AUDIO_OUT) {
+		LOG_ERR("number of audio outputs(%d) must be 1..MAX_AUDIO_OUT", r->n_audio_out);
+		return -1;
+	}
+
+	const struct port_info *pi = port_get_info_by_type(m->info->in, PORT_TYPE_MIDI, 0);
+	if (pi != NULL) {
+		r->midi_in_pf = pi->pf;
+	} else if (r->n_ev > 0) {
+		LOG_WRN("%s has no MIDI input, ignoring MIDI events", m->name);
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * main
+ */
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [options]\n", name);
+	fprintf(stderr, "  -p <patch>  root patch (default root/poly)\n");
+	fprintf(stderr, "  -i <file>   MIDI input file (.mid)\n");
+	fprintf(stderr, "  -o <file>   audio output file (default out.wav)\n");
+	fprintf(stderr, "  -r          write raw 32-bit float samples (default *.raw)\n");
+	fprintf(stderr, "  -t <secs>   render time after the last MIDI event (default 2)\n");
+	fprintf(stderr, "  -d <secs>   total render time (overrides -t)\n");
+	fprintf(stderr, "  -s <rate>   sample rate (default %u Hz)\n", AudioSampleFrequency);
+	fprintf(stderr, "  -b <size>   audio buffer size (default %d, max %d)\n", AudioBufferSize, MaxAudioBufferSize);
+	fprintf(stderr, "  -j <n>      number of processing threads (default 1)\n");
+	fprintf(stderr, "  -T <file>   tuning scale file (.scl, default 12-TET)\n");
+	fprintf(stderr, "  -q          quiet, only log warnings and errors\n");
+}
+
+static bool has_suffix(const char *s, const char *suffix)
+{
+	size_t n = strlen(s);
+	size_t k = strlen(suffix);
+
+	return (n >= k) && (strcmp(&s[n - k], suffix) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct render r;
+	int rc = -1;
+	int opt;
+
+	memset(&r, 0, sizeof(r));
+	r.patch = "root/poly";
+	r.out_name = "out.wav";
+	r.tail = 2.f;
+	r.format = -1;
+	r.rate = AudioSampleFrequency;
+	r.bufsize = AudioBufferSize;
+	r.threads = 1;
+
+	while ((opt = getopt(argc, argv, "p:i:o:rt:d:s:b:j:T:qh")) != -1) {
+		switch (opt) {
+		case 'p':
+			r.patch = optarg;
+			break;
+		case 'i':
+			r.midi_name = optarg;
+			break;
+		case 'o':
+			r.out_name = optarg;
+			break;
+		case 'r':
+			r.format = RENDER_FORMAT_RAW;
+			break;
+		case 't':
+			r.tail = clampf_lo(strtof(optarg, NULL), 0.f);
+			break;
+		case 'd':
+			r.duration = clampf_lo(strtof(optarg, NULL), 0.f);
+			break;
+		case 's':
+			r.rate = (unsigned int)maxi(0, atoi(optarg));
+			break;
+		case 'b':
+			r.bufsize = (size_t)maxi(0, atoi(optarg));
+			break;
+		case 'j':
+			r.threads = (unsigned int)maxi(1, atoi(optarg));
+			break;
+		case 'T':
+			r.scale = optarg;
+			break;
+		case 'q':
+			log_set_level(LOG_WARN);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (r.format < 0) {
+		r.format = has_suffix(r.out_name, ".raw") ? RENDER_FORMAT_RAW : RENDER_FORMAT_WAV;
+	}
+
+	log_set_prefix("ggm/src/");
+
+	LOG_INF("GooGooMuck %s (%s) offline render", GGM_VERSION, CONFIG_BOARD);
+
+	if (r.midi_name != NULL) {
+		if (render_read_midi(&r, r.midi_name) != 0) {
+			goto exit;
+		}
+	}
+
+	r.synth = synth_new();
+	if (r.synth == NULL) {
+		goto exit;
+	}
+
+	if (synth_set_audio(r.synth, r.rate, r.bufsize) != 0) {
+		goto exit;
+	}
+
+	if (synth_set_threads(r.synth, r.threads, 0) != 0) {
+		goto exit;
+	}
+
+	if (r.scale != NULL && scl_load(r.synth, r.scale) != 0) {
+		goto exit;
+	}
+
+	struct module *m = module_root(r.synth, r.patch, -1);
+	if (m == NULL) {
+		goto exit;
+	}
+
+	if (synth_set_root(r.synth, m) != 0) {
+		module_del(m);
+		goto exit;
+	}
+
+	if (render_setup(&r) != 0) {
+		goto exit;
+	}
+
+	if (render_open(&r) != 0) {
+		goto exit;
+	}
+
+	rc = render_run(&r);
+
+	if (render_close(&r) != 0) {
+		rc = -1;
+	}
+
+exit:
+	render_close(&r);
+	synth_del(r.synth);
+	free(r.ev);
+	return (rc == 0) ? 0 : 1;
+}
+
+/*****************************************************************************/
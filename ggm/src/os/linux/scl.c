@@ -0,0 +1,143 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Scala (.scl) Tuning Files
+ *
+ * See: http://www.huygens-fokker.org/scala/scl_format.html
+ */
+
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "ggm.h"
+#include "linux/scl.h"
+
+/******************************************************************************
+ * The scale degree 0 is on MIDI note 60, and MIDI note 69 is at 440 Hz.
+ * These are the defaults of a Scala keyboard mapping.
+ */
+
+#define SCL_NOTE 60
+#define SCL_REF 69
+#define SCL_FREQ 440.f
+#define SCL_MAX_DEGREES 1024
+
+/* scl_line reads the next line that isn't a comment, it returns NULL at EOF */
+static char *scl_line(FILE *f, char *buf, size_t n)
+{
+	while (fgets(buf, n, f) != NULL) {
+		if (buf[0] != '!') {
+			return buf;
+		}
+	}
+	return NULL;
+}
+
+/* scl_pitch converts a pitch value (cents or ratio) to cents */
+static int scl_pitch(const char *s, float *cents)
+{
+	char *end;
+
+	while (isspace((unsigned char)*s)) {
+		s++;
+	}
+
+	/* a value with a period is in cents */
+	const char *p = s;
+	while (*p != 0 && !isspace((unsigned char)*p) && *p != '.') {
+		p++;
+	}
+	if (*p == '.') {
+		*cents = strtof(s, &end);
+		return (end == s) ? -1 : 0;
+	}
+
+	/* otherwise it's a ratio (or an integer) */
+	long a = strtol(s, &end, 10);
+	long b = 1;
+	if (end == s) {
+		return -1;
+	}
+	if (*end == '/') {
+		s = end + 1;
+		b = strtol(s, &end, 10);
+		if (end == s) {
+			return -1;
+		}
+	}
+	if (a <= 0 || b <= 0) {
+		return -1;
+	}
+	*cents = 1200.f * log2f((float)a / (float)b);
+	return 0;
+}
+
+/******************************************************************************
+ * scl_load loads a Scala scale file and sets it as the tuning of the synth.
+ */
+
+int scl_load(struct synth *s, const char *name)
+{
+	float *cents = NULL;
+	char buf[256];
+	int rc = -1;
+
+	FILE *f = fopen(name, "r");
+
+	if (f == NULL) {
+		LOG_ERR("can't open %s", name);
+		return -1;
+	}
+
+	/* description */
+	if (scl_line(f, buf, sizeof(buf)) == NULL) {
+		goto error;
+	}
+
+	/* number of notes */
+	if (scl_line(f, buf, sizeof(buf)) == NULL) {
+		goto error;
+	}
+	int n = atoi(buf);
+	if (n <= 0 || n > SCL_MAX_DEGREES) {
+		LOG_ERR("%s: bad number of notes %d", name, n);
+		goto error;
+	}
+
+	/* pitch values */
+	cents = calloc(n, sizeof(float));
+	if (cents == NULL) {
+		goto error;
+	}
+	for (int i = 0; i < n; i++) {
+		if (scl_line(f, buf, sizeof(buf)) == NULL || scl_pitch(buf, &cents[i]) != 0) {
+			LOG_ERR("%s: bad pitch value %d", name, i + 1);
+			goto error;
+		}
+	}
+
+	struct tuning_scale sc = {
+		.cents = cents,
+		.n = n,
+		.note = SCL_NOTE,
+		.ref = SCL_REF,
+		.freq = SCL_FREQ,
+	};
+	rc = synth_set_tuning(s, &sc);
+	if (rc == 0) {
+		LOG_INF("%s: %d note scale", name, n);
+	}
+
+error:
+	if (rc != 0) {
+		LOG_ERR("can't load scale %s", name);
+	}
+	free(cents);
+	fclose(f);
+	return rc;
+}
+
+/*****************************************************************************/
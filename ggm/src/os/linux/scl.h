@@ -0,0 +1,20 @@
+/******************************************************************************
+ * Copyright (c) 2019 Jason T. Harris. (sirmanlypowers@gmail.com)
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Scala (.scl) Tuning Files
+ */
+
+#ifndef GGM_SRC_OS_LINUX_SCL_H
+#define GGM_SRC_OS_LINUX_SCL_H
+
+/*****************************************************************************/
+
+int scl_load(struct synth *s, const char *name);
+
+/*****************************************************************************/
+
+#endif /* GGM_SRC_OS_LINUX_SCL_H */
+
+/*****************************************************************************/
@@ -35,6 +35,11 @@ int main(void)
 	for (int i = 0; i < 3000; i++) {
 		synth_loop(s);
 		ggm_mdelay(3);
+#if defined(GGM_PROFILE)
+		if ((i % 1000) == 999) {
+			prof_dump(s);
+		}
+#endif
 	}
 
 exit: